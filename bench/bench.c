@@ -0,0 +1,896 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <svdrp.h>
+
+#include "mock.h"
+
+/* lines parsed per size, the iterations being scaled accordingly */
+#define BENCH_LINES_TARGET 2000000
+#define BENCH_MIN_ITERATIONS 3
+
+typedef struct bench_s {
+    FILE *out;
+    int iterations;               /* iterations of the command benchmarks */
+    int latency;                  /* delay of the mock server replies */
+    int max_lines;                /* largest listing to parse */
+    const char *filter;           /* benchmarks to run, by name prefix */
+    const char *replay;           /* session capture to replay */
+} bench_t;
+
+typedef struct bench_run_s {
+    const char *name;
+    char params[256];             /* extra JSON members, comma-terminated */
+    double *samples;              /* duration of each iteration, in us */
+    int count;
+    double seconds;
+    long long lines;
+    unsigned long long bytes;
+} bench_run_t;
+
+static double bench_now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench_cmp (const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+static int bench_enabled (bench_t *bench, const char *name)
+{
+    return !bench->filter || !strncmp (name, bench->filter, strlen (bench->filter));
+}
+
+static void bench_run_init (bench_run_t *run, const char *name, int iterations)
+{
+    memset (run, 0, sizeof (bench_run_t));
+    run->name = name;
+    run->samples = calloc (iterations, sizeof (double));
+}
+
+/* one JSON object per line, for scripts to compare runs */
+static void bench_report (bench_t *bench, bench_run_t *run, int ok)
+{
+    double p50 = 0, p99 = 0, max = 0;
+
+    if (run->count) {
+        qsort (run->samples, run->count, sizeof (double), bench_cmp);
+        p50 = run->samples[run->count / 2];
+        p99 = run->samples[(int) (run->count * 0.99)];
+        max = run->samples[run->count - 1];
+    }
+
+    fprintf (bench->out, "{\"benchmark\":\"%s\",%s\"ok\":%s,"
+             "\"iterations\":%i,\"seconds\":%.6f,\"ops_per_sec\":%.1f,"
+             "\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f",
+             run->name, run->params, ok ? "true" : "false",
+             run->count, run->seconds,
+             run->seconds > 0 ? run->count / run->seconds : 0, p50, p99, max);
+    if (run->lines)
+        fprintf (bench->out, ",\"lines\":%lld,\"lines_per_sec\":%.0f,"
+                 "\"mb_per_sec\":%.2f",
+                 run->lines / (run->count ? run->count : 1),
+                 run->seconds > 0 ? run->lines / run->seconds : 0,
+                 run->seconds > 0 ? run->bytes / run->seconds / 1e6 : 0);
+    fprintf (bench->out, "}\n");
+    fflush (bench->out);
+
+    free (run->samples);
+}
+
+static unsigned long long bench_bytes_in (svdrp_t *svdrp, const char *verb)
+{
+    svdrp_metrics_t metrics;
+    int i;
+
+    svdrp_get_metrics (svdrp, &metrics);
+    for (i = 0; i < SVDRP_METRICS_VERBS; i++)
+        if (!strcmp (metrics.verbs[i].verb, verb))
+            return metrics.verbs[i].bytes_in;
+
+    return 0;
+}
+
+static mock_server_t *bench_server_at (bench_t *bench, int timers, int events,
+                                       const char *path)
+{
+    mock_config_t config = { timers, 100, events, bench->latency, NULL, path };
+
+    return mock_server_start (&config, 0);
+}
+
+static mock_server_t *bench_server (bench_t *bench, int timers, int events)
+{
+    return bench_server_at (bench, timers, events, NULL);
+}
+
+/* round trip of a command, over TCP, a Unix socket, memory or the cache */
+static void bench_command (bench_t *bench, const char *cmd, const char *transport)
+{
+    svdrp_memory_pipe_t *pipe = NULL;
+    mock_server_t *server;
+    bench_run_t run;
+    svdrp_t *svdrp;
+    char path[64];
+    double start;
+    int i, ok = 1;
+
+    snprintf (path, sizeof (path), "/tmp/svdrp-bench-%i.sock", (int) getpid ());
+
+    server = bench_server_at (bench, 10, 0,
+                              !strcmp (transport, "unix") ? path : NULL);
+    if (!server)
+        return;
+
+    if (!strcmp (transport, "unix"))
+        svdrp = svdrp_open_transport (&svdrp_transport_unix, NULL, path, 0,
+                                      10, 0, SVDRP_MSG_NONE);
+    else if (!strcmp (transport, "memory")) {
+        pipe = svdrp_memory_pipe_new (mock_server_memory, server);
+        svdrp = svdrp_open_transport (&svdrp_transport_memory, pipe, NULL, 0,
+                                      10, 0, SVDRP_MSG_NONE);
+    }
+    else
+        svdrp = svdrp_open ("127.0.0.1", mock_server_port (server), 10, SVDRP_MSG_NONE);
+
+    /* only the first command reaches the server */
+    if (!strcmp (transport, "tcp-cached"))
+        svdrp_cache_enable (svdrp, 3600 * 1000, 0);
+
+    bench_run_init (&run, "command", bench->iterations);
+    snprintf (run.params, sizeof (run.params), "\"command\":\"%s\","
+              "\"transport\":\"%s\",\"latency_us\":%i,",
+              cmd, transport, bench->latency);
+
+    start = bench_now ();
+    for (i = 0; i < bench->iterations; i++) {
+        double t = bench_now ();
+
+        if (svdrp_command (svdrp, cmd, NULL, NULL) != SVDRP_REPLY_OK)
+            ok = 0;
+        run.samples[run.count++] = (bench_now () - t) * 1e6;
+    }
+    run.seconds = bench_now () - start;
+
+    bench_report (bench, &run, ok);
+    svdrp_close (svdrp);
+    svdrp_memory_pipe_free (pipe);
+    mock_server_stop (server);
+}
+
+static void bench_count_line (void *data, int code,
+                              const char *line, size_t len, int last)
+{
+    (void) code; (void) line; (void) len; (void) last;
+    (*(long long *) data)++;
+}
+
+static void bench_count_channel (void *data, const svdrp_epg_channel_t *channel)
+{
+    (void) data; (void) channel;
+}
+
+static void bench_count_event (void *data, const svdrp_epg_event_t *event)
+{
+    (void) event;
+    (*(long long *) data)++;
+}
+
+/* events kept by one malloc() each, the way before arenas */
+typedef struct bench_events_s {
+    svdrp_epg_event_t **events;
+    int count;
+    int size;
+} bench_events_t;
+
+static void bench_keep_event (void *data, const svdrp_epg_event_t *event)
+{
+    bench_events_t *kept = data;
+
+    if (kept->count == kept->size) {
+        kept->size = kept->size ? 2 * kept->size : 1024;
+        kept->events = realloc (kept->events, kept->size * sizeof (svdrp_epg_event_t *));
+    }
+    kept->events[kept->count++] = svdrp_epg_event_materialize (event);
+}
+
+/* listing of a given size, read and parsed by the library */
+static void bench_listing (bench_t *bench, const char *name, int size)
+{
+    unsigned long long bytes;
+    mock_server_t *server;
+    bench_run_t run;
+    svdrp_t *svdrp;
+    svdrp_arena_t *arena;
+    double start;
+    int i, ok = 1, iterations, lines, is_lstt;
+
+    is_lstt = !strcmp (name, "lstt_parse");
+
+    /* an event takes 7 lines of LSTE */
+    server = is_lstt ? bench_server (bench, size, 0)
+        : bench_server (bench, 0, size / 7);
+    if (!server)
+        return;
+
+    lines = mock_server_lines (server, is_lstt ? "LSTT" : "LSTE");
+    iterations = BENCH_LINES_TARGET / lines;
+    if (iterations < BENCH_MIN_ITERATIONS)
+        iterations = BENCH_MIN_ITERATIONS;
+
+    svdrp = svdrp_open ("127.0.0.1", mock_server_port (server), 60, SVDRP_MSG_NONE);
+    bytes = bench_bytes_in (svdrp, is_lstt ? "LSTT" : "LSTE");
+    arena = svdrp_arena_new (0);
+
+    bench_run_init (&run, name, iterations);
+    snprintf (run.params, sizeof (run.params), "\"size\":%i,\"latency_us\":%i,",
+              size, bench->latency);
+
+    start = bench_now ();
+    for (i = 0; i < iterations; i++) {
+        double t = bench_now ();
+        long long items = 0;
+
+        if (is_lstt) {
+            svdrp_timer_t *timers;
+            int count;
+
+            if (svdrp_list_timers (svdrp, &timers, &count) != SVDRP_OK)
+                ok = 0;
+            else {
+                items = count;
+                svdrp_free_timers (timers);
+            }
+            if (items != size)
+                ok = 0;
+        }
+        else if (!strcmp (name, "lste_snapshot")) {
+            svdrp_epg_event_t *events;
+            int count;
+
+            /* the previous snapshot goes away at once */
+            svdrp_arena_reset (arena);
+            if (svdrp_snapshot_epg (svdrp, arena, NULL, &events, &count) != SVDRP_OK
+                || count != size / 7)
+                ok = 0;
+        }
+        else if (!strcmp (name, "lste_materialize")) {
+            bench_events_t kept = { NULL, 0, 0 };
+            int n;
+
+            if (svdrp_get_epg (svdrp, NULL, NULL, bench_keep_event, &kept) != SVDRP_OK
+                || kept.count != size / 7)
+                ok = 0;
+            for (n = 0; n < kept.count; n++)
+                svdrp_view_free (kept.events[n]);
+            free (kept.events);
+        }
+        else if (!strcmp (name, "lste_index")) {
+            svdrp_epg_index_t *index = svdrp_epg_index_new ();
+            int n;
+
+            if (svdrp_epg_index_fetch (index, svdrp, NULL) != SVDRP_OK)
+                ok = 0;
+            for (n = 0; n < svdrp_epg_index_channels (index); n++)
+                items += svdrp_epg_index_events (index,
+                    svdrp_epg_index_get_channel (index, n)->id, NULL);
+            if (items != size / 7)
+                ok = 0;
+            svdrp_epg_index_free (index);
+        }
+        else if (!strcmp (name, "lste_read")) {
+            if (svdrp_command (svdrp, "LSTE", bench_count_line, &items)
+                != SVDRP_REPLY_EPG_DATA || items != lines)
+                ok = 0;
+        }
+        else {
+            if (svdrp_get_epg (svdrp, NULL, bench_count_channel,
+                               bench_count_event, &items) != SVDRP_OK
+                || items != size / 7)
+                ok = 0;
+        }
+
+        run.samples[run.count++] = (bench_now () - t) * 1e6;
+    }
+    run.seconds = bench_now () - start;
+    run.lines = (long long) lines * iterations;
+    run.bytes = bench_bytes_in (svdrp, is_lstt ? "LSTT" : "LSTE") - bytes;
+
+    bench_report (bench, &run, ok);
+    svdrp_arena_free (arena);
+    svdrp_close (svdrp);
+    mock_server_stop (server);
+}
+
+/* records as in mock listings, the reply codes stripped */
+static char *bench_records (int is_lstt, int size, size_t *len, long long *sum)
+{
+    char *records, *p;
+    int i;
+
+    records = malloc ((size_t) size * 128);
+    if (!records)
+        return NULL;
+
+    /* sum of the timer channels or of the channel numbers */
+    *sum = 0;
+    for (i = 0, p = records; i < size; i++) {
+        *sum += is_lstt ? i % 100 + 1 : i + 1;
+        p += 1 + (is_lstt ?
+                  sprintf (p, "%d 1:%d:2030-01-%02d:2000:2130:50:99:Show %d~Episode %d:"
+                           "<epgsearch>mock</epgsearch>",
+                           i + 1, i % 100 + 1, i % 28 + 1, i, i)
+                  : sprintf (p, "%d Channel %d;Mock:%d:hC34:S19.2E:27500:%d:%d=deu:%d:0:%d:1:1101:0",
+                             i + 1, i + 1, 10000 + i, 100 + i, 200 + i, 300 + i, 28000 + i));
+    }
+    *len = p - records;
+
+    return records;
+}
+
+/* the sscanf() parsing the field splitter replaced */
+static int bench_sscanf_timer (const char *line)
+{
+    char day[256], start[256], stop[256], file[256], data[256];
+    int id, channel, priority, lifetime;
+    unsigned char flags;
+
+    return sscanf (line, "%i %hhi:%i:%[^:]:%[^:]:%[^:]:%i:%i:%[^:]:%[^:]",
+                   &id, &flags, &channel, day, start, stop,
+                   &priority, &lifetime, file, data) == 10 ? channel : -1;
+}
+
+static int bench_sscanf_channel (const char *line)
+{
+    char name[256], parameters[256], source[256];
+    char vpid[256], apid[256], tpid[256], caid[256];
+    int number, frequency, srate, sid, nid, tid, rid;
+
+    return sscanf (line, "%d %[^:]:%d:%[^:]:%[^:]:%d:%[^:]:%[^:]:%[^:]:%[^:]:%d:%d:%d:%d",
+                   &number, name, &frequency, parameters, source, &srate,
+                   vpid, apid, tpid, caid, &sid, &nid, &tid, &rid) == 14 ? number : -1;
+}
+
+/* LSTT and LSTC records split in memory, no connection involved */
+static void bench_split (bench_t *bench, const char *name, int size)
+{
+    int is_lstt = !strncmp (name, "lstt", 4);
+    int use_sscanf = strstr (name, "sscanf") != NULL;
+    int i, ok = 1, iterations;
+    bench_run_t run;
+    char *records;
+    size_t len;
+    long long expected;
+    double start;
+
+    records = bench_records (is_lstt, size, &len, &expected);
+    if (!records)
+        return;
+
+    iterations = BENCH_LINES_TARGET / size;
+    if (iterations < BENCH_MIN_ITERATIONS)
+        iterations = BENCH_MIN_ITERATIONS;
+
+    bench_run_init (&run, name, iterations);
+    snprintf (run.params, sizeof (run.params), "\"size\":%i,", size);
+
+    start = bench_now ();
+    for (i = 0; i < iterations; i++) {
+        double t = bench_now ();
+        const char *line = records;
+        long long sum = 0;
+        int n;
+
+        for (n = 0; n < size; n++) {
+            size_t line_len = strlen (line);
+
+            if (use_sscanf)
+                sum += is_lstt ? bench_sscanf_timer (line) : bench_sscanf_channel (line);
+            else if (is_lstt) {
+                svdrp_timer_view_t timer;
+
+                sum += svdrp_parse_timer (line, line_len, &timer) == SVDRP_OK ?
+                    timer.channel : -1;
+            }
+            else {
+                svdrp_channel_view_t channel;
+
+                sum += svdrp_parse_channel (line, line_len, &channel) == SVDRP_OK ?
+                    channel.number : -1;
+            }
+            line += line_len + 1;
+        }
+
+        /* also keeps the parsing from being optimized away */
+        if (sum != expected)
+            ok = 0;
+
+        run.samples[run.count++] = (bench_now () - t) * 1e6;
+    }
+    run.seconds = bench_now () - start;
+    run.lines = (long long) size * iterations;
+    run.bytes = (unsigned long long) len * iterations;
+
+    bench_report (bench, &run, ok);
+    free (records);
+}
+
+/* connection establishment, banner included */
+static void bench_connect (bench_t *bench, int reconnect)
+{
+    mock_server_t *server;
+    bench_run_t run;
+    svdrp_t *svdrp = NULL;
+    int i, ok = 1, iterations = bench->iterations / 10 + 1;
+
+    server = bench_server (bench, 10, 0);
+    if (!server)
+        return;
+
+    if (reconnect)
+        svdrp = svdrp_open ("127.0.0.1", mock_server_port (server), 10, SVDRP_MSG_NONE);
+
+    bench_run_init (&run, reconnect ? "reconnect" : "connect", iterations);
+    snprintf (run.params, sizeof (run.params), "\"latency_us\":%i,", bench->latency);
+
+    for (i = 0; i < iterations; i++) {
+        double t;
+
+        /* VDR closing the connection is left out of the measure */
+        if (reconnect)
+            svdrp_command (svdrp, "QUIT", NULL, NULL);
+
+        t = bench_now ();
+        if (reconnect) {
+            if (svdrp_command (svdrp, "STAT disk", NULL, NULL) != SVDRP_REPLY_OK)
+                ok = 0;
+        }
+        else {
+            svdrp = svdrp_open ("127.0.0.1", mock_server_port (server), 10,
+                                SVDRP_MSG_NONE);
+            if (!svdrp_is_connected (svdrp))
+                ok = 0;
+            svdrp_close (svdrp);
+        }
+        run.samples[run.count++] = (bench_now () - t) * 1e6;
+        run.seconds += bench_now () - t;
+    }
+
+    bench_report (bench, &run, ok);
+    if (reconnect)
+        svdrp_close (svdrp);
+    mock_server_stop (server);
+}
+
+/* a short task, on a connection of its own or leased from a pool */
+static void bench_task (bench_t *bench, int pooled)
+{
+    mock_server_t *server;
+    svdrp_pool_t *pool = NULL;
+    bench_run_t run;
+    double start;
+    int i, ok = 1, iterations = bench->iterations / 10 + 1;
+
+    server = bench_server (bench, 10, 0);
+    if (!server)
+        return;
+
+    if (pooled)
+        pool = svdrp_pool_new (10, SVDRP_MSG_NONE);
+
+    bench_run_init (&run, pooled ? "task_pool" : "task_open", iterations);
+    snprintf (run.params, sizeof (run.params), "\"command\":\"STAT disk\","
+              "\"latency_us\":%i,", bench->latency);
+
+    start = bench_now ();
+    for (i = 0; i < iterations; i++) {
+        double t = bench_now ();
+        svdrp_t *svdrp;
+
+        if (pooled)
+            svdrp = svdrp_pool_lease (pool, "127.0.0.1", mock_server_port (server));
+        else
+            svdrp = svdrp_open ("127.0.0.1", mock_server_port (server), 10,
+                                SVDRP_MSG_NONE);
+
+        if (!svdrp || svdrp_command (svdrp, "STAT disk", NULL, NULL) != SVDRP_REPLY_OK)
+            ok = 0;
+
+        if (pooled)
+            svdrp_pool_return (pool, svdrp);
+        else
+            svdrp_close (svdrp);
+
+        run.samples[run.count++] = (bench_now () - t) * 1e6;
+    }
+    run.seconds = bench_now () - start;
+
+    bench_report (bench, &run, ok);
+    svdrp_pool_free (pool);
+    mock_server_stop (server);
+}
+
+/* threads of a run, started together once connected */
+typedef struct bench_start_s {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int ready;                    /* threads connected */
+    int go;
+} bench_start_t;
+
+typedef struct bench_thread_s {
+    bench_t *bench;
+    mock_server_t *server;
+    bench_start_t *start;
+    double *samples;              /* slice of the run samples */
+    int ok;
+} bench_thread_t;
+
+static void *bench_thread (void *data)
+{
+    bench_thread_t *thread = data;
+    bench_start_t *start = thread->start;
+    svdrp_t *svdrp;
+    int i;
+
+    svdrp = svdrp_open ("127.0.0.1", mock_server_port (thread->server), 10,
+                        SVDRP_MSG_NONE);
+    thread->ok = svdrp && svdrp_is_connected (svdrp);
+
+    /* the connections are all up before the clock starts */
+    pthread_mutex_lock (&start->lock);
+    start->ready++;
+    pthread_cond_broadcast (&start->cond);
+    while (!start->go)
+        pthread_cond_wait (&start->cond, &start->lock);
+    pthread_mutex_unlock (&start->lock);
+
+    for (i = 0; i < thread->bench->iterations && svdrp; i++) {
+        double t = bench_now ();
+
+        if (svdrp_command (svdrp, "LSTT", NULL, NULL) != SVDRP_REPLY_OK)
+            thread->ok = 0;
+        thread->samples[i] = (bench_now () - t) * 1e6;
+    }
+
+    svdrp_close (svdrp);
+
+    return NULL;
+}
+
+/* one connection per thread, each to a server of its own */
+static void bench_threads (bench_t *bench, int count)
+{
+    mock_server_t *servers[64];
+    bench_thread_t threads[64];
+    pthread_t ids[64];
+    bench_start_t start;
+    bench_run_t run;
+    double t;
+    int i, started = 0, ok = 1;
+
+    if (count > 64)
+        count = 64;
+
+    bench_run_init (&run, "threads", bench->iterations * count);
+    snprintf (run.params, sizeof (run.params), "\"threads\":%i,"
+              "\"command\":\"LSTT\",\"latency_us\":%i,", count, bench->latency);
+
+    memset (&start, 0, sizeof (start));
+    pthread_mutex_init (&start.lock, NULL);
+    pthread_cond_init (&start.cond, NULL);
+
+    for (i = 0; i < count; i++) {
+        servers[i] = bench_server (bench, 10, 0);
+        if (!servers[i])
+            break;
+
+        threads[i].bench = bench;
+        threads[i].server = servers[i];
+        threads[i].start = &start;
+        threads[i].samples = run.samples + i * bench->iterations;
+        threads[i].ok = 0;
+        if (pthread_create (&ids[i], NULL, bench_thread, &threads[i])) {
+            mock_server_stop (servers[i]);
+            break;
+        }
+        started++;
+    }
+
+    pthread_mutex_lock (&start.lock);
+    while (start.ready < started)
+        pthread_cond_wait (&start.cond, &start.lock);
+    start.go = 1;
+    pthread_cond_broadcast (&start.cond);
+    pthread_mutex_unlock (&start.lock);
+
+    t = bench_now ();
+    for (i = 0; i < started; i++) {
+        pthread_join (ids[i], NULL);
+        if (!threads[i].ok)
+            ok = 0;
+    }
+    run.seconds = bench_now () - t;
+    run.count = bench->iterations * started;
+
+    bench_report (bench, &run, ok && started == count);
+    pthread_cond_destroy (&start.cond);
+    pthread_mutex_destroy (&start.lock);
+    for (i = 0; i < started; i++)
+        mock_server_stop (servers[i]);
+}
+
+typedef struct bench_replay_s {
+    svdrp_epg_parser_t *parser;
+    long long lines;
+    unsigned long long bytes;
+} bench_replay_t;
+
+static void bench_replay_line (void *data, int code,
+                               const char *line, size_t len, int last)
+{
+    bench_replay_t *replay = data;
+
+    (void) last;
+    replay->lines++;
+    replay->bytes += len;
+    if (code == SVDRP_REPLY_EPG_DATA)
+        svdrp_epg_parser_feed_line (replay->parser, line, len);
+}
+
+/* now/next or a 3 hour grid on every channel, answered by the index */
+static void bench_epg_index (bench_t *bench, const char *name, int events)
+{
+    mock_server_t *server;
+    svdrp_epg_index_t *index;
+    svdrp_t *svdrp;
+    bench_run_t run;
+    const char **ids;
+    time_t now = time (NULL);
+    double start;
+    long long found = 0;
+    int i, n, channels, ok = 1, is_range = !strcmp (name, "epg_index_range");
+
+    server = bench_server (bench, 0, events);
+    if (!server)
+        return;
+
+    svdrp = svdrp_open ("127.0.0.1", mock_server_port (server), 60, SVDRP_MSG_NONE);
+    index = svdrp_epg_index_new ();
+    if (svdrp_epg_index_fetch (index, svdrp, NULL) != SVDRP_OK)
+        ok = 0;
+    svdrp_close (svdrp);
+    mock_server_stop (server);
+
+    channels = svdrp_epg_index_channels (index);
+    ids = calloc (channels ? channels : 1, sizeof (char *));
+    for (n = 0; n < channels; n++)
+        ids[n] = svdrp_epg_index_get_channel (index, n)->id;
+
+    bench_run_init (&run, name, bench->iterations);
+    snprintf (run.params, sizeof (run.params), "\"events\":%i,\"channels\":%i,",
+              events, channels);
+
+    start = bench_now ();
+    for (i = 0; i < bench->iterations; i++) {
+        /* somewhere within the programme of the mock, half an hour per event */
+        time_t t = now + (time_t) (i % (events / (channels ? channels : 1) + 1)) * 1800 + 900;
+        double t0 = bench_now ();
+
+        for (n = 0; n < channels; n++) {
+            if (is_range) {
+                const svdrp_epg_event_t *grid;
+
+                found += svdrp_epg_index_range (index, ids[n], t, t + 3 * 3600, &grid);
+            }
+            else {
+                found += svdrp_epg_index_at (index, ids[n], t) != NULL;
+                found += svdrp_epg_index_next (index, ids[n], t) != NULL;
+            }
+        }
+
+        run.samples[run.count++] = (bench_now () - t0) * 1e6;
+    }
+    run.seconds = bench_now () - start;
+
+    /* also keeps the lookups from being optimized away */
+    if (!found)
+        ok = 0;
+
+    bench_report (bench, &run, ok);
+    free (ids);
+    svdrp_epg_index_free (index);
+}
+
+/* recorded session, played back at full speed */
+static void bench_replay (bench_t *bench)
+{
+    bench_replay_t replay = { NULL, 0, 0 };
+    bench_run_t run;
+    double start;
+    int i, ok = 1, iterations = bench->iterations / 10 + 1;
+
+    replay.parser = svdrp_epg_parser_new (bench_count_channel, NULL, NULL);
+    if (!replay.parser)
+        return;
+
+    bench_run_init (&run, "replay", iterations);
+    snprintf (run.params, sizeof (run.params), "\"capture\":\"%s\",", bench->replay);
+
+    start = bench_now ();
+    for (i = 0; i < iterations; i++) {
+        double t = bench_now ();
+        svdrp_t *svdrp;
+
+        svdrp = svdrp_open_replay (bench->replay, 0, SVDRP_MSG_NONE);
+        if (!svdrp || svdrp_replay_run (svdrp, bench_replay_line, &replay) != SVDRP_OK)
+            ok = 0;
+        svdrp_close (svdrp);
+
+        run.samples[run.count++] = (bench_now () - t) * 1e6;
+    }
+    run.seconds = bench_now () - start;
+    run.lines = replay.lines;
+    run.bytes = replay.bytes;
+
+    bench_report (bench, &run, ok);
+    svdrp_epg_parser_free (replay.parser);
+}
+
+int main (int argc, char **argv)
+{
+    bench_t bench = { stdout, 20000, 0, 1000000, NULL, NULL };
+    int size, option;
+
+    const char *const short_options = "n:l:m:f:o:r:qh";
+    const struct option long_options [] = {
+        {"iterations", required_argument, NULL, 'n'},
+        {"latency", required_argument, NULL, 'l'},
+        {"max-lines", required_argument, NULL, 'm'},
+        {"filter", required_argument, NULL, 'f'},
+        {"output", required_argument, NULL, 'o'},
+        {"replay", required_argument, NULL, 'r'},
+        {"quick", no_argument, NULL, 'q'},
+        {"help", no_argument, NULL, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    while ((option = getopt_long (argc, argv, short_options, long_options, NULL)) > 0) {
+        switch (option)
+        {
+            case 'n':
+                bench.iterations = atoi (optarg);
+                break;
+            case 'l':
+                bench.latency = atoi (optarg);
+                break;
+            case 'm':
+                bench.max_lines = atoi (optarg);
+                break;
+            case 'f':
+                bench.filter = optarg;
+                break;
+            case 'o':
+                bench.out = fopen (optarg, "w");
+                if (!bench.out) {
+                    perror (optarg);
+                    return 1;
+                }
+                break;
+            case 'r':
+                bench.replay = optarg;
+                break;
+            case 'q':
+                bench.iterations = 2000;
+                bench.max_lines = 100000;
+                break;
+            case 'h':
+            default:
+                fprintf (stderr, "usage: %s [-h|--help] [-q|--quick] [-n|--iterations <count>] [-l|--latency <us>] [-m|--max-lines <count>] [-f|--filter <benchmark>] [-o|--output <file>] [-r|--replay <capture>]\n" \
+                         "   note: results are written as one JSON object per line.\n", argv[0]);
+                return -1;
+        }
+    }
+
+    if (bench.iterations < 1)
+        bench.iterations = 1;
+
+    /* a capture replaces the mock server benchmarks */
+    if (bench.replay) {
+        bench_replay (&bench);
+        if (bench.out != stdout)
+            fclose (bench.out);
+        return 0;
+    }
+
+    if (bench_enabled (&bench, "command")) {
+        bench_command (&bench, "STAT disk", "tcp");
+        bench_command (&bench, "NEXT abs", "tcp");
+        bench_command (&bench, "STAT disk", "unix");
+        bench_command (&bench, "STAT disk", "memory");
+        bench_command (&bench, "STAT disk", "tcp-cached");
+        bench_command (&bench, "LSTT", "tcp");
+        bench_command (&bench, "LSTT", "tcp-cached");
+    }
+
+    if (bench_enabled (&bench, "connect"))
+        bench_connect (&bench, 0);
+    if (bench_enabled (&bench, "reconnect"))
+        bench_connect (&bench, 1);
+
+    if (bench_enabled (&bench, "task_open"))
+        bench_task (&bench, 0);
+    if (bench_enabled (&bench, "task_pool"))
+        bench_task (&bench, 1);
+
+    if (bench_enabled (&bench, "epg_index_now"))
+        bench_epg_index (&bench, "epg_index_now", 10000);
+    if (bench_enabled (&bench, "epg_index_range"))
+        bench_epg_index (&bench, "epg_index_range", 10000);
+
+    if (bench_enabled (&bench, "threads"))
+        for (size = 1; size <= 8; size *= 2)
+            bench_threads (&bench, size);
+
+    for (size = 1000; size <= bench.max_lines; size *= 10) {
+        if (bench_enabled (&bench, "lstt_split"))
+            bench_split (&bench, "lstt_split", size);
+        if (bench_enabled (&bench, "lstt_sscanf"))
+            bench_split (&bench, "lstt_sscanf", size);
+        if (bench_enabled (&bench, "lstc_split"))
+            bench_split (&bench, "lstc_split", size);
+        if (bench_enabled (&bench, "lstc_sscanf"))
+            bench_split (&bench, "lstc_sscanf", size);
+        if (bench_enabled (&bench, "lstt_parse"))
+            bench_listing (&bench, "lstt_parse", size);
+        if (bench_enabled (&bench, "lste_read"))
+            bench_listing (&bench, "lste_read", size);
+        if (bench_enabled (&bench, "lste_parse"))
+            bench_listing (&bench, "lste_parse", size);
+        if (bench_enabled (&bench, "lste_snapshot"))
+            bench_listing (&bench, "lste_snapshot", size);
+        if (bench_enabled (&bench, "lste_materialize"))
+            bench_listing (&bench, "lste_materialize", size);
+        if (bench_enabled (&bench, "lste_index"))
+            bench_listing (&bench, "lste_index", size);
+    }
+
+    if (bench.out != stdout)
+        fclose (bench.out);
+
+    return 0;
+}
@@ -0,0 +1,583 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mock.h"
+
+#define MOCK_BANNER \
+    "220 mockvdr SVDRP VideoDiskRecorder 1.6.0; Thu Jan  1 00:00:00 2009; UTF-8\r\n"
+#define MOCK_MAX_CLIENTS 256
+#define MOCK_LINE_SIZE 4096
+
+typedef struct mock_buf_s {
+    char *data;
+    size_t len;
+    size_t size;
+    int lines;
+} mock_buf_t;
+
+/* reply of a verb, from the script */
+typedef struct mock_reply_s {
+    char verb[5];
+    mock_buf_t buf;
+} mock_reply_t;
+
+struct mock_server_s {
+    mock_config_t config;
+    int listener;
+    int port;
+    pthread_t thread;
+
+    mock_buf_t timers;
+    mock_buf_t channels;
+    mock_buf_t epg;
+    mock_reply_t *script;
+    int script_count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int clients[MOCK_MAX_CLIENTS];
+    int client_count;
+};
+
+/* where the replies go, a socket or an in-memory pipe */
+typedef struct mock_peer_s {
+    int fd;
+    svdrp_memory_pipe_t *pipe;
+} mock_peer_t;
+
+typedef struct mock_client_s {
+    mock_server_t *server;
+    int fd;
+} mock_client_t;
+
+static int buf_printf (mock_buf_t *buf, const char *format, ...)
+{
+    va_list va;
+    int len;
+
+    for (;;) {
+        va_start (va, format);
+        len = vsnprintf (buf->data + buf->len, buf->size - buf->len, format, va);
+        va_end (va);
+
+        if (len < 0)
+            return -1;
+        if (buf->len + len < buf->size)
+            break;
+
+        buf->size = buf->size ? 2 * buf->size + len : 4096 + len;
+        buf->data = realloc (buf->data, buf->size);
+        if (!buf->data)
+            return -1;
+    }
+
+    buf->len += len;
+
+    return 0;
+}
+
+/* prefix the lines of a reply with their code, continued but the last */
+static int buf_line (mock_buf_t *buf, int code, const char *format, ...)
+{
+    char line[MOCK_LINE_SIZE];
+    va_list va;
+
+    va_start (va, format);
+    vsnprintf (line, sizeof (line), format, va);
+    va_end (va);
+
+    buf->lines++;
+
+    return buf_printf (buf, "%03d-%s\r\n", code, line);
+}
+
+static void buf_end (mock_buf_t *buf)
+{
+    char *last;
+
+    if (!buf->len)
+        return;
+
+    /* turn the last continued line into the final one */
+    buf->data[buf->len - 2] = '\0';
+    last = strrchr (buf->data, '\n');
+    last = last ? last + 1 : buf->data;
+    last[3] = ' ';
+    buf->data[buf->len - 2] = '\r';
+}
+
+static void mock_generate (mock_server_t *server)
+{
+    const mock_config_t *c = &server->config;
+    time_t now = time (NULL);
+    int i, ch, channels;
+
+    for (i = 0; i < c->timers; i++)
+        buf_line (&server->timers, 250,
+                  "%d 1:%d:2030-01-%02d:2000:2130:50:99:Show %d~Episode %d:"
+                  "<epgsearch>mock</epgsearch>",
+                  i + 1, i % 100 + 1, i % 28 + 1, i, i);
+    buf_end (&server->timers);
+
+    for (i = 0; i < c->channels; i++)
+        buf_line (&server->channels, 250,
+                  "%d Channel %d;Mock:%d:hC34:S19.2E:27500:%d:%d=deu:%d:0:%d:1:1101:0",
+                  i + 1, i + 1, 10000 + i, 100 + i, 200 + i, 300 + i, 28000 + i);
+    buf_end (&server->channels);
+
+    /* events are spread evenly over a few channels */
+    channels = c->events > 100 ? 10 : 1;
+    for (ch = 0; c->events && ch < channels; ch++) {
+        int first = ch * c->events / channels;
+        int last = (ch + 1) * c->events / channels;
+
+        buf_line (&server->epg, 215, "C S19.2E-1-1101-%d Channel %d",
+                  28000 + ch, ch + 1);
+        for (i = first; i < last; i++) {
+            buf_line (&server->epg, 215, "E %d %ld 1800 4E 1",
+                      i, (long) now + (i - first) * 1800L);
+            buf_line (&server->epg, 215, "T Title %d", i);
+            buf_line (&server->epg, 215, "S Short text of event %d", i);
+            buf_line (&server->epg, 215, "D Description of event %d.|"
+                      "It spans several lines.", i);
+            buf_line (&server->epg, 215, "X 1 01 deu 4:3");
+            buf_line (&server->epg, 215, "V %ld", (long) now);
+            buf_line (&server->epg, 215, "e");
+        }
+        buf_line (&server->epg, 215, "c");
+    }
+    buf_printf (&server->epg, "215 End of EPG data\r\n");
+    server->epg.lines++;
+}
+
+static int mock_load_script (mock_server_t *server, const char *path)
+{
+    char line[MOCK_LINE_SIZE];
+    FILE *f;
+    int i;
+
+    f = fopen (path, "r");
+    if (!f)
+        return -1;
+
+    while (fgets (line, sizeof (line), f)) {
+        mock_reply_t *reply = NULL;
+        char verb[5];
+        int code, pos = 0;
+
+        line[strcspn (line, "\r\n")] = '\0';
+        if (line[0] == '#' || sscanf (line, "%4s %d %n", verb, &code, &pos) < 2)
+            continue;
+
+        for (i = 0; i < server->script_count; i++)
+            if (!strcasecmp (server->script[i].verb, verb))
+                reply = &server->script[i];
+
+        if (!reply) {
+            mock_reply_t *script;
+
+            script = realloc (server->script, (server->script_count + 1)
+                              * sizeof (mock_reply_t));
+            if (!script)
+                break;
+            server->script = script;
+            reply = &server->script[server->script_count++];
+            memset (reply, 0, sizeof (mock_reply_t));
+            strcpy (reply->verb, verb);
+        }
+
+        buf_line (&reply->buf, code, "%s", line + pos);
+    }
+
+    for (i = 0; i < server->script_count; i++)
+        buf_end (&server->script[i].buf);
+
+    fclose (f);
+
+    return 0;
+}
+
+static int mock_write (mock_peer_t *peer, const char *data, size_t len)
+{
+    if (peer->pipe)
+        return svdrp_memory_pipe_reply (peer->pipe, data, len) == SVDRP_OK ? 0 : -1;
+
+    while (len > 0) {
+        ssize_t ret = send (peer->fd, data, len, MSG_NOSIGNAL);
+
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += ret;
+        len -= ret;
+    }
+
+    return 0;
+}
+
+/* answer a command, returns -1 when the connection has to be closed */
+static int mock_reply (mock_server_t *server, mock_peer_t *peer, char *cmd)
+{
+    char reply[MOCK_LINE_SIZE];
+    char *args;
+    int i;
+
+    args = cmd + strcspn (cmd, " \t");
+    if (*args)
+        *args++ = '\0';
+
+    if (server->config.latency)
+        usleep (server->config.latency);
+
+    for (i = 0; i < server->script_count; i++)
+        if (!strcasecmp (server->script[i].verb, cmd))
+            return mock_write (peer, server->script[i].buf.data,
+                               server->script[i].buf.len);
+
+    if (!strcasecmp (cmd, "QUIT")) {
+        mock_write (peer, "221 mockvdr closing connection\r\n", 32);
+        return -1;
+    }
+    else if (!strcasecmp (cmd, "LSTT") && *args) {
+        int id = atoi (args);
+
+        if (id < 1 || id > server->config.timers)
+            snprintf (reply, sizeof (reply),
+                      "501 Timer \"%.64s\" not defined\r\n", args);
+        else
+            snprintf (reply, sizeof (reply),
+                      "250 %d 1:%d:2030-01-%02d:2000:2130:50:99:Show %d~Episode %d:"
+                      "<epgsearch>mock</epgsearch>\r\n",
+                      id, (id - 1) % 100 + 1, (id - 1) % 28 + 1, id - 1, id - 1);
+        return mock_write (peer, reply, strlen (reply));
+    }
+    else if (!strcasecmp (cmd, "LSTT") || !strcasecmp (cmd, "LSTC")) {
+        mock_buf_t *buf = !strcasecmp (cmd, "LSTT") ?
+            &server->timers : &server->channels;
+
+        if (!buf->len)
+            snprintf (reply, sizeof (reply), "550 No %s defined\r\n",
+                      buf == &server->timers ? "timers" : "channels");
+        else
+            return mock_write (peer, buf->data, buf->len);
+    }
+    else if (!strcasecmp (cmd, "LSTE"))
+        return mock_write (peer, server->epg.data, server->epg.len);
+    else if (!strcasecmp (cmd, "NEXT"))
+        snprintf (reply, sizeof (reply), "250 1 %ld\r\n",
+                  (long) time (NULL) + 3600);
+    else if (!strcasecmp (cmd, "STAT"))
+        snprintf (reply, sizeof (reply), "250 100000MB 50000MB 50%%\r\n");
+    else if (!strcasecmp (cmd, "HELP"))
+        snprintf (reply, sizeof (reply),
+                  "214-Topics:\r\n214-    LSTC LSTE LSTT NEXT QUIT STAT\r\n"
+                  "214 End of HELP info\r\n");
+    else if (!strcasecmp (cmd, "CLRE") || !strcasecmp (cmd, "HITK")
+             || !strcasecmp (cmd, "MESG") || !strcasecmp (cmd, "VOLU")
+             || !strcasecmp (cmd, "SCAN") || !strcasecmp (cmd, "REMO")
+             || !strcasecmp (cmd, "DELT") || !strcasecmp (cmd, "MODT")
+             || !strcasecmp (cmd, "NEWT"))
+        snprintf (reply, sizeof (reply), "250 OK\r\n");
+    else
+        snprintf (reply, sizeof (reply), "500 Command unrecognized: \"%.64s\"\r\n",
+                  cmd);
+
+    return mock_write (peer, reply, strlen (reply));
+}
+
+void mock_server_memory (void *data, svdrp_memory_pipe_t *pipe,
+                         const char *cmd, size_t len)
+{
+    mock_peer_t peer = { -1, pipe };
+    char buf[MOCK_LINE_SIZE];
+
+    if (!cmd) {
+        mock_write (&peer, MOCK_BANNER, strlen (MOCK_BANNER));
+        return;
+    }
+
+    if (len >= sizeof (buf))
+        len = sizeof (buf) - 1;
+    memcpy (buf, cmd, len);
+    buf[len] = '\0';
+
+    if (mock_reply (data, &peer, buf) < 0)
+        svdrp_memory_pipe_hangup (pipe);
+}
+
+static void mock_forget_client (mock_server_t *server, int fd)
+{
+    int i;
+
+    pthread_mutex_lock (&server->lock);
+    for (i = 0; i < server->client_count; i++)
+        if (server->clients[i] == fd) {
+            server->clients[i] = server->clients[--server->client_count];
+            break;
+        }
+    close (fd);
+    pthread_cond_broadcast (&server->cond);
+    pthread_mutex_unlock (&server->lock);
+}
+
+static void *mock_client_thread (void *arg)
+{
+    mock_client_t *client = arg;
+    mock_server_t *server = client->server;
+    char buf[MOCK_LINE_SIZE];
+    size_t len = 0;
+    int fd = client->fd;
+    mock_peer_t peer = { fd, NULL };
+
+    free (client);
+
+    if (mock_write (&peer, MOCK_BANNER, strlen (MOCK_BANNER)) < 0)
+        goto out;
+
+    for (;;) {
+        ssize_t ret;
+        char *eol;
+
+        /* answer every complete command, pipelined ones included */
+        while ((eol = memchr (buf, '\n', len))) {
+            size_t used = eol - buf + 1;
+
+            *eol = '\0';
+            if (eol > buf && eol[-1] == '\r')
+                eol[-1] = '\0';
+
+            if (mock_reply (server, &peer, buf) < 0)
+                goto out;
+
+            memmove (buf, buf + used, len - used);
+            len -= used;
+        }
+
+        if (len == sizeof (buf))
+            len = 0;              /* overlong command, drop it */
+
+        ret = recv (fd, buf + len, sizeof (buf) - len, 0);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            break;
+        len += ret;
+    }
+
+ out:
+    mock_forget_client (server, fd);
+
+    return NULL;
+}
+
+static void *mock_accept_thread (void *arg)
+{
+    mock_server_t *server = arg;
+
+    for (;;) {
+        mock_client_t *client;
+        pthread_t thread;
+        int fd;
+
+        fd = accept (server->listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;                /* the listener was shut down */
+        }
+
+        pthread_mutex_lock (&server->lock);
+        if (server->client_count == MOCK_MAX_CLIENTS
+            || !(client = malloc (sizeof (mock_client_t)))) {
+            pthread_mutex_unlock (&server->lock);
+            close (fd);
+            continue;
+        }
+        server->clients[server->client_count++] = fd;
+        pthread_mutex_unlock (&server->lock);
+
+        client->server = server;
+        client->fd = fd;
+        if (pthread_create (&thread, NULL, mock_client_thread, client)) {
+            mock_forget_client (server, fd);
+            free (client);
+            continue;
+        }
+        pthread_detach (thread);
+    }
+
+    return NULL;
+}
+
+/* listen to the loopback, or to a Unix socket */
+static int mock_listen (mock_server_t *server, int port)
+{
+    struct sockaddr_in addr;
+    struct sockaddr_un path;
+    socklen_t len = sizeof (addr);
+    int one = 1;
+
+    server->listener = -1;
+
+    if (server->config.path) {
+        if (strlen (server->config.path) >= sizeof (path.sun_path))
+            return -1;
+
+        memset (&path, 0, sizeof (path));
+        path.sun_family = AF_UNIX;
+        strcpy (path.sun_path, server->config.path);
+        unlink (server->config.path);
+
+        server->listener = socket (AF_UNIX, SOCK_STREAM, 0);
+        if (server->listener < 0)
+            return -1;
+
+        if (bind (server->listener, (struct sockaddr *) &path, sizeof (path)) < 0
+            || listen (server->listener, 128) < 0)
+            return -1;
+
+        return 0;
+    }
+
+    server->listener = socket (AF_INET, SOCK_STREAM, 0);
+    if (server->listener < 0)
+        return -1;
+    setsockopt (server->listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    addr.sin_port = htons (port);
+
+    if (bind (server->listener, (struct sockaddr *) &addr, sizeof (addr)) < 0
+        || listen (server->listener, 128) < 0
+        || getsockname (server->listener, (struct sockaddr *) &addr, &len) < 0)
+        return -1;
+
+    server->port = ntohs (addr.sin_port);
+
+    return 0;
+}
+
+mock_server_t *mock_server_start (const mock_config_t *config, int port)
+{
+    mock_server_t *server;
+
+    server = calloc (1, sizeof (mock_server_t));
+    if (!server)
+        return NULL;
+
+    server->config = *config;
+    pthread_mutex_init (&server->lock, NULL);
+    pthread_cond_init (&server->cond, NULL);
+
+    if (config->script && mock_load_script (server, config->script) < 0) {
+        fprintf (stderr, "Cannot read script %s\n", config->script);
+        goto err;
+    }
+
+    mock_generate (server);
+
+    if (mock_listen (server, port) < 0) {
+        if (server->listener < 0)
+            goto err;
+        goto err_listener;
+    }
+
+    if (pthread_create (&server->thread, NULL, mock_accept_thread, server))
+        goto err_listener;
+
+    return server;
+
+ err_listener:
+    close (server->listener);
+ err:
+    server->listener = -1;
+    mock_server_stop (server);
+    return NULL;
+}
+
+int mock_server_port (mock_server_t *server)
+{
+    return server->port;
+}
+
+int mock_server_lines (mock_server_t *server, const char *verb)
+{
+    if (!strcasecmp (verb, "LSTT"))
+        return server->timers.lines;
+    if (!strcasecmp (verb, "LSTC"))
+        return server->channels.lines;
+    if (!strcasecmp (verb, "LSTE"))
+        return server->epg.lines;
+
+    return -1;
+}
+
+void mock_server_stop (mock_server_t *server)
+{
+    int i;
+
+    if (!server)
+        return;
+
+    if (server->listener >= 0) {
+        shutdown (server->listener, SHUT_RDWR);
+        pthread_join (server->thread, NULL);
+        close (server->listener);
+        if (server->config.path)
+            unlink (server->config.path);
+    }
+
+    /* wait for the clients to go away */
+    pthread_mutex_lock (&server->lock);
+    for (i = 0; i < server->client_count; i++)
+        shutdown (server->clients[i], SHUT_RDWR);
+    while (server->client_count)
+        pthread_cond_wait (&server->cond, &server->lock);
+    pthread_mutex_unlock (&server->lock);
+
+    pthread_cond_destroy (&server->cond);
+    pthread_mutex_destroy (&server->lock);
+
+    for (i = 0; i < server->script_count; i++)
+        free (server->script[i].buf.data);
+    free (server->script);
+    free (server->timers.data);
+    free (server->channels.data);
+    free (server->epg.data);
+    free (server);
+}
@@ -0,0 +1,99 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef SVDRP_BENCH_MOCK_H
+#define SVDRP_BENCH_MOCK_H
+
+#include <svdrp.h>
+
+/**
+ * \file mock.h
+ *
+ * Local mock VDR server speaking SVDRP, for the benchmarks.
+ */
+
+/** \brief Content and behaviour of a mock server. */
+typedef struct mock_config_s {
+    int timers;                   /**< timers listed by LSTT */
+    int channels;                 /**< channels listed by LSTC */
+    int events;                   /**< EPG events listed by LSTE */
+    int latency;                  /**< delay before each reply, in us */
+    const char *script;           /**< file of replies to use, may be NULL */
+    const char *path;             /**< Unix socket to listen to instead of TCP */
+} mock_config_t;
+
+typedef struct mock_server_s mock_server_t;
+
+/**
+ * \brief Start a mock server in the background.
+ *
+ * \param[in] config       content and behaviour of the server
+ * \param[in] port         TCP port to listen to on the loopback, 0 for any,
+ *                         unused when listening to a Unix socket
+ * \return                 a running server, NULL on error
+ *
+ * The synthetic data is generated once, every client is served by its own
+ * thread. A script holds lines of the form "VERB CODE TEXT"; the lines of
+ * a verb make up its reply, replacing the built-in one.
+ */
+mock_server_t *mock_server_start(const mock_config_t *config, int port);
+
+/**
+ * \brief Get the port a mock server listens to.
+ *
+ * \param[in] server       a running server
+ * \return                 the TCP port
+ */
+int mock_server_port(mock_server_t *server);
+
+/**
+ * \brief Get the number of lines of a generated reply.
+ *
+ * \param[in] server       a running server
+ * \param[in] verb         LSTT, LSTC or LSTE
+ * \return                 lines of the reply, -1 for other verbs
+ */
+int mock_server_lines(mock_server_t *server, const char *verb);
+
+/**
+ * \brief Answer the commands of an in-memory connection.
+ *
+ * \param[in] data         a running server
+ * \param[in] pipe         server end of the connection
+ * \param[in] cmd          command line, NULL for the banner
+ * \param[in] len          length of the command line
+ *
+ * An svdrp_memory_handler_t serving the same content as the server
+ * does over the network, without its threads.
+ */
+void mock_server_memory(void *data, svdrp_memory_pipe_t *pipe,
+                        const char *cmd, size_t len);
+
+/**
+ * \brief Stop a mock server.
+ *
+ * \param[in] server       a running server
+ *
+ * The clients still connected are disconnected.
+ */
+void mock_server_stop(mock_server_t *server);
+
+#endif /* SVDRP_BENCH_MOCK_H */
@@ -0,0 +1,116 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "mock.h"
+
+static volatile sig_atomic_t stop;
+
+static void on_signal (int sig)
+{
+    (void) sig;
+    stop = 1;
+}
+
+int main (int argc, char **argv)
+{
+    mock_config_t config = { 100, 100, 1000, 0, NULL, NULL };
+    mock_server_t *server;
+    int port = 2001;
+    int option;
+
+    const char *const short_options = "p:u:t:c:e:l:s:h";
+    const struct option long_options [] = {
+        {"port", required_argument, NULL, 'p'},
+        {"unix", required_argument, NULL, 'u'},
+        {"timers", required_argument, NULL, 't'},
+        {"channels", required_argument, NULL, 'c'},
+        {"events", required_argument, NULL, 'e'},
+        {"latency", required_argument, NULL, 'l'},
+        {"script", required_argument, NULL, 's'},
+        {"help", no_argument, NULL, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    while ((option = getopt_long (argc, argv, short_options, long_options, NULL)) > 0) {
+        switch (option)
+        {
+            case 'p':
+                port = atoi (optarg);
+                break;
+            case 'u':
+                config.path = optarg;
+                break;
+            case 't':
+                config.timers = atoi (optarg);
+                break;
+            case 'c':
+                config.channels = atoi (optarg);
+                break;
+            case 'e':
+                config.events = atoi (optarg);
+                break;
+            case 'l':
+                config.latency = atoi (optarg);
+                break;
+            case 's':
+                config.script = optarg;
+                break;
+            case 'h':
+            default:
+                fprintf (stderr, "usage: %s [-h|--help] [-p|--port <port>] [-u|--unix <path>] [-t|--timers <count>] [-c|--channels <count>] [-e|--events <count>] [-l|--latency <us>] [-s|--script <file>]\n" \
+                         "   note: a script holds 'VERB CODE TEXT' lines, the lines of a verb replace its built-in reply.\n", argv[0]);
+                return -1;
+        }
+    }
+
+    server = mock_server_start (&config, port);
+    if (!server) {
+        if (config.path)
+            fprintf (stderr, "Cannot start the mock server on %s\n", config.path);
+        else
+            fprintf (stderr, "Cannot start the mock server on port %i\n", port);
+        return 1;
+    }
+
+    signal (SIGINT, on_signal);
+    signal (SIGTERM, on_signal);
+
+    if (config.path)
+        printf ("Mock VDR listening on %s", config.path);
+    else
+        printf ("Mock VDR listening on 127.0.0.1:%i", mock_server_port (server));
+    printf (" (%i timers, %i channels, %i EPG lines)\n",
+            config.timers, config.channels, mock_server_lines (server, "LSTE"));
+    fflush (stdout);
+
+    while (!stop)
+        pause ();
+
+    mock_server_stop (server);
+
+    return 0;
+}
@@ -23,11 +23,68 @@
 #include <time.h>
 #include <stdio.h>
 #include <svdrp.h>
+#include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
 
 #define DEFAULT_WAKEUP_MARGIN 10
 
+static void next_timer_cb (void *data, int host, int code,
+                           const char *line, size_t len, int last)
+{
+    time_t *times = data;
+    const char *stamp;
+
+    (void) len;
+    (void) last;
+
+    /* 250 <timer id> <time> */
+    if (code == SVDRP_REPLY_OK && (stamp = strchr (line, ' ')))
+        times[host] = atol (stamp + 1);
+}
+
+/* query every host at once, keep the earliest timer */
+static int next_timer_multi (char *hosts, int port, int timeout,
+                             svdrp_verbosity_level_t verbosity, time_t *time)
+{
+    svdrp_multi_t *multi;
+    time_t *times;
+    char *host;
+    int i, count;
+
+    multi = svdrp_multi_new (timeout, verbosity);
+    if (!multi)
+        return SVDRP_ERROR;
+
+    for (host = strtok (hosts, ","); host; host = strtok (NULL, ","))
+        svdrp_multi_add_host (multi, host, port);
+
+    count = svdrp_multi_count (multi);
+    times = calloc (count ? count : 1, sizeof (time_t));
+    if (!times) {
+        svdrp_multi_free (multi);
+        return SVDRP_ERROR;
+    }
+
+    svdrp_multi_command (multi, "NEXT abs", next_timer_cb, times);
+    svdrp_multi_run (multi, 0);
+
+    *time = 0;
+    for (i = 0; i < count; i++) {
+        if (svdrp_multi_status (multi, i) == SVDRP_ERROR)
+            fprintf (stderr, "Query of %s failed\n",
+                     svdrp_get_property (svdrp_multi_get (multi, i),
+                                         SVDRP_PROPERTY_HOSTNAME));
+        else if (times[i] && (!*time || times[i] < *time))
+            *time = times[i];
+    }
+
+    free (times);
+    svdrp_multi_free (multi);
+
+    return *time ? SVDRP_OK : SVDRP_ERROR;
+}
+
 int main (int argc, char **argv)
 {
     char *hostname = "localhost";
@@ -44,8 +101,10 @@ int main (int argc, char **argv)
     int option = -1;
     int wakeup_margin = DEFAULT_WAKEUP_MARGIN;
 
-    const char *const short_options = "v:lm:h";
+    const char *const short_options = "H:p:v:lm:h";
     const struct option long_options [] = {
+        {"host", required_argument, NULL, 'H'},
+        {"port", required_argument, NULL, 'p'},
         {"verbose", required_argument, NULL, 'v'},
         {"localtime", no_argument, NULL, 'l'},
         {"help", no_argument, NULL, 'h'},
@@ -56,6 +115,12 @@ int main (int argc, char **argv)
     while ((option=getopt_long(argc, argv, short_options, long_options, NULL))>0) {
         switch(option)
         {
+            case 'H':
+                hostname=optarg;
+                break;
+            case 'p':
+                port=atoi(optarg);
+                break;
             case 'v':
                 if (!strcmp(optarg, "none")) verbosity=SVDRP_MSG_NONE;
                 else if (!strcmp(optarg, "verbose")) verbosity=SVDRP_MSG_VERBOSE;
@@ -74,20 +139,27 @@ int main (int argc, char **argv)
                 break;
             case 'h':
             default:
-                fprintf(stderr, "usage: %s [-h|--help] [-l|--localtime] [-m|--wakeup-margin <minutes>] [-v|--verbose] [none|verbose|info|warning|error|critical]]\n" \
-                        "   note: if your hardware clock runs on localtime, use -l for being able to use the output as bios wakeup time.\n", argv[0]);
+                fprintf(stderr, "usage: %s [-h|--help] [-H|--host <host>[,<host>...]] [-p|--port <port>] [-l|--localtime] [-m|--wakeup-margin <minutes>] [-v|--verbose] [none|verbose|info|warning|error|critical]]\n" \
+                        "   note: if your hardware clock runs on localtime, use -l for being able to use the output as bios wakeup time.\n" \
+                        "   note: with several hosts, all of them are queried at once and the earliest timer is used.\n", argv[0]);
                 return -1;
         }
     }
 
-    svdrp = svdrp_open(hostname, port, timeout, verbosity);
+    if (strchr(hostname, ',')) {
+        ret = next_timer_multi(hostname, port, timeout, verbosity, &time);
+    } else {
+        svdrp = svdrp_open(hostname, port, timeout, verbosity);
+
+        if(!svdrp_is_connected(svdrp)) {
+            fprintf(stderr, "Connection failed\n");
+            return 2;
+        }
 
-    if(!svdrp_is_connected(svdrp)) {
-        fprintf(stderr, "Connection failed\n");
-        return 2;
+        ret = svdrp_next_timer_event(svdrp, &timer_id, &time);
+        svdrp_close(svdrp);
     }
 
-    ret = svdrp_next_timer_event(svdrp, &timer_id, &time);
     if (ret == SVDRP_OK) {
         localtime_r(&time, &tm);
         if (convert_time)
@@ -96,10 +168,8 @@ int main (int argc, char **argv)
         mktime(&tm);
         strftime(time_str, 256, "%s", &tm);
         printf("%s\n", time_str);
-        svdrp_close(svdrp);
         return 0;
     } else {
-        svdrp_close(svdrp);
         return 1;
     }
 }
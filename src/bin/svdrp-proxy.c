@@ -0,0 +1,790 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * VDR serves one SVDRP client at a time. The proxy holds the only
+ * connection to VDR and lets many local clients share it: each client gets
+ * its own banner and sends commands as it would to VDR, the proxy runs
+ * them one at a time, taking turns between the clients at reply
+ * boundaries. Listings are answered from the response cache of the
+ * upstream connection until a command changes what they show. A keepalive
+ * keeps VDR from dropping the upstream connection while the clients are
+ * quiet. While VDR is down, new clients are turned away at once and the
+ * proxy tries to reconnect every few seconds.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <svdrp.h>
+
+#define DEFAULT_LISTEN_PORT 2002
+#define DEFAULT_MAX_CLIENTS 64
+#define DEFAULT_CACHE_TTL   2000
+#define DEFAULT_KEEPALIVE   60    /* VDR drops idle clients after 300 s */
+
+/* longest command line accepted from a client */
+#define PROXY_MAX_LINE (64 * 1024)
+
+/* a client reading its replies slower than this waits for its next turn */
+#define PROXY_MAX_OUTPUT (1024 * 1024)
+
+/* delay between two connection attempts while VDR is down, in ms */
+#define PROXY_RECONNECT_DELAY 5000
+
+typedef struct proxy_buf_s {
+    char *data;
+    size_t pos;                   /* first byte not consumed yet */
+    size_t len;
+    size_t size;
+} proxy_buf_t;
+
+typedef struct proxy_client_s {
+    struct proxy_client_s *next;
+    int fd;
+    int listener;                 /* listening socket, not a client */
+    int events;                   /* events registered with epoll */
+    int closing;                  /* closed once its output is flushed */
+    int dead;                     /* freed at the end of the loop */
+    proxy_buf_t in;               /* command lines received */
+    proxy_buf_t out;              /* reply lines not sent yet */
+} proxy_client_t;
+
+typedef struct proxy_s {
+    svdrp_t *svdrp;
+    int epfd;
+    proxy_client_t listeners[2];  /* TCP, then Unix socket */
+    proxy_client_t *clients;      /* in turn order */
+    int count;
+    int max_clients;
+    long long reconnect_at;       /* next connection attempt, in ms */
+    int keepalive;                /* interval of the upstream no-op, in s */
+    long long keepalive_at;       /* next call to svdrp_keepalive(), in ms */
+} proxy_t;
+
+static volatile sig_atomic_t stop;
+
+static void on_signal (int sig)
+{
+    (void) sig;
+    stop = 1;
+}
+
+static int buf_append (proxy_buf_t *buf, const char *data, size_t len)
+{
+    if (buf->pos && buf->pos == buf->len)
+        buf->pos = buf->len = 0;
+
+    if (buf->len + len > buf->size) {
+        size_t size = buf->size ? buf->size : 1024;
+        char *tmp;
+
+        /* make room by dropping the consumed bytes first */
+        if (buf->pos) {
+            memmove (buf->data, buf->data + buf->pos, buf->len - buf->pos);
+            buf->len -= buf->pos;
+            buf->pos = 0;
+        }
+
+        while (size < buf->len + len)
+            size *= 2;
+
+        if (size > buf->size) {
+            tmp = realloc (buf->data, size);
+            if (!tmp)
+                return -1;
+            buf->data = tmp;
+            buf->size = size;
+        }
+    }
+
+    memcpy (buf->data + buf->len, data, len);
+    buf->len += len;
+
+    return 0;
+}
+
+static int client_printf (proxy_client_t *client, const char *fmt, ...)
+    __attribute__ ((format (printf, 2, 3)));
+
+static int client_printf (proxy_client_t *client, const char *fmt, ...)
+{
+    char line[512];
+    va_list va;
+    int len;
+
+    va_start (va, fmt);
+    len = vsnprintf (line, sizeof (line), fmt, va);
+    va_end (va);
+
+    if (len < 0)
+        return -1;
+    if (len >= (int) sizeof (line))
+        len = sizeof (line) - 1;
+
+    return buf_append (&client->out, line, len);
+}
+
+static void client_flush (proxy_client_t *client)
+{
+    ssize_t ret;
+
+    while (client->out.pos < client->out.len) {
+        ret = send (client->fd, client->out.data + client->out.pos,
+                    client->out.len - client->out.pos,
+                    MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                client->dead = 1;
+            return;
+        }
+        client->out.pos += ret;
+    }
+
+    client->out.pos = client->out.len = 0;
+
+    if (client->closing)
+        client->dead = 1;
+}
+
+/* forward a reply line as VDR sent it */
+static void proxy_reply_cb (void *data, int code,
+                            const char *line, size_t len, int last)
+{
+    proxy_client_t *client = data;
+    char prefix[5];
+
+    snprintf (prefix, sizeof (prefix), "%03d%c", code, last ? ' ' : '-');
+    if (buf_append (&client->out, prefix, 4) < 0
+        || buf_append (&client->out, line, len) < 0
+        || buf_append (&client->out, "\r\n", 2) < 0)
+        client->dead = 1;
+}
+
+static long long proxy_now_ms (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* the banner of VDR, as of the last upstream connection */
+static int proxy_banner (proxy_t *proxy, proxy_client_t *client)
+{
+    const char *name, *version, *charset;
+    char date[64];
+    struct tm tm;
+    time_t now;
+
+    /* reconnecting is up to proxy_run(), the other clients must not wait */
+    name = svdrp_get_property (proxy->svdrp, SVDRP_PROPERTY_NAME);
+    version = svdrp_get_property (proxy->svdrp, SVDRP_PROPERTY_VERSION);
+    charset = svdrp_get_property (proxy->svdrp, SVDRP_PROPERTY_CHARSET);
+
+    if (!svdrp_is_connected (proxy->svdrp) || !name) {
+        client_printf (client, "%03d VDR is not reachable: %s\r\n",
+                       SVDRP_REPLY_TRANSACTION_FAILED,
+                       svdrp_strerror (svdrp_get_error (proxy->svdrp)));
+        return -1;
+    }
+
+    now = time (NULL);
+    localtime_r (&now, &tm);
+    strftime (date, sizeof (date), "%a %b %e %H:%M:%S %Y", &tm);
+
+    if (charset)
+        return client_printf (client, "%03d %s SVDRP VideoDiskRecorder %s; %s; %s\r\n",
+                              SVDRP_REPLY_READY, name, version ? version : "",
+                              date, charset);
+
+    return client_printf (client, "%03d %s SVDRP VideoDiskRecorder %s; %s\r\n",
+                          SVDRP_REPLY_READY, name, version ? version : "", date);
+}
+
+static void proxy_sync_client (proxy_t *proxy, proxy_client_t *client)
+{
+    struct epoll_event ev;
+    int events = 0;
+
+    if (client->dead)
+        return;
+
+    /* stop reading while a line is too long or the replies pile up */
+    if (!client->closing && client->in.len - client->in.pos < PROXY_MAX_LINE
+        && client->out.len - client->out.pos < PROXY_MAX_OUTPUT)
+        events |= EPOLLIN;
+    if (client->out.pos < client->out.len)
+        events |= EPOLLOUT;
+
+    if (events == client->events)
+        return;
+
+    memset (&ev, 0, sizeof (ev));
+    ev.events = events;
+    ev.data.ptr = client;
+    epoll_ctl (proxy->epfd, EPOLL_CTL_MOD, client->fd, &ev);
+    client->events = events;
+}
+
+static void proxy_accept (proxy_t *proxy, proxy_client_t *listener)
+{
+    proxy_client_t *client, **tail;
+    struct epoll_event ev;
+    int fd, one = 1;
+
+    fd = accept4 (listener->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    if (listener == &proxy->listeners[0])
+        setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+
+    client = calloc (1, sizeof (proxy_client_t));
+    if (!client) {
+        close (fd);
+        return;
+    }
+    client->fd = fd;
+
+    if (proxy->count >= proxy->max_clients) {
+        client_printf (client, "%03d Too many clients, try again later\r\n",
+                       SVDRP_REPLY_TRANSACTION_FAILED);
+        client->closing = 1;
+    }
+    else if (proxy_banner (proxy, client) < 0)
+        client->closing = 1;
+
+    memset (&ev, 0, sizeof (ev));
+    ev.data.ptr = client;
+    if (epoll_ctl (proxy->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        close (fd);
+        free (client->out.data);
+        free (client);
+        return;
+    }
+
+    /* newcomers take their turn after everybody else */
+    for (tail = &proxy->clients; *tail; tail = &(*tail)->next)
+        ;
+    *tail = client;
+    proxy->count++;
+
+    client_flush (client);
+}
+
+static void proxy_read (proxy_client_t *client)
+{
+    char data[4096];
+    ssize_t ret;
+
+    for (;;) {
+        ret = recv (client->fd, data, sizeof (data), MSG_DONTWAIT);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                client->dead = 1;
+            return;
+        }
+
+        /* the client went away, its last replies have nowhere to go */
+        if (!ret) {
+            client->dead = 1;
+            return;
+        }
+
+        if (buf_append (&client->in, data, ret) < 0) {
+            client->dead = 1;
+            return;
+        }
+
+        if (client->in.len - client->in.pos >= PROXY_MAX_LINE)
+            return;
+    }
+}
+
+/* next complete command line of a client, NUL-terminated in place */
+static char *client_next_line (proxy_client_t *client)
+{
+    char *line, *end;
+    size_t len;
+
+    line = client->in.data + client->in.pos;
+    len = client->in.len - client->in.pos;
+
+    end = len ? memchr (line, '\n', len) : NULL;
+    if (!end)
+        return NULL;
+
+    client->in.pos += end - line + 1;
+    *end = '\0';
+    if (end > line && end[-1] == '\r')
+        end[-1] = '\0';
+
+    return line;
+}
+
+static int is_verb (const char *line, const char *verb)
+{
+    return !strncasecmp (line, verb, 4) && (!line[4] || line[4] == ' ');
+}
+
+static void proxy_run_command (proxy_t *proxy, proxy_client_t *client,
+                               const char *line)
+{
+    const char *name;
+    int code;
+
+    /* the upstream connection is not the client's to close */
+    if (is_verb (line, "QUIT")) {
+        name = svdrp_get_property (proxy->svdrp, SVDRP_PROPERTY_NAME);
+        client_printf (client, "%03d %s closing connection\r\n",
+                       SVDRP_REPLY_QUIT, name ? name : "proxy");
+        client->closing = 1;
+        client->in.pos = client->in.len;
+        return;
+    }
+
+    /* the EPG data lines would be taken for commands of their own */
+    if (is_verb (line, "PUTE")) {
+        client_printf (client, "%03d PUTE is not available through the proxy\r\n",
+                       SVDRP_REPLY_UNIMPEMENTED_CMD);
+        return;
+    }
+
+    code = svdrp_command (proxy->svdrp, line, proxy_reply_cb, client);
+    if (code == SVDRP_ERROR)
+        client_printf (client, "%03d %s\r\n", SVDRP_REPLY_ABORT,
+                       svdrp_strerror (svdrp_get_error (proxy->svdrp)));
+}
+
+/* one command of every client with one waiting, in turn */
+static int proxy_round (proxy_t *proxy)
+{
+    proxy_client_t *client;
+    int count = 0;
+
+    for (client = proxy->clients; client; client = client->next) {
+        char *line;
+
+        if (client->dead || client->closing
+            || client->out.len - client->out.pos >= PROXY_MAX_OUTPUT)
+            continue;
+
+        /* empty lines get no reply from VDR either */
+        while ((line = client_next_line (client)) && !*line)
+            ;
+
+        if (!line) {
+            if (client->in.len - client->in.pos >= PROXY_MAX_LINE) {
+                client_printf (client, "%03d Command line too long\r\n",
+                               SVDRP_REPLY_UNKNOWN_CMD);
+                client->closing = 1;
+            }
+            continue;
+        }
+
+        proxy_run_command (proxy, client, line);
+        client_flush (client);
+        count++;
+    }
+
+    return count;
+}
+
+static void proxy_sweep (proxy_t *proxy)
+{
+    proxy_client_t **prev = &proxy->clients;
+
+    while (*prev) {
+        proxy_client_t *client = *prev;
+
+        if (!client->dead) {
+            prev = &client->next;
+            continue;
+        }
+
+        *prev = client->next;
+        close (client->fd);
+        free (client->in.data);
+        free (client->out.data);
+        free (client);
+        proxy->count--;
+    }
+}
+
+static int proxy_listen_tcp (proxy_t *proxy, const char *address, int port)
+{
+    proxy_client_t *listener = &proxy->listeners[0];
+    struct addrinfo hints, *res, *ai;
+    char service[16];
+    int fd = -1, one = 1;
+
+    memset (&hints, 0, sizeof (hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    snprintf (service, sizeof (service), "%i", port);
+
+    if (getaddrinfo (address, service, &hints, &res))
+        return -1;
+
+    for (ai = res; ai; ai = ai->ai_next) {
+        fd = socket (ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                     ai->ai_protocol);
+        if (fd < 0)
+            continue;
+
+        setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+        if (!bind (fd, ai->ai_addr, ai->ai_addrlen) && !listen (fd, 16))
+            break;
+
+        close (fd);
+        fd = -1;
+    }
+    freeaddrinfo (res);
+
+    listener->fd = fd;
+    listener->listener = 1;
+
+    return fd;
+}
+
+static int proxy_listen_unix (proxy_t *proxy, const char *path)
+{
+    proxy_client_t *listener = &proxy->listeners[1];
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen (path) >= sizeof (addr.sun_path))
+        return -1;
+
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    strcpy (addr.sun_path, path);
+
+    fd = socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    /* a socket left behind by a previous run */
+    unlink (path);
+
+    if (bind (fd, (struct sockaddr *) &addr, sizeof (addr)) || listen (fd, 16)) {
+        close (fd);
+        return -1;
+    }
+
+    listener->fd = fd;
+    listener->listener = 1;
+
+    return fd;
+}
+
+/* how long epoll_wait() may sleep before the next connection attempt */
+static int proxy_reconnect (proxy_t *proxy)
+{
+    long long now;
+
+    if (svdrp_is_connected (proxy->svdrp))
+        return -1;
+
+    now = proxy_now_ms ();
+    if (now >= proxy->reconnect_at) {
+        svdrp_try_connect (proxy->svdrp);
+        now = proxy_now_ms ();
+        proxy->reconnect_at = now + PROXY_RECONNECT_DELAY;
+        if (svdrp_is_connected (proxy->svdrp))
+            return -1;
+    }
+
+    return (int) (proxy->reconnect_at - now);
+}
+
+/* how long epoll_wait() may sleep before the upstream is kept alive */
+static int proxy_keepalive (proxy_t *proxy)
+{
+    long long now;
+
+    if (!proxy->keepalive || !svdrp_is_connected (proxy->svdrp))
+        return -1;
+
+    /* a no-op only goes out if the connection has been idle long enough */
+    now = proxy_now_ms ();
+    if (now >= proxy->keepalive_at) {
+        svdrp_keepalive (proxy->svdrp);
+        now = proxy_now_ms ();
+        proxy->keepalive_at = now + proxy->keepalive * 1000LL;
+    }
+
+    return (int) (proxy->keepalive_at - now);
+}
+
+static int proxy_run (proxy_t *proxy)
+{
+    struct epoll_event events[64];
+    proxy_client_t *client;
+    int i, n, timeout, keepalive, ready = 0;
+
+    while (!stop) {
+        for (client = proxy->clients; client; client = client->next)
+            proxy_sync_client (proxy, client);
+
+        /* commands left over from the last round go first */
+        timeout = proxy_reconnect (proxy);
+        keepalive = proxy_keepalive (proxy);
+        if (keepalive >= 0 && (timeout < 0 || keepalive < timeout))
+            timeout = keepalive;
+        if (ready)
+            timeout = 0;
+
+        n = epoll_wait (proxy->epfd, events, 64, timeout);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        for (i = 0; i < n; i++) {
+            client = events[i].data.ptr;
+
+            if (client->listener)
+                proxy_accept (proxy, client);
+            else {
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    proxy_read (client);
+                if (events[i].events & EPOLLOUT)
+                    client_flush (client);
+            }
+        }
+
+        proxy_sweep (proxy);
+        ready = proxy_round (proxy);
+        proxy_sweep (proxy);
+    }
+
+    return 0;
+}
+
+static int parse_ttl (svdrp_t *svdrp, char *arg)
+{
+    char *ttl = strchr (arg, '=');
+
+    if (!ttl)
+        return SVDRP_ERROR;
+
+    *ttl++ = '\0';
+
+    return svdrp_cache_set_ttl (svdrp, arg, atoi (ttl));
+}
+
+int main (int argc, char **argv)
+{
+    char *hostname = "localhost";
+    int port = 2001;
+    int timeout = 10;
+    svdrp_verbosity_level_t verbosity = SVDRP_MSG_ERROR;
+    const char *address = "localhost";
+    int listen_port = DEFAULT_LISTEN_PORT;
+    const char *unix_path = NULL;
+    int cache_ttl = DEFAULT_CACHE_TTL;
+    size_t cache_size = 0;
+    char *ttls[32];
+    int ttl_count = 0;
+    proxy_t proxy;
+    proxy_client_t *client;
+    int i, option;
+
+    const char *const short_options = "H:p:t:b:l:u:n:c:T:m:k:v:h";
+    const struct option long_options [] = {
+        {"host", required_argument, NULL, 'H'},
+        {"port", required_argument, NULL, 'p'},
+        {"timeout", required_argument, NULL, 't'},
+        {"bind", required_argument, NULL, 'b'},
+        {"listen", required_argument, NULL, 'l'},
+        {"unix", required_argument, NULL, 'u'},
+        {"max-clients", required_argument, NULL, 'n'},
+        {"cache-ttl", required_argument, NULL, 'c'},
+        {"verb-ttl", required_argument, NULL, 'T'},
+        {"cache-size", required_argument, NULL, 'm'},
+        {"keepalive", required_argument, NULL, 'k'},
+        {"verbose", required_argument, NULL, 'v'},
+        {"help", no_argument, NULL, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    memset (&proxy, 0, sizeof (proxy));
+    proxy.max_clients = DEFAULT_MAX_CLIENTS;
+    proxy.keepalive = DEFAULT_KEEPALIVE;
+    proxy.listeners[0].fd = proxy.listeners[1].fd = -1;
+
+    while ((option = getopt_long (argc, argv, short_options, long_options, NULL)) > 0) {
+        switch (option)
+        {
+            case 'H':
+                hostname = optarg;
+                break;
+            case 'p':
+                port = atoi (optarg);
+                break;
+            case 't':
+                timeout = atoi (optarg);
+                break;
+            case 'b':
+                address = optarg;
+                break;
+            case 'l':
+                listen_port = atoi (optarg);
+                break;
+            case 'u':
+                unix_path = optarg;
+                break;
+            case 'n':
+                proxy.max_clients = atoi (optarg);
+                break;
+            case 'c':
+                cache_ttl = atoi (optarg);
+                break;
+            case 'T':
+                if (ttl_count < (int) (sizeof (ttls) / sizeof (ttls[0])))
+                    ttls[ttl_count++] = optarg;
+                break;
+            case 'm':
+                cache_size = strtoul (optarg, NULL, 10) * 1024;
+                break;
+            case 'k':
+                proxy.keepalive = atoi (optarg);
+                if (proxy.keepalive < 0)
+                    proxy.keepalive = 0;
+                break;
+            case 'v':
+                if (!strcmp (optarg, "none")) verbosity = SVDRP_MSG_NONE;
+                else if (!strcmp (optarg, "verbose")) verbosity = SVDRP_MSG_VERBOSE;
+                else if (!strcmp (optarg, "info")) verbosity = SVDRP_MSG_INFO;
+                else if (!strcmp (optarg, "warning")) verbosity = SVDRP_MSG_WARNING;
+                else if (!strcmp (optarg, "error")) verbosity = SVDRP_MSG_ERROR;
+                else if (!strcmp (optarg, "critical")) verbosity = SVDRP_MSG_CRITICAL;
+                else { fprintf (stderr, "invalid verbosity level: %s\n", optarg); return -1; }
+                break;
+            case 'h':
+            default:
+                fprintf (stderr, "usage: %s [-h|--help] [-H|--host <host>] [-p|--port <port>] [-t|--timeout <s>] [-b|--bind <address>] [-l|--listen <port>] [-u|--unix <path>] [-n|--max-clients <count>] [-c|--cache-ttl <ms>] [-T|--verb-ttl <verb>=<ms>] [-m|--cache-size <KiB>] [-k|--keepalive <s>] [-v|--verbose [none|verbose|info|warning|error|critical]]\n" \
+                         "   note: the clients connect to the proxy as they would to VDR, on <address>:<port> (localhost:%i by default) and on the Unix socket if any; -l 0 disables TCP.\n" \
+                         "   note: listings are answered from the cache for -c ms (%i by default, 0 disables the cache), -T overrides the TTL of one verb.\n" \
+                         "   note: the connection to VDR is kept alive with a no-op after -k s without a command (%i by default, 0 disables it).\n", argv[0], DEFAULT_LISTEN_PORT, DEFAULT_CACHE_TTL, DEFAULT_KEEPALIVE);
+                return -1;
+        }
+    }
+
+    if (!listen_port && !unix_path) {
+        fprintf (stderr, "Nothing to listen on\n");
+        return -1;
+    }
+
+    /* the replies of a client gone away must not kill the proxy */
+    signal (SIGPIPE, SIG_IGN);
+    signal (SIGINT, on_signal);
+    signal (SIGTERM, on_signal);
+
+    proxy.svdrp = svdrp_open (hostname, port, timeout, verbosity);
+    if (!proxy.svdrp) {
+        fprintf (stderr, "Cannot create the connection to VDR\n");
+        return 1;
+    }
+    if (!svdrp_is_connected (proxy.svdrp))
+        fprintf (stderr, "VDR is not reachable on %s:%i yet\n", hostname, port);
+    proxy.reconnect_at = proxy_now_ms () + PROXY_RECONNECT_DELAY;
+
+    /* VDR would drop the upstream connection while the clients are quiet */
+    svdrp_set_keepalive (proxy.svdrp, proxy.keepalive);
+    proxy.keepalive_at = proxy_now_ms () + proxy.keepalive * 1000LL;
+
+    if (cache_ttl > 0)
+        svdrp_cache_enable (proxy.svdrp, cache_ttl, cache_size);
+    for (i = 0; i < ttl_count; i++)
+        if (parse_ttl (proxy.svdrp, ttls[i]) != SVDRP_OK)
+            fprintf (stderr, "Ignoring the cache TTL %s\n", ttls[i]);
+
+    proxy.epfd = epoll_create (16);
+    if (proxy.epfd < 0) {
+        svdrp_close (proxy.svdrp);
+        return 1;
+    }
+
+    if (listen_port && proxy_listen_tcp (&proxy, address, listen_port) < 0)
+        fprintf (stderr, "Cannot listen on %s:%i\n", address, listen_port);
+    if (unix_path && proxy_listen_unix (&proxy, unix_path) < 0)
+        fprintf (stderr, "Cannot listen on %s\n", unix_path);
+
+    for (i = 0; i < 2; i++) {
+        struct epoll_event ev;
+
+        if (proxy.listeners[i].fd < 0)
+            continue;
+
+        memset (&ev, 0, sizeof (ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = &proxy.listeners[i];
+        epoll_ctl (proxy.epfd, EPOLL_CTL_ADD, proxy.listeners[i].fd, &ev);
+    }
+
+    if (proxy.listeners[0].fd < 0 && proxy.listeners[1].fd < 0) {
+        close (proxy.epfd);
+        svdrp_close (proxy.svdrp);
+        return 1;
+    }
+
+    proxy_run (&proxy);
+
+    for (client = proxy.clients; client; client = client->next)
+        client->dead = 1;
+    proxy_sweep (&proxy);
+
+    for (i = 0; i < 2; i++)
+        if (proxy.listeners[i].fd >= 0)
+            close (proxy.listeners[i].fd);
+    if (unix_path && proxy.listeners[1].fd >= 0)
+        unlink (unix_path);
+
+    close (proxy.epfd);
+    svdrp_close (proxy.svdrp);
+
+    return 0;
+}
@@ -0,0 +1,234 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "svdrp.h"
+#include "svdrp_internals.h"
+
+/* alignment of every allocation, enough for any member of the snapshots */
+#define ARENA_ALIGN 16
+#define ARENA_ROUND(size) (((size) + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1))
+
+#define ARENA_DEFAULT_CHUNK_SIZE 65536
+
+typedef struct arena_chunk_s {
+    struct arena_chunk_s *next;
+    size_t size;                  /* bytes available after the header */
+    size_t used;
+} arena_chunk_t;
+
+#define ARENA_HEADER ARENA_ROUND (sizeof (arena_chunk_t))
+
+/* larger sizes would wrap around once rounded up and given a header */
+#define ARENA_MAX_SIZE (SIZE_MAX - ARENA_HEADER - ARENA_ALIGN)
+
+struct svdrp_arena_s {
+    arena_chunk_t *chunks;
+    arena_chunk_t *current;       /* chunk being filled */
+    size_t chunk_size;
+    size_t used;                  /* bytes handed out since the last reset */
+};
+
+svdrp_arena_t *svdrp_arena_new (size_t chunk_size)
+{
+    svdrp_arena_t *arena;
+
+    if (chunk_size > ARENA_MAX_SIZE)
+        return NULL;
+
+    arena = calloc (1, sizeof (svdrp_arena_t));
+    if (!arena)
+        return NULL;
+
+    arena->chunk_size = chunk_size ? ARENA_ROUND (chunk_size)
+        : ARENA_DEFAULT_CHUNK_SIZE;
+
+    return arena;
+}
+
+static arena_chunk_t *arena_chunk_new (size_t size)
+{
+    arena_chunk_t *chunk;
+
+    chunk = malloc (ARENA_HEADER + size);
+    if (!chunk)
+        return NULL;
+
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+
+    return chunk;
+}
+
+void svdrp_arena_reset (svdrp_arena_t *arena)
+{
+    arena_chunk_t **link, *chunk;
+
+    if (!arena)
+        return;
+
+    /* the regular chunks are kept for the next snapshot, not the large ones */
+    link = &arena->chunks;
+    while ((chunk = *link)) {
+        if (chunk->size > arena->chunk_size) {
+            *link = chunk->next;
+            free (chunk);
+            continue;
+        }
+        chunk->used = 0;
+        link = &chunk->next;
+    }
+
+    arena->current = arena->chunks;
+    arena->used = 0;
+}
+
+void svdrp_arena_free (svdrp_arena_t *arena)
+{
+    arena_chunk_t *chunk;
+
+    if (!arena)
+        return;
+
+    while ((chunk = arena->chunks)) {
+        arena->chunks = chunk->next;
+        free (chunk);
+    }
+
+    free (arena);
+}
+
+void *svdrp_arena_alloc (svdrp_arena_t *arena, size_t size)
+{
+    arena_chunk_t *chunk, *prev;
+
+    if (!arena || size > ARENA_MAX_SIZE)
+        return NULL;
+
+    size = size ? ARENA_ROUND (size) : ARENA_ALIGN;
+
+    chunk = arena->current;
+    if (!chunk || chunk->size - chunk->used < size) {
+        /* a large block gets a chunk of its own, the current one goes on */
+        if (size > arena->chunk_size / 4) {
+            chunk = arena_chunk_new (size);
+            if (!chunk)
+                return NULL;
+
+            if (arena->current) {
+                chunk->next = arena->current->next;
+                arena->current->next = chunk;
+            }
+            else {
+                chunk->next = arena->chunks;
+                arena->chunks = arena->current = chunk;
+            }
+        }
+        else {
+            /* move on to a chunk kept over a reset, or else a new one */
+            for (prev = chunk, chunk = chunk ? chunk->next : NULL;
+                 chunk && chunk->size - chunk->used < size;
+                 prev = chunk, chunk = chunk->next)
+                ;
+
+            if (!chunk) {
+                chunk = arena_chunk_new (arena->chunk_size);
+                if (!chunk)
+                    return NULL;
+
+                if (prev)
+                    prev->next = chunk;
+                else
+                    arena->chunks = chunk;
+            }
+            arena->current = chunk;
+        }
+    }
+
+    chunk->used += size;
+    arena->used += size;
+
+    return (char *) chunk + ARENA_HEADER + chunk->used - size;
+}
+
+char *svdrp_arena_strndup (svdrp_arena_t *arena, const char *str, size_t len)
+{
+    char *copy;
+
+    if (!str || len == SIZE_MAX)
+        return NULL;
+
+    copy = svdrp_arena_alloc (arena, len + 1);
+    if (!copy)
+        return NULL;
+
+    memcpy (copy, str, len);
+    copy[len] = '\0';
+
+    return copy;
+}
+
+char *svdrp_arena_strdup (svdrp_arena_t *arena, const char *str)
+{
+    return str ? svdrp_arena_strndup (arena, str, strlen (str)) : NULL;
+}
+
+size_t svdrp_arena_used (svdrp_arena_t *arena)
+{
+    return arena ? arena->used : 0;
+}
+
+void svdrp_arena_line_cb (void *data, int code,
+                          const char *line, size_t len, int last)
+{
+    svdrp_arena_lines_t *lines = data;
+    svdrp_arena_line_t *entry;
+
+    (void) last;
+
+    if (code != SVDRP_REPLY_OK || lines->error)
+        return;
+
+    /* the line follows its entry */
+    entry = svdrp_arena_alloc (lines->arena, sizeof (svdrp_arena_line_t) + len + 1);
+    if (!entry) {
+        lines->error = 1;
+        return;
+    }
+
+    entry->next = NULL;
+    entry->len = len;
+    entry->text = (char *) (entry + 1);
+    memcpy (entry->text, line, len);
+    entry->text[len] = '\0';
+
+    if (lines->tail)
+        lines->tail->next = entry;
+    else
+        lines->head = entry;
+    lines->tail = entry;
+    lines->count++;
+}
@@ -0,0 +1,446 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "svdrp.h"
+#include "svdrp_internals.h"
+#include "logs.h"
+#include "commands.h"
+
+int svdrp_async_connect (svdrp_t *svdrp)
+{
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (svdrp->async_state != SVDRP_ASYNC_CLOSED)
+        return 1;
+
+    svdrp_set_error (svdrp, SVDRP_ERR_NONE);
+
+    if (!svdrp_breaker_allow (svdrp))
+        return 0;
+
+    /* the banner has to come within the timeout as well */
+    svdrp->deadline = monotonic_ms () + svdrp->timeout * 1000LL;
+
+    if (svdrp_transport_open (svdrp) != SVDRP_OK) {
+        svdrp->deadline = 0;
+        svdrp_breaker_record (svdrp, 0);
+        return 0;
+    }
+
+    /* without a descriptor, there is no connection to wait for */
+    svdrp->async_state = svdrp->conn >= 0 ?
+        SVDRP_ASYNC_CONNECTING : SVDRP_ASYNC_BANNER;
+
+    return 1;
+}
+
+void svdrp_async_reset (svdrp_t *svdrp)
+{
+    svdrp_request_t *req = svdrp->requests;
+
+    svdrp->async_state = SVDRP_ASYNC_CLOSED;
+    svdrp->deadline = 0;
+    svdrp->attempt_deadline = 0;
+    svdrp->wbuf.len = 0;
+    svdrp->wpos = 0;
+    svdrp->requests = NULL;
+    svdrp->requests_tail = NULL;
+
+    /* the callbacks are free to queue new commands from here */
+    while (req) {
+        svdrp_request_t *next = req->next;
+
+        svdrp_metrics_record (svdrp, req->verb, SVDRP_ERROR,
+                              monotonic_us () - req->start,
+                              req->bytes_in, req->bytes_out);
+        if (req->done)
+            req->done (req->data, SVDRP_ERROR);
+        free (req);
+        req = next;
+    }
+}
+
+static int svdrp_async_flush (svdrp_t *svdrp)
+{
+    ssize_t ret;
+
+    while (svdrp->wpos < svdrp->wbuf.len) {
+        ret = svdrp->transport->write (svdrp->transport_data, svdrp->conn,
+                                       svdrp->wbuf.data + svdrp->wpos,
+                                       svdrp->wbuf.len - svdrp->wpos);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return SVDRP_OK;
+
+            svdrp_log (svdrp, SVDRP_MSG_WARNING, "Write failed");
+            svdrp_set_error (svdrp, SVDRP_ERR_IO);
+            svdrp_close_conn (svdrp);
+            return SVDRP_ERROR;
+        }
+        svdrp->wpos += ret;
+        svdrp->last_activity = monotonic_ms ();
+    }
+
+    svdrp->wbuf.len = 0;
+    svdrp->wpos = 0;
+
+    return SVDRP_OK;
+}
+
+/* give up on the address being connected to, for the next one if any */
+static int svdrp_async_connect_next (svdrp_t *svdrp)
+{
+    int s;
+
+    /* open the next one first, event loops track the descriptor number */
+    s = svdrp->transport == &svdrp_transport_tcp ? svdrp_connect_next (svdrp) : -1;
+    if (s >= 0) {
+        svdrp_transport_closing (svdrp);
+        close (svdrp->conn);
+        svdrp->conn = s;
+        return SVDRP_OK;
+    }
+
+    svdrp_set_error (svdrp, SVDRP_ERR_CONNECT);
+    svdrp_close_conn (svdrp);
+    return SVDRP_ERROR;
+}
+
+static int svdrp_async_finish_connect (svdrp_t *svdrp)
+{
+    socklen_t len = sizeof (int);
+    int err = 0;
+
+    if (getsockopt (svdrp->conn, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+        err = errno;
+
+    if (err) {
+        svdrp_log (svdrp, SVDRP_MSG_WARNING, "Connection failed with error %i", err);
+        return svdrp_async_connect_next (svdrp);
+    }
+
+    svdrp->async_state = SVDRP_ASYNC_BANNER;
+
+    return SVDRP_OK;
+}
+
+static int svdrp_async_read (svdrp_t *svdrp)
+{
+    svdrp_reply_code_t code;
+    svdrp_request_t *req;
+    char *line, *text;
+    ssize_t len;
+    int last;
+
+    for (;;) {
+        unsigned long long consumed = svdrp->rbuf.consumed;
+
+        len = readline (svdrp->conn, &svdrp->rbuf, &line);
+        if (len < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return SVDRP_OK;
+
+            svdrp_log (svdrp, SVDRP_MSG_WARNING, "Read failed");
+            svdrp_set_error (svdrp, errno == ECONNRESET ?
+                             SVDRP_ERR_CLOSED : SVDRP_ERR_IO);
+            svdrp_close_conn (svdrp);
+            return SVDRP_ERROR;
+        }
+
+        last = !(len > 3 && line[3] == '-');
+
+        if (svdrp->async_state == SVDRP_ASYNC_BANNER) {
+            svdrp_process_line (svdrp, line, len, &code, &text);
+            if (code != SVDRP_REPLY_READY) {
+                svdrp_log (svdrp, SVDRP_MSG_ERROR, "Unexpected banner");
+                if (svdrp->conn_open)
+                    svdrp_close_conn (svdrp);
+                return SVDRP_ERROR;
+            }
+
+            svdrp->async_state = SVDRP_ASYNC_READY;
+            svdrp->is_connected = 1;
+            svdrp->deadline = 0;
+            svdrp->last_activity = monotonic_ms ();
+            svdrp_metrics_connected (svdrp);
+            svdrp_breaker_record (svdrp, 1);
+
+            /* commands queued while connecting can go now */
+            if (svdrp_async_flush (svdrp) != SVDRP_OK)
+                return SVDRP_ERROR;
+            continue;
+        }
+
+        /* unlink the request first, the line may close the connection */
+        req = svdrp->requests;
+        if (req && last) {
+            svdrp->requests = req->next;
+            if (!svdrp->requests)
+                svdrp->requests_tail = NULL;
+        }
+
+        svdrp->verb = req ? req->verb : SVDRP_VERB_OTHER;
+        svdrp_process_line (svdrp, line, len, &code, &text);
+
+        if (req) {
+            req->bytes_in += svdrp->rbuf.consumed - consumed;
+
+            if (req->cb && code != SVDRP_REPLY_QUIT)
+                req->cb (req->data, code, text, line + len - text, last);
+
+            if (last) {
+                svdrp_metrics_record (svdrp, req->verb, code,
+                                      monotonic_us () - req->start,
+                                      req->bytes_in, req->bytes_out);
+                if (!req->keepalive)
+                    svdrp_set_last_reply (svdrp, code, text, line + len - text);
+                if (req->done)
+                    req->done (req->data, code);
+                free (req);
+            }
+        }
+
+        if (svdrp->async_state == SVDRP_ASYNC_CLOSED)
+            return SVDRP_ERROR;
+    }
+}
+
+int svdrp_get_fd (svdrp_t *svdrp)
+{
+    if (!svdrp || svdrp->async_state == SVDRP_ASYNC_CLOSED)
+        return -1;
+
+    return svdrp->conn;
+}
+
+int svdrp_get_io_events (svdrp_t *svdrp)
+{
+    if (!svdrp)
+        return 0;
+
+    switch (svdrp->async_state)
+    {
+    case SVDRP_ASYNC_CONNECTING:
+        return SVDRP_IO_WRITE;
+    case SVDRP_ASYNC_BANNER:
+        return SVDRP_IO_READ;
+    case SVDRP_ASYNC_READY:
+        return SVDRP_IO_READ
+            | (svdrp->wpos < svdrp->wbuf.len ? SVDRP_IO_WRITE : 0);
+    default:
+        return 0;
+    }
+}
+
+/* deadline of the connection attempt, or else of the oldest command */
+static long long svdrp_async_deadline (svdrp_t *svdrp)
+{
+    switch (svdrp->async_state)
+    {
+    case SVDRP_ASYNC_CONNECTING:
+        if (svdrp->attempt_deadline
+            && (!svdrp->deadline || svdrp->attempt_deadline < svdrp->deadline))
+            return svdrp->attempt_deadline;
+        return svdrp->deadline;
+    case SVDRP_ASYNC_BANNER:
+        return svdrp->deadline;
+    case SVDRP_ASYNC_READY:
+        return svdrp->requests ? svdrp->requests->deadline : 0;
+    default:
+        return 0;
+    }
+}
+
+/* when an idle connection is next due for a keepalive, 0 if never */
+long long svdrp_async_keepalive_due (svdrp_t *svdrp)
+{
+    if (!svdrp->keepalive || svdrp->async_state != SVDRP_ASYNC_READY
+        || svdrp->requests)
+        return 0;
+
+    return svdrp->last_activity + svdrp->keepalive * 1000LL;
+}
+
+int svdrp_get_io_timeout (svdrp_t *svdrp)
+{
+    long long deadline, keepalive, left;
+
+    if (!svdrp)
+        return -1;
+
+    deadline = svdrp_async_deadline (svdrp);
+    keepalive = svdrp_async_keepalive_due (svdrp);
+    if (keepalive && (!deadline || keepalive < deadline))
+        deadline = keepalive;
+    if (!deadline)
+        return -1;
+
+    left = deadline - monotonic_ms ();
+
+    return left > 0 ? left : 0;
+}
+
+int svdrp_process_io (svdrp_t *svdrp, int events)
+{
+    long long deadline;
+
+    if (!svdrp || !svdrp->async)
+        return SVDRP_ERROR;
+
+    /* the no-op goes out with the next write event */
+    deadline = svdrp_async_keepalive_due (svdrp);
+    if (deadline && deadline <= monotonic_ms ())
+        svdrp_async_keepalive (svdrp);
+
+    /* an address taking too long makes way for the next one */
+    deadline = svdrp_async_deadline (svdrp);
+    if (deadline && deadline <= monotonic_ms ()
+        && svdrp->async_state == SVDRP_ASYNC_CONNECTING
+        && deadline == svdrp->attempt_deadline && deadline != svdrp->deadline) {
+        svdrp_log (svdrp, SVDRP_MSG_WARNING, "Connection attempt timed out, trying the next address");
+        if (svdrp_async_connect_next (svdrp) != SVDRP_OK)
+            return SVDRP_ERROR;
+        return SVDRP_OK;
+    }
+
+    /* a late event does not save an expired operation */
+    if (deadline && deadline <= monotonic_ms ()) {
+        svdrp_log (svdrp, SVDRP_MSG_WARNING, "Timeout, closing connection");
+        svdrp_set_error (svdrp, SVDRP_ERR_TIMEOUT);
+        svdrp_close_conn (svdrp);
+        return SVDRP_ERROR;
+    }
+
+    if (svdrp->async_state == SVDRP_ASYNC_CONNECTING) {
+        if (!events)
+            return SVDRP_OK;
+        if (svdrp_async_finish_connect (svdrp) != SVDRP_OK)
+            return SVDRP_ERROR;
+    }
+
+    if (svdrp->async_state == SVDRP_ASYNC_READY && (events & SVDRP_IO_WRITE)
+        && svdrp_async_flush (svdrp) != SVDRP_OK)
+        return SVDRP_ERROR;
+
+    if ((svdrp->async_state == SVDRP_ASYNC_BANNER
+         || svdrp->async_state == SVDRP_ASYNC_READY)
+        && (events & SVDRP_IO_READ))
+        return svdrp_async_read (svdrp);
+
+    return svdrp->async_state == SVDRP_ASYNC_CLOSED ? SVDRP_ERROR : SVDRP_OK;
+}
+
+static int svdrp_async_queue (svdrp_t *svdrp, const char *cmd,
+                              svdrp_reply_cb_t cb, svdrp_done_cb_t done,
+                              void *data, int keepalive)
+{
+    svdrp_request_t *req;
+    struct iovec iov;
+    size_t len, pending;
+
+    if (!svdrp_async_connect (svdrp))
+        return SVDRP_ERROR;
+
+    req = calloc (1, sizeof (svdrp_request_t));
+    if (!req)
+        return SVDRP_ERROR;
+
+    req->keepalive = keepalive;
+    req->cb = cb;
+    req->done = done;
+    req->data = data;
+    req->deadline = monotonic_ms () + svdrp->timeout * 1000LL;
+    req->start = monotonic_us ();
+
+    len = command_len (cmd);
+    pending = svdrp->wbuf.len;
+    if (strbuf_append (&svdrp->wbuf, cmd, len) < 0
+        || strbuf_append (&svdrp->wbuf, "\n", 1) < 0) {
+        svdrp->wbuf.len = pending;
+        free (req);
+        return SVDRP_ERROR;
+    }
+
+    svdrp_log (svdrp, SVDRP_MSG_INFO, "Sending command: '%.*s'", (int) len, cmd);
+    iov.iov_base = svdrp->wbuf.data + pending;
+    iov.iov_len = len + 1;
+    svdrp_record (svdrp, 'S', &iov, 1);
+
+    req->verb = svdrp_verb_lookup (cmd, len);
+    req->bytes_out = len + 1;
+    svdrp_cache_invalidate (svdrp, req->verb);
+
+    if (svdrp->requests_tail)
+        svdrp->requests_tail->next = req;
+    else
+        svdrp->requests = req;
+    svdrp->requests_tail = req;
+
+    /* try to send right away, the event loop takes care of the rest */
+    if (svdrp->async_state == SVDRP_ASYNC_READY)
+        svdrp_async_flush (svdrp);
+
+    return SVDRP_OK;
+}
+
+int svdrp_command_async (svdrp_t *svdrp, const char *cmd,
+                         svdrp_reply_cb_t cb, svdrp_done_cb_t done,
+                         void *data)
+{
+    if (!svdrp || !cmd)
+        return SVDRP_ERROR;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (!svdrp->async) {
+        svdrp_log (svdrp, SVDRP_MSG_ERROR, "Non-blocking command on a blocking connection");
+        return SVDRP_ERROR;
+    }
+
+    return svdrp_async_queue (svdrp, cmd, cb, done, data, 0);
+}
+
+static void svdrp_keepalive_done (void *data, int code)
+{
+    svdrp_t *svdrp = data;
+
+    /* PING only came with VDR 1.7, STAT is as cheap on older ones */
+    if (code == SVDRP_REPLY_UNKNOWN_CMD || code == SVDRP_REPLY_UNIMPEMENTED_CMD)
+        svdrp->keepalive_cmd = "STAT disk";
+}
+
+int svdrp_async_keepalive (svdrp_t *svdrp)
+{
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    svdrp->metrics.keepalives++;
+
+    return svdrp_async_queue (svdrp, svdrp->keepalive_cmd, NULL,
+                              svdrp_keepalive_done, svdrp, 1);
+}
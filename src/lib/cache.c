@@ -0,0 +1,333 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "svdrp.h"
+#include "svdrp_internals.h"
+#include "logs.h"
+#include "commands.h"
+
+#define CACHE_DEFAULT_MAX_SIZE (4 * 1024 * 1024)
+
+/* reply to a command, its lines kept as on the wire */
+typedef struct cache_entry_s {
+    struct cache_entry_s *prev;
+    struct cache_entry_s *next;
+    char *key;                    /* command line, without terminator */
+    size_t key_len;
+    int verb;
+    long long expires;
+    strbuf_t lines;               /* "250-text" lines, each NUL-terminated */
+    int busy;                     /* being replayed */
+    int dropped;                  /* to be freed once replayed */
+} cache_entry_t;
+
+struct svdrp_cache_s {
+    cache_entry_t *head;          /* most recently used first */
+    cache_entry_t *tail;
+    size_t size;
+    size_t max_size;
+    int ttl[SVDRP_VERB_COUNT];    /* in ms, 0 if not cached */
+};
+
+static size_t cache_entry_size (const cache_entry_t *entry)
+{
+    return sizeof (cache_entry_t) + entry->key_len + 1 + entry->lines.size;
+}
+
+static void cache_entry_free (cache_entry_t *entry)
+{
+    free (entry->key);
+    strbuf_free (&entry->lines);
+    free (entry);
+}
+
+static void cache_unlink (svdrp_cache_t *cache, cache_entry_t *entry)
+{
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        cache->head = entry->next;
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        cache->tail = entry->prev;
+
+    entry->prev = entry->next = NULL;
+}
+
+static void cache_push (svdrp_cache_t *cache, cache_entry_t *entry)
+{
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head)
+        cache->head->prev = entry;
+    else
+        cache->tail = entry;
+    cache->head = entry;
+}
+
+/* an entry being replayed goes away once its reply is over */
+static void cache_drop (svdrp_cache_t *cache, cache_entry_t *entry)
+{
+    cache_unlink (cache, entry);
+    cache->size -= cache_entry_size (entry);
+
+    if (entry->busy)
+        entry->dropped = 1;
+    else
+        cache_entry_free (entry);
+}
+
+int svdrp_cache_enable (svdrp_t *svdrp, int ttl, size_t max_size)
+{
+    int i;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (!svdrp || ttl < 0)
+        return SVDRP_ERROR;
+
+    if (!svdrp->cache) {
+        svdrp->cache = calloc (1, sizeof (svdrp_cache_t));
+        if (!svdrp->cache)
+            return SVDRP_ERROR;
+    }
+
+    svdrp->cache->max_size = max_size ? max_size : CACHE_DEFAULT_MAX_SIZE;
+    for (i = 0; i < SVDRP_VERB_COUNT; i++)
+        svdrp->cache->ttl[i] = svdrp_verbs[i].reads ? ttl : 0;
+
+    return SVDRP_OK;
+}
+
+void svdrp_cache_disable (svdrp_t *svdrp)
+{
+    if (!svdrp || !svdrp->cache)
+        return;
+
+    svdrp_cache_clear (svdrp);
+    free (svdrp->cache);
+    svdrp->cache = NULL;
+}
+
+int svdrp_cache_set_ttl (svdrp_t *svdrp, const char *verb, int ttl)
+{
+    svdrp_cache_t *cache;
+    cache_entry_t *entry, *next;
+    svdrp_verb_t v;
+
+    if (!svdrp || !svdrp->cache || !verb || ttl < 0)
+        return SVDRP_ERROR;
+
+    cache = svdrp->cache;
+
+    /* only the replies which mutating commands invalidate can be kept */
+    v = svdrp_verb_lookup (verb, strlen (verb));
+    if (v == SVDRP_VERB_OTHER || !svdrp_verbs[v].reads) {
+        svdrp_log (svdrp, SVDRP_MSG_WARNING, "%s replies cannot be cached", verb);
+        return SVDRP_ERROR;
+    }
+
+    cache->ttl[v] = ttl;
+
+    /* a shorter TTL applies to the replies already kept as well */
+    for (entry = cache->head; entry; entry = next) {
+        next = entry->next;
+        if (entry->verb == (int) v && !ttl)
+            cache_drop (cache, entry);
+        else if (entry->verb == (int) v && entry->expires > monotonic_ms () + ttl)
+            entry->expires = monotonic_ms () + ttl;
+    }
+
+    return SVDRP_OK;
+}
+
+void svdrp_cache_clear (svdrp_t *svdrp)
+{
+    if (!svdrp || !svdrp->cache)
+        return;
+
+    while (svdrp->cache->head)
+        cache_drop (svdrp->cache, svdrp->cache->head);
+}
+
+void svdrp_cache_invalidate (svdrp_t *svdrp, int verb)
+{
+    svdrp_cache_t *cache = svdrp->cache;
+    cache_entry_t *entry, *next;
+    int writes;
+
+    if (!cache || verb < 0 || verb >= SVDRP_VERB_COUNT)
+        return;
+
+    writes = svdrp_verbs[verb].writes;
+    if (!writes)
+        return;
+
+    for (entry = cache->head; entry; entry = next) {
+        next = entry->next;
+        if (svdrp_verbs[entry->verb].reads & writes) {
+            svdrp_log (svdrp, SVDRP_MSG_VERBOSE, "%s invalidates '%s'",
+                       svdrp_verbs[verb].name, entry->key);
+            svdrp->metrics.cache_invalidations++;
+            cache_drop (cache, entry);
+        }
+    }
+}
+
+static cache_entry_t *cache_find (svdrp_cache_t *cache,
+                                  const char *cmd, size_t len)
+{
+    cache_entry_t *entry;
+
+    for (entry = cache->head; entry; entry = entry->next)
+        if (entry->key_len == len && !memcmp (entry->key, cmd, len))
+            return entry;
+
+    return NULL;
+}
+
+int svdrp_cache_replay (svdrp_t *svdrp, const char *cmd, size_t len, int verb,
+                        svdrp_reply_cb_t cb, void *data)
+{
+    svdrp_cache_t *cache = svdrp->cache;
+    cache_entry_t *entry;
+    char *line, *end;
+    int code = SVDRP_ERROR;
+
+    if (!cache || !cache->ttl[verb] || svdrp_cmd_time_relative (cmd, len))
+        return SVDRP_ERROR;
+
+    entry = cache_find (cache, cmd, len);
+    if (entry && entry->expires <= monotonic_ms ()) {
+        cache_drop (cache, entry);
+        entry = NULL;
+    }
+
+    if (!entry) {
+        svdrp->metrics.cache_misses++;
+        return SVDRP_ERROR;
+    }
+
+    svdrp_log (svdrp, SVDRP_MSG_INFO, "Cached reply to '%s'", entry->key);
+    svdrp->metrics.cache_hits++;
+
+    cache_unlink (cache, entry);
+    cache_push (cache, entry);
+
+    /* the callbacks may send commands, invalidating this very entry */
+    entry->busy++;
+    line = entry->lines.data;
+    end = entry->lines.data + entry->lines.len;
+    while (line < end) {
+        size_t line_len = strlen (line);
+        int last = line[3] != '-';
+
+        code = atoi (line);
+        if (last)
+            svdrp_set_last_reply (svdrp, code, line + 4, line_len - 4);
+        if (cb)
+            cb (data, code, line + 4, line_len - 4, last);
+        line += line_len + 1;
+    }
+    entry->busy--;
+
+    if (entry->dropped && !entry->busy)
+        cache_entry_free (entry);
+
+    return code;
+}
+
+void svdrp_cache_fill_cb (void *data, int code,
+                          const char *line, size_t len, int last)
+{
+    svdrp_cache_fill_t *fill = data;
+    char prefix[5];
+
+    if (!fill->error) {
+        snprintf (prefix, sizeof (prefix), "%03d%c", code, last ? ' ' : '-');
+        if (strbuf_append (&fill->lines, prefix, 4) < 0
+            || strbuf_append (&fill->lines, line, len) < 0
+            || strbuf_append (&fill->lines, "", 1) < 0)
+            fill->error = 1;
+    }
+
+    if (fill->cb)
+        fill->cb (fill->data, code, line, len, last);
+}
+
+/* only complete, successful or empty listings are kept */
+static int cache_code_ok (int code)
+{
+    return (code >= 200 && code < 300 && code != SVDRP_REPLY_READY
+            && code != SVDRP_REPLY_QUIT)
+        || code == SVDRP_REPLY_ACTION_NOT_TAKEN;
+}
+
+void svdrp_cache_store (svdrp_t *svdrp, const char *cmd, size_t len, int verb,
+                        int code, svdrp_cache_fill_t *fill)
+{
+    svdrp_cache_t *cache = svdrp->cache;
+    cache_entry_t *entry;
+    size_t size;
+
+    if (!cache || !cache->ttl[verb] || fill->error || !fill->lines.len
+        || !cache_code_ok (code) || svdrp_cmd_time_relative (cmd, len)) {
+        strbuf_free (&fill->lines);
+        return;
+    }
+
+    entry = cache_find (cache, cmd, len);
+    if (entry)
+        cache_drop (cache, entry);
+
+    entry = calloc (1, sizeof (cache_entry_t));
+    if (!entry || !(entry->key = malloc (len + 1))) {
+        free (entry);
+        strbuf_free (&fill->lines);
+        return;
+    }
+
+    memcpy (entry->key, cmd, len);
+    entry->key[len] = '\0';
+    entry->key_len = len;
+    entry->verb = verb;
+    entry->expires = monotonic_ms () + cache->ttl[verb];
+    entry->lines = fill->lines;
+    memset (&fill->lines, 0, sizeof (strbuf_t));
+
+    size = cache_entry_size (entry);
+    if (size > cache->max_size) {
+        cache_entry_free (entry);
+        return;
+    }
+
+    /* the least recently used replies make room */
+    while (cache->tail && cache->size + size > cache->max_size)
+        cache_drop (cache, cache->tail);
+
+    cache_push (cache, entry);
+    cache->size += size;
+}
@@ -0,0 +1,450 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "svdrp.h"
+#include "svdrp_internals.h"
+#include "logs.h"
+
+#define CAPTURE_MAGIC "SVDRP-CAPTURE 1\n"
+
+/*
+ * A capture is the magic line followed by records, each made of a
+ * "<type> <time> <length>\n" header, length bytes and a newline. The type
+ * is C for a new connection (the data being host:port), S for bytes sent
+ * to VDR and R for bytes received from it; the time is in microseconds
+ * since the start of the capture.
+ */
+typedef struct capture_record_s {
+    char type;
+    long long time;
+    size_t offset;                /* position of the data in the capture */
+    size_t len;
+} capture_record_t;
+
+struct svdrp_replay_s {
+    char *data;                   /* the whole capture */
+    capture_record_t *records;
+    int count;
+    int next;                     /* first record of the next connection */
+    int realtime;
+    pthread_t thread;
+    int running;
+};
+
+/* what a feeder thread replays of a connection */
+typedef struct replay_feed_s {
+    svdrp_replay_t *replay;
+    int first;
+    int last;
+    int fd;
+} replay_feed_t;
+
+static void svdrp_record_tap (void *data, const char *buf, size_t len)
+{
+    struct iovec iov;
+
+    iov.iov_base = (void *) buf;
+    iov.iov_len = len;
+    svdrp_record (data, 'R', &iov, 1);
+}
+
+void svdrp_record (svdrp_t *svdrp, char type, const struct iovec *iov, int iovcnt)
+{
+    struct iovec peer_iov;
+    char peer[512];
+    size_t len = 0;
+    int i;
+
+    if (!svdrp->record)
+        return;
+
+    if (type == 'C') {
+        /* the received bytes of the new connection are tapped from now */
+        snprintf (peer, sizeof (peer), "%s:%i", svdrp->host, svdrp->port);
+        peer_iov.iov_base = peer;
+        peer_iov.iov_len = strlen (peer);
+        iov = &peer_iov;
+        iovcnt = 1;
+        svdrp->rbuf.tap = svdrp_record_tap;
+        svdrp->rbuf.tap_data = svdrp;
+    }
+
+    for (i = 0; i < iovcnt; i++)
+        len += iov[i].iov_len;
+
+    fprintf (svdrp->record, "%c %lld %zu\n", type,
+             monotonic_us () - svdrp->record_start, len);
+    for (i = 0; i < iovcnt; i++)
+        fwrite (iov[i].iov_base, 1, iov[i].iov_len, svdrp->record);
+    fputc ('\n', svdrp->record);
+}
+
+int svdrp_record_start (svdrp_t *svdrp, const char *path)
+{
+    if (!svdrp || !path)
+        return SVDRP_ERROR;
+
+    svdrp_record_stop (svdrp);
+
+    svdrp->record = fopen (path, "w");
+    if (!svdrp->record) {
+        svdrp_log (svdrp, SVDRP_MSG_ERROR, "Cannot open %s: %s", path, strerror (errno));
+        return SVDRP_ERROR;
+    }
+
+    fputs (CAPTURE_MAGIC, svdrp->record);
+    svdrp->record_start = monotonic_us ();
+
+    /* a connection already open is recorded from its current state */
+    if (svdrp->conn_open)
+        svdrp_record (svdrp, 'C', NULL, 0);
+
+    /* its banner is long gone, replays still need an equivalent one */
+    if (svdrp->is_connected || svdrp->async_state == SVDRP_ASYNC_READY) {
+        char banner[1024];
+        struct iovec iov;
+
+        snprintf (banner, sizeof (banner),
+                  "220 %s SVDRP VideoDiskRecorder %s; -; %s\r\n",
+                  svdrp->name ? svdrp->name : "vdr",
+                  svdrp->version ? svdrp->version : "-",
+                  svdrp->charset ? svdrp->charset : "UTF-8");
+        iov.iov_base = banner;
+        iov.iov_len = strlen (banner);
+        svdrp_record (svdrp, 'R', &iov, 1);
+    }
+
+    return SVDRP_OK;
+}
+
+void svdrp_record_stop (svdrp_t *svdrp)
+{
+    if (!svdrp || !svdrp->record)
+        return;
+
+    fclose (svdrp->record);
+    svdrp->record = NULL;
+    svdrp->rbuf.tap = NULL;
+    svdrp->rbuf.tap_data = NULL;
+}
+
+static int replay_parse (svdrp_replay_t *replay, size_t size)
+{
+    size_t pos = strlen (CAPTURE_MAGIC);
+    int n = 0;
+
+    if (size < pos || memcmp (replay->data, CAPTURE_MAGIC, pos))
+        return -1;
+
+    while (pos < size) {
+        capture_record_t *r;
+        char *eol;
+
+        eol = memchr (replay->data + pos, '\n', size - pos);
+        if (!eol)
+            return -1;
+
+        if (n == replay->count) {
+            int count = replay->count ? 2 * replay->count : 256;
+            capture_record_t *records;
+
+            records = realloc (replay->records, count * sizeof (capture_record_t));
+            if (!records)
+                return -1;
+            replay->records = records;
+            replay->count = count;
+        }
+
+        r = &replay->records[n];
+        *eol = '\0';
+        if (sscanf (replay->data + pos, "%c %lld %zu", &r->type, &r->time, &r->len) != 3
+            || !strchr ("CSR", r->type))
+            return -1;
+
+        r->offset = eol + 1 - replay->data;
+        if (r->offset + r->len + 1 > size)
+            return -1;
+
+        pos = r->offset + r->len + 1;
+        n++;
+    }
+
+    replay->count = n;
+
+    return 0;
+}
+
+svdrp_replay_t *svdrp_replay_load (const char *path, int realtime)
+{
+    svdrp_replay_t *replay;
+    long size;
+    FILE *f;
+
+    f = fopen (path, "r");
+    if (!f)
+        return NULL;
+
+    replay = calloc (1, sizeof (svdrp_replay_t));
+    if (!replay) {
+        fclose (f);
+        return NULL;
+    }
+
+    replay->realtime = realtime;
+
+    if (fseek (f, 0, SEEK_END) < 0 || (size = ftell (f)) < 0
+        || fseek (f, 0, SEEK_SET) < 0
+        || !(replay->data = malloc (size + 1))
+        || fread (replay->data, 1, size, f) != (size_t) size
+        || replay_parse (replay, size) < 0) {
+        fclose (f);
+        svdrp_replay_free (replay);
+        return NULL;
+    }
+
+    fclose (f);
+
+    /* records before the first connection have nothing to go to */
+    while (replay->next < replay->count
+           && replay->records[replay->next].type != 'C')
+        replay->next++;
+
+    return replay;
+}
+
+static void replay_stop (svdrp_replay_t *replay)
+{
+    if (replay->running) {
+        pthread_join (replay->thread, NULL);
+        replay->running = 0;
+    }
+}
+
+void svdrp_replay_free (svdrp_replay_t *replay)
+{
+    if (!replay)
+        return;
+
+    replay_stop (replay);
+    free (replay->records);
+    free (replay->data);
+    free (replay);
+}
+
+static void replay_sleep_until (long long when)
+{
+    long long left = when - monotonic_us ();
+    struct timespec ts;
+
+    if (left <= 0)
+        return;
+
+    ts.tv_sec = left / 1000000;
+    ts.tv_nsec = (left % 1000000) * 1000;
+    while (nanosleep (&ts, &ts) < 0 && errno == EINTR)
+        ;
+}
+
+/*
+ * Play VDR's part of a connection: every chunk it sent is written once the
+ * client has sent what preceded it in the capture, right away or with the
+ * original delay.
+ */
+static void *replay_feed_thread (void *arg)
+{
+    replay_feed_t *feed = arg;
+    svdrp_replay_t *replay = feed->replay;
+    unsigned long long needed = 0, received = 0;
+    long long base = monotonic_us (), base_time = 0;
+    char buf[4096];
+    int i;
+
+    if (feed->first < feed->last)
+        base_time = replay->records[feed->first].time;
+
+    for (i = feed->first + 1; i < feed->last; i++) {
+        capture_record_t *r = &replay->records[i];
+        const char *data = replay->data + r->offset;
+        size_t len = r->len;
+
+        if (r->type == 'S') {
+            needed += r->len;
+            continue;
+        }
+
+        if (received < needed) {
+            while (received < needed) {
+                ssize_t ret = recv (feed->fd, buf, sizeof (buf), 0);
+
+                if (ret < 0 && errno == EINTR)
+                    continue;
+                if (ret <= 0)
+                    goto out;
+                received += ret;
+            }
+
+            /* the timing of the replies is relative to their command */
+            base = monotonic_us ();
+            base_time = replay->records[i - 1].time;
+        }
+
+        if (replay->realtime)
+            replay_sleep_until (base + r->time - base_time);
+
+        while (len > 0) {
+            ssize_t ret = send (feed->fd, data, len, MSG_NOSIGNAL);
+
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret < 0)
+                goto out;
+            data += ret;
+            len -= ret;
+        }
+    }
+
+    /* like VDR, wait for the client to go before closing */
+    shutdown (feed->fd, SHUT_WR);
+    while (recv (feed->fd, buf, sizeof (buf), 0) > 0)
+        ;
+
+ out:
+    close (feed->fd);
+    free (feed);
+
+    return NULL;
+}
+
+static int replay_open (void *data, svdrp_t *svdrp, int *fd)
+{
+    svdrp_replay_t *replay = data;
+    replay_feed_t *feed;
+    int fds[2];
+
+    /* the previous connection is over, it has been closed on our side */
+    replay_stop (replay);
+
+    if (replay->next >= replay->count) {
+        svdrp_log (svdrp, SVDRP_MSG_ERROR, "End of the capture");
+        return SVDRP_ERROR;
+    }
+
+    feed = malloc (sizeof (replay_feed_t));
+    if (!feed)
+        return SVDRP_ERROR;
+
+    if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        free (feed);
+        return SVDRP_ERROR;
+    }
+
+    feed->replay = replay;
+    feed->first = replay->next++;
+    while (replay->next < replay->count
+           && replay->records[replay->next].type != 'C')
+        replay->next++;
+    feed->last = replay->next;
+    feed->fd = fds[1];
+
+    if (pthread_create (&replay->thread, NULL, replay_feed_thread, feed)) {
+        close (fds[0]);
+        close (fds[1]);
+        free (feed);
+        return SVDRP_ERROR;
+    }
+    replay->running = 1;
+
+    svdrp_log (svdrp, SVDRP_MSG_INFO, "Replaying connection to %.*s",
+               (int) replay->records[feed->first].len,
+               replay->data + replay->records[feed->first].offset);
+
+    fcntl (fds[0], F_SETFL, fcntl (fds[0], F_GETFL) | O_NONBLOCK);
+    *fd = fds[0];
+
+    return SVDRP_OK;
+}
+
+const svdrp_transport_t svdrp_transport_replay = {
+    "replay",
+    replay_open,
+    svdrp_fd_read,
+    svdrp_fd_write,
+    svdrp_fd_writev,
+    svdrp_fd_close,
+};
+
+int svdrp_replay_run (svdrp_t *svdrp, svdrp_reply_cb_t cb, void *data)
+{
+    svdrp_replay_t *replay;
+    strbuf_t line = { NULL, 0, 0 };
+    int i, ret = SVDRP_OK;
+
+    if (!svdrp || !svdrp->replay || svdrp->async)
+        return SVDRP_ERROR;
+
+    replay = svdrp->replay;
+
+    for (i = 0; i < replay->count; i++) {
+        capture_record_t *r = &replay->records[i];
+        char *cmd = replay->data + r->offset;
+        char *end = cmd + r->len;
+        svdrp_pipeline_t *pipeline;
+
+        if (r->type != 'S')
+            continue;
+
+        /* commands written at once are sent at once again */
+        pipeline = svdrp_pipeline_new (svdrp);
+        if (!pipeline) {
+            ret = SVDRP_ERROR;
+            break;
+        }
+
+        while (cmd < end) {
+            char *eol = memchr (cmd, '\n', end - cmd);
+
+            if (!eol)
+                eol = end;
+            if (strbuf_set (&line, cmd, eol - cmd) == 0)
+                svdrp_pipeline_add (pipeline, line.data, cb, data);
+            cmd = eol + 1;
+        }
+
+        if (svdrp_pipeline_run (pipeline) != SVDRP_OK)
+            ret = SVDRP_ERROR;
+        svdrp_pipeline_free (pipeline);
+    }
+
+    strbuf_free (&line);
+
+    return ret;
+}
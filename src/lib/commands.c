@@ -0,0 +1,134 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include <strings.h>
+
+#include "commands.h"
+
+#define SVDRP_VERB_LEN 4
+
+/*
+ * What each command reads and changes, for the response cache. The
+ * commands both querying and setting something, like CHAN or VOLU, count
+ * as changing only. An unknown command may change anything.
+ *
+ * Changing nothing does not make a command safe to send twice: MESG
+ * shows its message again. Only the listings, PING and STAT may be
+ * repeated after VDR possibly executed them.
+ */
+const svdrp_verb_info_t svdrp_verbs[SVDRP_VERB_COUNT] = {
+    [SVDRP_VERB_CHAN]  = { "CHAN", 0, SVDRP_DATA_STATE, 0 },
+    [SVDRP_VERB_CLRE]  = { "CLRE", 0, SVDRP_DATA_EPG, 0 },
+    [SVDRP_VERB_CPYR]  = { "CPYR", 0, SVDRP_DATA_RECORDINGS | SVDRP_DATA_DISK, 0 },
+    [SVDRP_VERB_DELC]  = { "DELC", 0, SVDRP_DATA_CHANNELS | SVDRP_DATA_TIMERS | SVDRP_DATA_EPG, 0 },
+    [SVDRP_VERB_DELR]  = { "DELR", 0, SVDRP_DATA_RECORDINGS | SVDRP_DATA_DISK, 0 },
+    [SVDRP_VERB_DELT]  = { "DELT", 0, SVDRP_DATA_TIMERS, 0 },
+    [SVDRP_VERB_EDIT]  = { "EDIT", 0, SVDRP_DATA_RECORDINGS | SVDRP_DATA_DISK, 0 },
+    [SVDRP_VERB_GRAB]  = { "GRAB", 0, 0, 0 },
+    [SVDRP_VERB_HELP]  = { "HELP", SVDRP_DATA_HELP, 0, 1 },
+    [SVDRP_VERB_HITK]  = { "HITK", 0, SVDRP_DATA_ALL, 0 },
+    [SVDRP_VERB_LSTC]  = { "LSTC", SVDRP_DATA_CHANNELS, 0, 1 },
+    [SVDRP_VERB_LSTD]  = { "LSTD", SVDRP_DATA_STATE, 0, 1 },
+    [SVDRP_VERB_LSTE]  = { "LSTE", SVDRP_DATA_EPG | SVDRP_DATA_CHANNELS, 0, 1 },
+    [SVDRP_VERB_LSTR]  = { "LSTR", SVDRP_DATA_RECORDINGS, 0, 1 },
+    [SVDRP_VERB_LSTT]  = { "LSTT", SVDRP_DATA_TIMERS | SVDRP_DATA_CHANNELS, 0, 1 },
+    [SVDRP_VERB_MESG]  = { "MESG", 0, 0, 0 },
+    [SVDRP_VERB_MODC]  = { "MODC", 0, SVDRP_DATA_CHANNELS, 0 },
+    [SVDRP_VERB_MODT]  = { "MODT", 0, SVDRP_DATA_TIMERS, 0 },
+    [SVDRP_VERB_MOVC]  = { "MOVC", 0, SVDRP_DATA_CHANNELS | SVDRP_DATA_TIMERS | SVDRP_DATA_EPG, 0 },
+    [SVDRP_VERB_MOVR]  = { "MOVR", 0, SVDRP_DATA_RECORDINGS, 0 },
+    [SVDRP_VERB_NEWC]  = { "NEWC", 0, SVDRP_DATA_CHANNELS, 0 },
+    [SVDRP_VERB_NEWT]  = { "NEWT", 0, SVDRP_DATA_TIMERS, 0 },
+    [SVDRP_VERB_NEXT]  = { "NEXT", SVDRP_DATA_TIMERS, 0, 1 },
+    [SVDRP_VERB_PING]  = { "PING", 0, 0, 1 },
+    [SVDRP_VERB_PLAY]  = { "PLAY", 0, SVDRP_DATA_STATE, 0 },
+    [SVDRP_VERB_PLUG]  = { "PLUG", 0, SVDRP_DATA_ALL, 0 },
+    [SVDRP_VERB_POLL]  = { "POLL", 0, SVDRP_DATA_TIMERS, 0 },
+    [SVDRP_VERB_PRIM]  = { "PRIM", 0, SVDRP_DATA_STATE, 0 },
+    [SVDRP_VERB_PUTE]  = { "PUTE", 0, SVDRP_DATA_EPG, 0 },
+    [SVDRP_VERB_QUIT]  = { "QUIT", 0, 0, 0 },
+    [SVDRP_VERB_REMO]  = { "REMO", 0, SVDRP_DATA_STATE, 0 },
+    [SVDRP_VERB_SCAN]  = { "SCAN", 0, SVDRP_DATA_EPG, 0 },
+    [SVDRP_VERB_STAT]  = { "STAT", SVDRP_DATA_DISK, 0, 1 },
+    [SVDRP_VERB_UPDR]  = { "UPDR", 0, SVDRP_DATA_RECORDINGS | SVDRP_DATA_DISK, 0 },
+    [SVDRP_VERB_UPDT]  = { "UPDT", 0, SVDRP_DATA_TIMERS, 0 },
+    [SVDRP_VERB_VOLU]  = { "VOLU", 0, SVDRP_DATA_STATE, 0 },
+    [SVDRP_VERB_OTHER] = { "OTHER", 0, SVDRP_DATA_ALL, 0 },
+};
+
+svdrp_verb_t svdrp_verb_lookup(const char *cmd, size_t len)
+{
+    int low = 0, high = SVDRP_VERB_OTHER - 1;
+
+    /* the verb has to be a word of its own */
+    if (!cmd || len < SVDRP_VERB_LEN
+        || (len > SVDRP_VERB_LEN && !strchr (" \t\r\n", cmd[SVDRP_VERB_LEN])))
+        return SVDRP_VERB_OTHER;
+
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        int cmp = strncasecmp (cmd, svdrp_verbs[mid].name, SVDRP_VERB_LEN);
+
+        if (!cmp)
+            return mid;
+        if (cmp < 0)
+            high = mid - 1;
+        else
+            low = mid + 1;
+    }
+
+    return SVDRP_VERB_OTHER;
+}
+
+int svdrp_args_time_relative(const char *args, size_t len)
+{
+    static const char *const words[] = { "rel", "now", "next", "at" };
+    const char *end, *word;
+    size_t i;
+
+    if (!args)
+        return 0;
+
+    /* one word at a time */
+    end = args + len;
+    while (args < end) {
+        while (args < end && strchr (" \t\r\n", *args))
+            args++;
+        for (word = args; args < end && !strchr (" \t\r\n", *args); args++)
+            ;
+        for (i = 0; i < sizeof (words) / sizeof (*words); i++)
+            if (strlen (words[i]) == (size_t) (args - word)
+                && !strncasecmp (word, words[i], args - word))
+                return 1;
+    }
+
+    return 0;
+}
+
+int svdrp_cmd_time_relative(const char *cmd, size_t len)
+{
+    if (!cmd || len <= SVDRP_VERB_LEN)
+        return 0;
+
+    return svdrp_args_time_relative (cmd + SVDRP_VERB_LEN,
+                                     len - SVDRP_VERB_LEN);
+}
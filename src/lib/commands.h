@@ -0,0 +1,130 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef SVDRP_COMMANDS_H
+#define SVDRP_COMMANDS_H
+
+/**
+ * \file commands.h
+ *
+ * libsvdrp internal table of the SVDRP commands.
+ */
+
+#include <stddef.h>
+
+/** \brief SVDRP command verbs, in alphabetical order. */
+typedef enum {
+    SVDRP_VERB_CHAN,
+    SVDRP_VERB_CLRE,
+    SVDRP_VERB_CPYR,
+    SVDRP_VERB_DELC,
+    SVDRP_VERB_DELR,
+    SVDRP_VERB_DELT,
+    SVDRP_VERB_EDIT,
+    SVDRP_VERB_GRAB,
+    SVDRP_VERB_HELP,
+    SVDRP_VERB_HITK,
+    SVDRP_VERB_LSTC,
+    SVDRP_VERB_LSTD,
+    SVDRP_VERB_LSTE,
+    SVDRP_VERB_LSTR,
+    SVDRP_VERB_LSTT,
+    SVDRP_VERB_MESG,
+    SVDRP_VERB_MODC,
+    SVDRP_VERB_MODT,
+    SVDRP_VERB_MOVC,
+    SVDRP_VERB_MOVR,
+    SVDRP_VERB_NEWC,
+    SVDRP_VERB_NEWT,
+    SVDRP_VERB_NEXT,
+    SVDRP_VERB_PING,
+    SVDRP_VERB_PLAY,
+    SVDRP_VERB_PLUG,
+    SVDRP_VERB_POLL,
+    SVDRP_VERB_PRIM,
+    SVDRP_VERB_PUTE,
+    SVDRP_VERB_QUIT,
+    SVDRP_VERB_REMO,
+    SVDRP_VERB_SCAN,
+    SVDRP_VERB_STAT,
+    SVDRP_VERB_UPDR,
+    SVDRP_VERB_UPDT,
+    SVDRP_VERB_VOLU,
+    SVDRP_VERB_OTHER,             /**< anything not listed above */
+    SVDRP_VERB_COUNT,
+} svdrp_verb_t;
+
+/** \brief Parts of the VDR state, as read or changed by the commands. */
+#define SVDRP_DATA_CHANNELS   (1 << 0)
+#define SVDRP_DATA_TIMERS     (1 << 1)
+#define SVDRP_DATA_RECORDINGS (1 << 2)
+#define SVDRP_DATA_EPG        (1 << 3)
+#define SVDRP_DATA_DISK       (1 << 4)
+#define SVDRP_DATA_STATE      (1 << 5) /**< current channel, volume, devices */
+#define SVDRP_DATA_HELP       (1 << 6) /**< commands, plugins */
+#define SVDRP_DATA_ALL        ((1 << 7) - 1)
+
+/** \brief Properties of a command verb. */
+typedef struct svdrp_verb_info_s {
+    const char *name;
+    int reads;                    /**< data the reply reflects, 0 if the
+                                   *   reply cannot be cached */
+    int writes;                   /**< data the command may change */
+    int idempotent;               /**< whether sending it twice does no
+                                   *   harm */
+} svdrp_verb_info_t;
+
+/** \brief Properties of the verbs, indexed by svdrp_verb_t. */
+extern const svdrp_verb_info_t svdrp_verbs[SVDRP_VERB_COUNT];
+
+/**
+ * \brief Find the verb of a command line.
+ *
+ * \param[in] cmd         the command line
+ * \param[in] len         length of cmd
+ * \return                the verb, SVDRP_VERB_OTHER if unknown
+ */
+svdrp_verb_t svdrp_verb_lookup(const char *cmd, size_t len);
+
+/**
+ * \brief Tell whether command arguments are relative to the current time.
+ *
+ * \param[in] args        the arguments, without the verb
+ * \param[in] len         length of args
+ * \return                1 if one of them is rel, now, next or at, 0
+ *                        otherwise
+ */
+int svdrp_args_time_relative(const char *args, size_t len);
+
+/**
+ * \brief Tell whether a command reads relative to the current time.
+ *
+ * NEXT rel and LSTE now, next or at give a different answer from one
+ * moment to the next for the same text.
+ *
+ * \param[in] cmd         the command line
+ * \param[in] len         length of cmd
+ * \return                1 if an argument is rel, now, next or at, 0
+ *                        otherwise
+ */
+int svdrp_cmd_time_relative(const char *cmd, size_t len);
+
+#endif /* SVDRP_COMMANDS_H */
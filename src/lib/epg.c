@@ -0,0 +1,681 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "svdrp.h"
+#include "svdrp_internals.h"
+#include "logs.h"
+
+/* which optional event fields have been seen since the last 'E' record */
+#define EPG_FIELD_TITLE       (1 << 0)
+#define EPG_FIELD_SHORT_TEXT  (1 << 1)
+#define EPG_FIELD_DESCRIPTION (1 << 2)
+
+/* component whose strings are stored as offsets into components_text */
+typedef struct epg_component_ref_s {
+    int stream;
+    int type;
+    size_t language;
+    size_t description;
+    int has_description;
+} epg_component_ref_t;
+
+struct svdrp_epg_parser_s {
+    svdrp_epg_channel_cb_t channel_cb;
+    svdrp_epg_event_cb_t event_cb;
+    void *data;
+
+    strbuf_t cmd;                 /* LSTE command of the last fetch */
+    strbuf_t pending;             /* incomplete line left by the last feed */
+
+    int in_channel;
+    strbuf_t channel_id;
+    strbuf_t channel_name;
+    svdrp_epg_channel_t channel;
+
+    int in_event;
+    int fields;
+    strbuf_t title;
+    strbuf_t short_text;
+    strbuf_t description;
+    strbuf_t components_text;
+    epg_component_ref_t *refs;
+    svdrp_epg_component_t *components;
+    int components_size;
+    svdrp_epg_event_t event;
+};
+
+svdrp_epg_parser_t *svdrp_epg_parser_new (svdrp_epg_channel_cb_t channel_cb,
+                                          svdrp_epg_event_cb_t event_cb,
+                                          void *data)
+{
+    svdrp_epg_parser_t *parser;
+
+    parser = calloc (1, sizeof (svdrp_epg_parser_t));
+    if (!parser)
+        return NULL;
+
+    parser->channel_cb = channel_cb;
+    parser->event_cb = event_cb;
+    parser->data = data;
+
+    return parser;
+}
+
+void svdrp_epg_parser_free (svdrp_epg_parser_t *parser)
+{
+    if (!parser)
+        return;
+
+    strbuf_free (&parser->cmd);
+    strbuf_free (&parser->pending);
+    strbuf_free (&parser->channel_id);
+    strbuf_free (&parser->channel_name);
+    strbuf_free (&parser->title);
+    strbuf_free (&parser->short_text);
+    strbuf_free (&parser->description);
+    strbuf_free (&parser->components_text);
+    free (parser->refs);
+    free (parser->components);
+    free (parser);
+}
+
+/* parse a number out of a non NUL-terminated string */
+static const char *epg_parse_num (const char *p, const char *end,
+                                  int base, long *val)
+{
+    int digit;
+
+    while (p < end && *p == ' ')
+        p++;
+
+    *val = 0;
+    for (; p < end; p++) {
+        if (*p >= '0' && *p <= '9')
+            digit = *p - '0';
+        else if (base == 16 && *p >= 'a' && *p <= 'f')
+            digit = *p - 'a' + 10;
+        else if (base == 16 && *p >= 'A' && *p <= 'F')
+            digit = *p - 'A' + 10;
+        else
+            break;
+        *val = *val * base + digit;
+    }
+
+    return p;
+}
+
+static const char *epg_skip_spaces (const char *p, const char *end)
+{
+    while (p < end && *p == ' ')
+        p++;
+    return p;
+}
+
+static int epg_channel (svdrp_epg_parser_t *parser,
+                        const char *p, const char *end)
+{
+    const char *sep = memchr (p, ' ', end - p);
+
+    if (strbuf_set (&parser->channel_id, p, (sep ? sep : end) - p) < 0)
+        return SVDRP_ERROR;
+
+    parser->channel.id = parser->channel_id.data;
+    parser->channel.name = NULL;
+
+    if (sep) {
+        sep = epg_skip_spaces (sep, end);
+        if (strbuf_set (&parser->channel_name, sep, end - sep) < 0)
+            return SVDRP_ERROR;
+        parser->channel.name = parser->channel_name.data;
+    }
+
+    parser->in_channel = 1;
+
+    if (parser->channel_cb)
+        parser->channel_cb (parser->data, &parser->channel);
+
+    return SVDRP_OK;
+}
+
+static void epg_event (svdrp_epg_parser_t *parser,
+                       const char *p, const char *end)
+{
+    svdrp_epg_event_t *event = &parser->event;
+    long val;
+
+    memset (event, 0, sizeof (svdrp_epg_event_t));
+
+    p = epg_parse_num (p, end, 10, &val);
+    event->id = val;
+    p = epg_parse_num (p, end, 10, &val);
+    event->start = val;
+    p = epg_parse_num (p, end, 10, &val);
+    event->duration = val;
+    p = epg_parse_num (p, end, 16, &val);
+    event->table_id = val;
+    p = epg_parse_num (p, end, 16, &val);
+    event->version = val;
+
+    parser->in_event = 1;
+    parser->fields = 0;
+    parser->components_text.len = 0;
+}
+
+static int epg_component (svdrp_epg_parser_t *parser,
+                          const char *p, const char *end)
+{
+    svdrp_epg_event_t *event = &parser->event;
+    epg_component_ref_t *ref;
+    const char *sep;
+    long val;
+
+    if (event->components_count == parser->components_size) {
+        int size = parser->components_size ? 2 * parser->components_size : 4;
+        epg_component_ref_t *refs;
+        svdrp_epg_component_t *components;
+
+        refs = realloc (parser->refs, size * sizeof (epg_component_ref_t));
+        if (!refs)
+            return SVDRP_ERROR;
+        parser->refs = refs;
+
+        components = realloc (parser->components,
+                              size * sizeof (svdrp_epg_component_t));
+        if (!components)
+            return SVDRP_ERROR;
+        parser->components = components;
+
+        parser->components_size = size;
+    }
+
+    ref = &parser->refs[event->components_count];
+
+    p = epg_parse_num (p, end, 16, &val);
+    ref->stream = val;
+    p = epg_parse_num (p, end, 16, &val);
+    ref->type = val;
+
+    p = epg_skip_spaces (p, end);
+    sep = memchr (p, ' ', end - p);
+    if (!sep)
+        sep = end;
+
+    /* keep the terminating NUL of each string inside components_text */
+    ref->language = parser->components_text.len;
+    if (strbuf_append (&parser->components_text, p, sep - p) < 0
+        || strbuf_append (&parser->components_text, "", 1) < 0)
+        return SVDRP_ERROR;
+
+    p = epg_skip_spaces (sep, end);
+    ref->has_description = (p < end);
+    ref->description = parser->components_text.len;
+    if (strbuf_append (&parser->components_text, p, end - p) < 0
+        || strbuf_append (&parser->components_text, "", 1) < 0)
+        return SVDRP_ERROR;
+
+    event->components_count++;
+
+    return SVDRP_OK;
+}
+
+static void epg_emit (svdrp_epg_parser_t *parser)
+{
+    svdrp_epg_event_t *event = &parser->event;
+    int i;
+
+    parser->in_event = 0;
+
+    if (!parser->event_cb)
+        return;
+
+    event->channel = parser->in_channel ? &parser->channel : NULL;
+    event->title =
+        (parser->fields & EPG_FIELD_TITLE) ? parser->title.data : NULL;
+    event->short_text =
+        (parser->fields & EPG_FIELD_SHORT_TEXT) ? parser->short_text.data : NULL;
+    event->description =
+        (parser->fields & EPG_FIELD_DESCRIPTION) ? parser->description.data : NULL;
+
+    /* components_text does not move anymore, resolve the offsets */
+    for (i = 0; i < event->components_count; i++) {
+        epg_component_ref_t *ref = &parser->refs[i];
+        svdrp_epg_component_t *component = &parser->components[i];
+
+        component->stream = ref->stream;
+        component->type = ref->type;
+        component->language = parser->components_text.data + ref->language;
+        component->description = ref->has_description ?
+            parser->components_text.data + ref->description : NULL;
+    }
+    event->components = event->components_count ? parser->components : NULL;
+
+    parser->event_cb (parser->data, event);
+}
+
+int svdrp_epg_parser_feed_line (svdrp_epg_parser_t *parser,
+                                const char *line, size_t len)
+{
+    const char *end;
+    char record;
+    long val;
+
+    if (!parser || !line)
+        return SVDRP_ERROR;
+
+    if (len > 0 && line[len - 1] == '\r')
+        len--;
+
+    /* skip the "215-" reply code prefix when reading from SVDRP */
+    if (len >= 4 && line[0] >= '0' && line[0] <= '9'
+        && (line[3] == '-' || line[3] == ' ')) {
+        line += 4;
+        len -= 4;
+    }
+
+    /* records are a single letter, followed by a space or nothing */
+    if (len == 0 || (len > 1 && line[1] != ' '))
+        return SVDRP_OK;
+
+    record = line[0];
+    end = line + len;
+    line = epg_skip_spaces (line + 1, end);
+
+    switch (record)
+    {
+    case 'C':
+        return epg_channel (parser, line, end);
+    case 'c':
+        parser->in_channel = 0;
+        break;
+    case 'E':
+        epg_event (parser, line, end);
+        break;
+    case 'T':
+        if (strbuf_set (&parser->title, line, end - line) < 0)
+            return SVDRP_ERROR;
+        parser->fields |= EPG_FIELD_TITLE;
+        break;
+    case 'S':
+        if (strbuf_set (&parser->short_text, line, end - line) < 0)
+            return SVDRP_ERROR;
+        parser->fields |= EPG_FIELD_SHORT_TEXT;
+        break;
+    case 'D':
+        if (strbuf_set (&parser->description, line, end - line) < 0)
+            return SVDRP_ERROR;
+        parser->fields |= EPG_FIELD_DESCRIPTION;
+        break;
+    case 'R':
+        epg_parse_num (line, end, 10, &val);
+        parser->event.parental_rating = val;
+        break;
+    case 'X':
+        return epg_component (parser, line, end);
+    case 'V':
+        epg_parse_num (line, end, 10, &val);
+        parser->event.vps = val;
+        break;
+    case 'e':
+        if (parser->in_event)
+            epg_emit (parser);
+        break;
+    default:
+        /* G (genre) and unknown records are not decoded */
+        break;
+    }
+
+    return SVDRP_OK;
+}
+
+int svdrp_epg_parser_feed (svdrp_epg_parser_t *parser,
+                           const char *buf, size_t len)
+{
+    const char *end = buf + len;
+    const char *eol;
+
+    if (!parser || !buf)
+        return SVDRP_ERROR;
+
+    while ((eol = memchr (buf, '\n', end - buf))) {
+        int ret;
+
+        if (parser->pending.len) {
+            /* complete the line started by a previous feed */
+            if (strbuf_append (&parser->pending, buf, eol - buf) < 0)
+                return SVDRP_ERROR;
+            ret = svdrp_epg_parser_feed_line (parser, parser->pending.data,
+                                              parser->pending.len);
+            parser->pending.len = 0;
+        } else {
+            ret = svdrp_epg_parser_feed_line (parser, buf, eol - buf);
+        }
+
+        if (ret != SVDRP_OK)
+            return ret;
+
+        buf = eol + 1;
+    }
+
+    if (buf < end && strbuf_append (&parser->pending, buf, end - buf) < 0)
+        return SVDRP_ERROR;
+
+    return SVDRP_OK;
+}
+
+static void epg_reply_cb (void *data, int code,
+                          const char *line, size_t len, int last)
+{
+    svdrp_epg_parser_t *parser = data;
+
+    (void) last;
+
+    if (code == SVDRP_REPLY_EPG_DATA)
+        svdrp_epg_parser_feed_line (parser, line, len);
+}
+
+int svdrp_epg_parser_fetch (svdrp_epg_parser_t *parser, svdrp_t *svdrp,
+                            const char *args)
+{
+    int code;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (!parser || !svdrp)
+        return SVDRP_ERROR;
+
+    /* the command storage is kept, like the one of the event strings */
+    if (strbuf_set (&parser->cmd, "LSTE", 4) < 0
+        || (args && *args && (strbuf_append (&parser->cmd, " ", 1) < 0
+                              || strbuf_append (&parser->cmd, args, strlen (args)) < 0)))
+        return SVDRP_ERROR;
+
+    /* leftovers of an interrupted fetch */
+    parser->pending.len = 0;
+    parser->in_channel = 0;
+    parser->in_event = 0;
+
+    svdrp_log (svdrp, SVDRP_MSG_INFO, "Get EPG data");
+    code = svdrp_command (svdrp, parser->cmd.data, epg_reply_cb, parser);
+
+    return code == SVDRP_REPLY_EPG_DATA ? SVDRP_OK : SVDRP_ERROR;
+}
+
+int svdrp_get_epg (svdrp_t *svdrp, const char *args,
+                   svdrp_epg_channel_cb_t channel_cb,
+                   svdrp_epg_event_cb_t event_cb, void *data)
+{
+    svdrp_epg_parser_t *parser;
+    int ret;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (!svdrp)
+        return SVDRP_ERROR;
+
+    parser = svdrp_epg_parser_new (channel_cb, event_cb, data);
+    if (!parser)
+        return SVDRP_ERROR;
+
+    ret = svdrp_epg_parser_fetch (parser, svdrp, args);
+    svdrp_epg_parser_free (parser);
+
+    return ret;
+}
+
+static size_t epg_str_size (const char *str)
+{
+    return str ? strlen (str) + 1 : 0;
+}
+
+static const char *epg_copy_str (char **pool, const char *str)
+{
+    char *copy = *pool;
+    size_t len;
+
+    if (!str)
+        return NULL;
+
+    len = strlen (str) + 1;
+    memcpy (copy, str, len);
+    *pool += len;
+
+    return copy;
+}
+
+/* bytes taken by the components and strings of an event */
+static size_t epg_event_data_size (const svdrp_epg_event_t *event)
+{
+    size_t size;
+    int i;
+
+    size = event->components_count * sizeof (svdrp_epg_component_t)
+        + epg_str_size (event->title) + epg_str_size (event->short_text)
+        + epg_str_size (event->description);
+    for (i = 0; i < event->components_count; i++)
+        size += epg_str_size (event->components[i].language)
+            + epg_str_size (event->components[i].description);
+
+    return size;
+}
+
+/*
+ * Copy an event, its components then its strings going to the block
+ * (of epg_event_data_size() bytes); returns the end of the block.
+ */
+static char *epg_event_fill (svdrp_epg_event_t *copy,
+                             const svdrp_epg_event_t *event, void *block)
+{
+    svdrp_epg_component_t *components = block;
+    char *pool;
+    int i;
+
+    pool = (char *) (components + event->components_count);
+
+    *copy = *event;
+    copy->title = epg_copy_str (&pool, event->title);
+    copy->short_text = epg_copy_str (&pool, event->short_text);
+    copy->description = epg_copy_str (&pool, event->description);
+
+    for (i = 0; i < event->components_count; i++) {
+        components[i] = event->components[i];
+        components[i].language = epg_copy_str (&pool, event->components[i].language);
+        components[i].description = epg_copy_str (&pool, event->components[i].description);
+    }
+    copy->components = event->components_count ? components : NULL;
+
+    return pool;
+}
+
+svdrp_epg_event_t *svdrp_epg_event_materialize (const svdrp_epg_event_t *event)
+{
+    svdrp_epg_event_t *copy;
+    svdrp_epg_channel_t *channel = NULL;
+    size_t size;
+    char *pool;
+
+    if (!event)
+        return NULL;
+
+    /* the event, its channel, its data, then the strings of the channel */
+    size = sizeof (svdrp_epg_event_t) + sizeof (svdrp_epg_channel_t)
+        + epg_event_data_size (event);
+    if (event->channel)
+        size += epg_str_size (event->channel->id)
+            + epg_str_size (event->channel->name);
+
+    copy = malloc (size);
+    if (!copy)
+        return NULL;
+
+    pool = epg_event_fill (copy, event, (svdrp_epg_channel_t *) (copy + 1) + 1);
+
+    if (event->channel) {
+        channel = (svdrp_epg_channel_t *) (copy + 1);
+        channel->id = epg_copy_str (&pool, event->channel->id);
+        channel->name = epg_copy_str (&pool, event->channel->name);
+    }
+    copy->channel = channel;
+
+    return copy;
+}
+
+int svdrp_epg_event_copy (svdrp_arena_t *arena, svdrp_epg_event_t *copy,
+                          const svdrp_epg_event_t *event)
+{
+    size_t size = epg_event_data_size (event);
+    void *block = NULL;
+
+    if (size && !(block = svdrp_arena_alloc (arena, size)))
+        return SVDRP_ERROR;
+
+    epg_event_fill (copy, event, block);
+
+    return SVDRP_OK;
+}
+
+/* event copied to the arena, linked until the array of the snapshot */
+typedef struct epg_snapshot_event_s {
+    struct epg_snapshot_event_s *next;
+    svdrp_epg_event_t event;
+} epg_snapshot_event_t;
+
+typedef struct epg_snapshot_s {
+    svdrp_arena_t *arena;
+    const svdrp_epg_channel_t *channel; /* copy of the current channel */
+    epg_snapshot_event_t *head;
+    epg_snapshot_event_t *tail;
+    int count;
+    int error;
+} epg_snapshot_t;
+
+static void epg_snapshot_channel (void *data, const svdrp_epg_channel_t *channel)
+{
+    epg_snapshot_t *snapshot = data;
+
+    (void) channel;
+
+    /* copied along with its first event, if any */
+    snapshot->channel = NULL;
+}
+
+static const svdrp_epg_channel_t *epg_snapshot_copy_channel (svdrp_arena_t *arena,
+                                                             const svdrp_epg_channel_t *channel)
+{
+    svdrp_epg_channel_t *copy;
+
+    copy = svdrp_arena_alloc (arena, sizeof (svdrp_epg_channel_t));
+    if (!copy)
+        return NULL;
+
+    copy->id = svdrp_arena_strdup (arena, channel->id);
+    copy->name = svdrp_arena_strdup (arena, channel->name);
+    if ((channel->id && !copy->id) || (channel->name && !copy->name))
+        return NULL;
+
+    return copy;
+}
+
+static void epg_snapshot_event (void *data, const svdrp_epg_event_t *event)
+{
+    epg_snapshot_t *snapshot = data;
+    epg_snapshot_event_t *entry;
+
+    if (snapshot->error)
+        return;
+
+    if (event->channel && !snapshot->channel) {
+        snapshot->channel = epg_snapshot_copy_channel (snapshot->arena, event->channel);
+        if (!snapshot->channel) {
+            snapshot->error = 1;
+            return;
+        }
+    }
+
+    entry = svdrp_arena_alloc (snapshot->arena, sizeof (epg_snapshot_event_t));
+    if (!entry || svdrp_epg_event_copy (snapshot->arena, &entry->event,
+                                        event) != SVDRP_OK) {
+        snapshot->error = 1;
+        return;
+    }
+
+    entry->next = NULL;
+    entry->event.channel = event->channel ? snapshot->channel : NULL;
+
+    if (snapshot->tail)
+        snapshot->tail->next = entry;
+    else
+        snapshot->head = entry;
+    snapshot->tail = entry;
+    snapshot->count++;
+}
+
+int svdrp_snapshot_epg (svdrp_t *svdrp, svdrp_arena_t *arena, const char *args,
+                        svdrp_epg_event_t **events, int *count)
+{
+    epg_snapshot_t snapshot;
+    epg_snapshot_event_t *entry;
+    svdrp_epg_parser_t *parser;
+    svdrp_epg_event_t *array;
+    int i, ret;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (!svdrp || !arena || !events || !count)
+        return SVDRP_ERROR;
+
+    *events = NULL;
+    *count = 0;
+
+    memset (&snapshot, 0, sizeof (snapshot));
+    snapshot.arena = arena;
+
+    parser = svdrp_epg_parser_new (epg_snapshot_channel, epg_snapshot_event,
+                                   &snapshot);
+    if (!parser)
+        return SVDRP_ERROR;
+
+    ret = svdrp_epg_parser_fetch (parser, svdrp, args);
+    svdrp_epg_parser_free (parser);
+
+    if (ret != SVDRP_OK || snapshot.error)
+        return SVDRP_ERROR;
+
+    if (!snapshot.count)
+        return SVDRP_OK;
+
+    array = svdrp_arena_alloc (arena, snapshot.count * sizeof (svdrp_epg_event_t));
+    if (!array)
+        return SVDRP_ERROR;
+
+    for (i = 0, entry = snapshot.head; entry; entry = entry->next)
+        array[i++] = entry->event;
+
+    svdrp_log (svdrp, SVDRP_MSG_INFO, "Got %i events", snapshot.count);
+
+    *events = array;
+    *count = snapshot.count;
+
+    return SVDRP_OK;
+}
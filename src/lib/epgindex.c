@@ -0,0 +1,449 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "svdrp.h"
+#include "svdrp_internals.h"
+#include "logs.h"
+#include "commands.h"
+
+/* a channel holds about a hundred events a day */
+#define EPG_INDEX_CHUNK_SIZE (16 * 1024)
+
+typedef struct epg_index_channel_s {
+    svdrp_arena_t *arena;         /* strings of the channel and its events */
+    svdrp_epg_channel_t *channel;
+    time_t *starts;               /* searched apart from the events */
+    svdrp_epg_event_t *events;    /* sorted by start time */
+    int count;
+    int size;
+} epg_index_channel_t;
+
+struct svdrp_epg_index_s {
+    epg_index_channel_t **channels; /* in the order of VDR */
+    epg_index_channel_t **by_id;  /* sorted by channel ID */
+    int count;
+    int size;
+};
+
+/* channels of a fetch, merged into the index once it succeeded */
+typedef struct epg_index_fill_s {
+    epg_index_channel_t **channels;
+    int count;
+    int size;
+    int error;
+} epg_index_fill_t;
+
+static void epg_index_channel_free (epg_index_channel_t *channel)
+{
+    if (!channel)
+        return;
+
+    svdrp_arena_free (channel->arena);
+    free (channel->starts);
+    free (channel->events);
+    free (channel);
+}
+
+svdrp_epg_index_t *svdrp_epg_index_new (void)
+{
+    return calloc (1, sizeof (svdrp_epg_index_t));
+}
+
+void svdrp_epg_index_clear (svdrp_epg_index_t *index)
+{
+    int i;
+
+    if (!index)
+        return;
+
+    for (i = 0; i < index->count; i++)
+        epg_index_channel_free (index->channels[i]);
+    index->count = 0;
+}
+
+void svdrp_epg_index_free (svdrp_epg_index_t *index)
+{
+    if (!index)
+        return;
+
+    svdrp_epg_index_clear (index);
+    free (index->channels);
+    free (index->by_id);
+    free (index);
+}
+
+static int epg_index_push (epg_index_channel_t ***channels, int *count,
+                           int *size, epg_index_channel_t *channel)
+{
+    if (*count == *size) {
+        int new_size = *size ? 2 * *size : 64;
+        epg_index_channel_t **array;
+
+        array = realloc (*channels, new_size * sizeof (epg_index_channel_t *));
+        if (!array)
+            return SVDRP_ERROR;
+
+        *channels = array;
+        *size = new_size;
+    }
+
+    (*channels)[(*count)++] = channel;
+
+    return SVDRP_OK;
+}
+
+static void epg_index_fill_channel (void *data, const svdrp_epg_channel_t *channel)
+{
+    epg_index_fill_t *fill = data;
+    epg_index_channel_t *entry;
+
+    if (fill->error)
+        return;
+
+    entry = calloc (1, sizeof (epg_index_channel_t));
+    if (!entry) {
+        fill->error = 1;
+        return;
+    }
+
+    entry->arena = svdrp_arena_new (EPG_INDEX_CHUNK_SIZE);
+    entry->channel = svdrp_arena_alloc (entry->arena, sizeof (svdrp_epg_channel_t));
+    if (!entry->channel
+        || !(entry->channel->id = svdrp_arena_strdup (entry->arena, channel->id))
+        || epg_index_push (&fill->channels, &fill->count, &fill->size,
+                           entry) != SVDRP_OK) {
+        epg_index_channel_free (entry);
+        fill->error = 1;
+        return;
+    }
+
+    entry->channel->name = svdrp_arena_strdup (entry->arena, channel->name);
+    if (channel->name && !entry->channel->name)
+        fill->error = 1;
+}
+
+static void epg_index_fill_event (void *data, const svdrp_epg_event_t *event)
+{
+    epg_index_fill_t *fill = data;
+    epg_index_channel_t *entry;
+
+    /* events are only listed within a channel */
+    if (fill->error || !fill->count || !event->channel)
+        return;
+
+    entry = fill->channels[fill->count - 1];
+    if (entry->count == entry->size) {
+        int size = entry->size ? 2 * entry->size : 64;
+        svdrp_epg_event_t *events;
+
+        events = realloc (entry->events, size * sizeof (svdrp_epg_event_t));
+        if (!events) {
+            fill->error = 1;
+            return;
+        }
+        entry->events = events;
+        entry->size = size;
+    }
+
+    if (svdrp_epg_event_copy (entry->arena, &entry->events[entry->count],
+                              event) != SVDRP_OK) {
+        fill->error = 1;
+        return;
+    }
+    entry->events[entry->count++].channel = entry->channel;
+}
+
+static int epg_index_cmp_start (const void *a, const void *b)
+{
+    const svdrp_epg_event_t *ea = a, *eb = b;
+
+    return (ea->start > eb->start) - (ea->start < eb->start);
+}
+
+static int epg_index_cmp_id (const void *a, const void *b)
+{
+    const epg_index_channel_t *ca = *(epg_index_channel_t * const *) a;
+    const epg_index_channel_t *cb = *(epg_index_channel_t * const *) b;
+
+    return strcmp (ca->channel->id, cb->channel->id);
+}
+
+/* sort the events of a channel, VDR lists them in order already */
+static int epg_index_sort (epg_index_channel_t *entry)
+{
+    int i;
+
+    for (i = 1; i < entry->count; i++)
+        if (entry->events[i].start < entry->events[i - 1].start) {
+            qsort (entry->events, entry->count, sizeof (svdrp_epg_event_t),
+                   epg_index_cmp_start);
+            break;
+        }
+
+    entry->starts = malloc ((entry->count ? entry->count : 1) * sizeof (time_t));
+    if (!entry->starts)
+        return SVDRP_ERROR;
+
+    for (i = 0; i < entry->count; i++)
+        entry->starts[i] = entry->events[i].start;
+
+    return SVDRP_OK;
+}
+
+static epg_index_channel_t *epg_index_find (svdrp_epg_index_t *index,
+                                            const char *id)
+{
+    int low = 0, high, mid, cmp;
+
+    if (!index || !id)
+        return NULL;
+
+    high = index->count - 1;
+    while (low <= high) {
+        mid = low + (high - low) / 2;
+        cmp = strcmp (index->by_id[mid]->channel->id, id);
+        if (!cmp)
+            return index->by_id[mid];
+        if (cmp < 0)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+
+    return NULL;
+}
+
+static int epg_index_merge (svdrp_epg_index_t *index, epg_index_fill_t *fill,
+                            int full)
+{
+    epg_index_channel_t **by_id;
+    int i, j;
+
+    /* room for every channel, so that nothing can fail past this point */
+    if (index->count + fill->count > index->size) {
+        int size = index->count + fill->count;
+        epg_index_channel_t **channels;
+
+        channels = realloc (index->channels, size * sizeof (epg_index_channel_t *));
+        if (!channels)
+            return SVDRP_ERROR;
+        index->channels = channels;
+
+        by_id = realloc (index->by_id, size * sizeof (epg_index_channel_t *));
+        if (!by_id)
+            return SVDRP_ERROR;
+        index->by_id = by_id;
+
+        index->size = size;
+    }
+
+    /* the whole EPG replaces the index, a part of it the same channels */
+    if (full) {
+        svdrp_epg_index_clear (index);
+        memcpy (index->channels, fill->channels,
+                fill->count * sizeof (epg_index_channel_t *));
+        index->count = fill->count;
+    }
+    else {
+        for (i = 0; i < fill->count; i++) {
+            for (j = 0; j < index->count; j++)
+                if (!strcmp (index->channels[j]->channel->id,
+                             fill->channels[i]->channel->id))
+                    break;
+
+            if (j < index->count)
+                epg_index_channel_free (index->channels[j]);
+            else
+                index->count++;
+            index->channels[j] = fill->channels[i];
+        }
+    }
+    fill->count = 0;
+
+    memcpy (index->by_id, index->channels,
+            index->count * sizeof (epg_index_channel_t *));
+    qsort (index->by_id, index->count, sizeof (epg_index_channel_t *),
+           epg_index_cmp_id);
+
+    return SVDRP_OK;
+}
+
+int svdrp_epg_index_fetch (svdrp_epg_index_t *index, svdrp_t *svdrp,
+                           const char *args)
+{
+    epg_index_fill_t fill;
+    svdrp_epg_parser_t *parser;
+    int i, events = 0, ret;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (!index || !svdrp)
+        return SVDRP_ERROR;
+
+    /* a time window would replace the schedules it cuts short */
+    if (args && svdrp_args_time_relative (args, strlen (args))) {
+        svdrp_log (svdrp, SVDRP_MSG_ERROR,
+                   "Time-filtered LSTE arguments cannot be indexed: %s", args);
+        return SVDRP_ERROR;
+    }
+
+    memset (&fill, 0, sizeof (fill));
+
+    parser = svdrp_epg_parser_new (epg_index_fill_channel,
+                                   epg_index_fill_event, &fill);
+    if (!parser)
+        return SVDRP_ERROR;
+
+    ret = svdrp_epg_parser_fetch (parser, svdrp, args);
+    svdrp_epg_parser_free (parser);
+
+    if (ret == SVDRP_OK && fill.error)
+        ret = SVDRP_ERROR;
+
+    for (i = 0; ret == SVDRP_OK && i < fill.count; i++) {
+        ret = epg_index_sort (fill.channels[i]);
+        events += fill.channels[i]->count;
+    }
+
+    /* the index stays as it was if anything went wrong */
+    if (ret == SVDRP_OK)
+        ret = epg_index_merge (index, &fill, !args || !*args);
+
+    if (ret == SVDRP_OK)
+        svdrp_log (svdrp, SVDRP_MSG_INFO, "Indexed %i events of %i channels",
+                   events, i);
+
+    for (i = 0; i < fill.count; i++)
+        epg_index_channel_free (fill.channels[i]);
+    free (fill.channels);
+
+    return ret;
+}
+
+int svdrp_epg_index_channels (svdrp_epg_index_t *index)
+{
+    return index ? index->count : 0;
+}
+
+const svdrp_epg_channel_t *svdrp_epg_index_get_channel (svdrp_epg_index_t *index,
+                                                         int i)
+{
+    if (!index || i < 0 || i >= index->count)
+        return NULL;
+
+    return index->channels[i]->channel;
+}
+
+int svdrp_epg_index_events (svdrp_epg_index_t *index, const char *channel_id,
+                            const svdrp_epg_event_t **events)
+{
+    epg_index_channel_t *entry = epg_index_find (index, channel_id);
+
+    if (events)
+        *events = entry && entry->count ? entry->events : NULL;
+
+    return entry ? entry->count : 0;
+}
+
+/* position of the first event starting after t */
+static int epg_index_after (const epg_index_channel_t *entry, time_t t)
+{
+    int low = 0, high = entry->count, mid;
+
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (entry->starts[mid] <= t)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+/* position of the event running at t, or of the next one */
+static int epg_index_from (const epg_index_channel_t *entry, time_t t)
+{
+    int i = epg_index_after (entry, t);
+
+    if (i > 0 && entry->starts[i - 1] + entry->events[i - 1].duration > t)
+        i--;
+
+    return i;
+}
+
+const svdrp_epg_event_t *svdrp_epg_index_at (svdrp_epg_index_t *index,
+                                             const char *channel_id, time_t t)
+{
+    epg_index_channel_t *entry = epg_index_find (index, channel_id);
+    int i;
+
+    if (!entry)
+        return NULL;
+
+    i = epg_index_from (entry, t);
+    if (i == entry->count || entry->starts[i] > t)
+        return NULL;
+
+    return &entry->events[i];
+}
+
+const svdrp_epg_event_t *svdrp_epg_index_next (svdrp_epg_index_t *index,
+                                               const char *channel_id, time_t t)
+{
+    epg_index_channel_t *entry = epg_index_find (index, channel_id);
+    int i;
+
+    if (!entry)
+        return NULL;
+
+    i = epg_index_after (entry, t);
+
+    return i < entry->count ? &entry->events[i] : NULL;
+}
+
+int svdrp_epg_index_range (svdrp_epg_index_t *index, const char *channel_id,
+                           time_t from, time_t to,
+                           const svdrp_epg_event_t **events)
+{
+    epg_index_channel_t *entry = epg_index_find (index, channel_id);
+    int first, last;
+
+    if (events)
+        *events = NULL;
+
+    if (!entry || to <= from)
+        return 0;
+
+    /* the events starting before to, from the one running at from */
+    first = epg_index_from (entry, from);
+    last = epg_index_after (entry, to - 1);
+    if (last <= first)
+        return 0;
+
+    if (events)
+        *events = &entry->events[first];
+
+    return last - first;
+}
@@ -0,0 +1,165 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "svdrp.h"
+#include "fields.h"
+
+typedef struct fields_split_s {
+    svdrp_str_t *fields;
+    int count;
+    int max;
+    const char *start;            /* start of the current field */
+} fields_split_t;
+
+/* end the current field at sep, non-zero once only the remainder is left */
+static inline int fields_cut (fields_split_t *split, const char *sep)
+{
+    svdrp_str_t *field = &split->fields[split->count++];
+
+    field->ptr = split->start;
+    field->len = sep - split->start;
+    split->start = sep + 1;
+
+    return split->count == split->max - 1;
+}
+
+/*
+ * Records are mostly short fields, a call to memchr() for each of them
+ * costs more than the search itself. The record is scanned a block at a
+ * time instead, every separator of the block being found at once.
+ */
+int svdrp_fields_split (const char *str, size_t len, char sep,
+                        svdrp_str_t *fields, int max)
+{
+    fields_split_t split;
+    const char *p = str, *end = str + len;
+
+    if (!str || !fields || max < 1)
+        return 0;
+
+    split.fields = fields;
+    split.count = 0;
+    split.max = max;
+    split.start = str;
+
+    if (max == 1)
+        goto remainder;
+
+#ifdef __SSE2__
+    {
+        const __m128i pattern = _mm_set1_epi8 (sep);
+
+        for (; end - p >= 16; p += 16) {
+            __m128i block = _mm_loadu_si128 ((const __m128i *) p);
+            unsigned int mask;
+
+            mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (block, pattern));
+            for (; mask; mask &= mask - 1)
+                if (fields_cut (&split, p + __builtin_ctz (mask)))
+                    goto remainder;
+        }
+    }
+#else
+    {
+        const uint64_t ones = 0x0101010101010101ULL;
+        const uint64_t pattern = ones * (unsigned char) sep;
+
+        /* a block without any separator is skipped at once */
+        for (; end - p >= 8; p += 8) {
+            uint64_t word;
+            int i;
+
+            memcpy (&word, p, 8);
+            word ^= pattern;
+            if (!((word - ones) & ~word & (ones << 7)))
+                continue;
+
+            for (i = 0; i < 8; i++)
+                if (p[i] == sep && fields_cut (&split, p + i))
+                    goto remainder;
+        }
+    }
+#endif
+
+    for (; p < end; p++)
+        if (*p == sep && fields_cut (&split, p))
+            goto remainder;
+
+ remainder:
+    fields[split.count].ptr = split.start;
+    fields[split.count].len = end - split.start;
+
+    return split.count + 1;
+}
+
+void svdrp_fields_unescape (char *dst, const char *src, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        dst[i] = src[i] == SVDRP_FIELD_ESCAPE ? ':' : src[i];
+}
+
+char *svdrp_fields_strdup (const svdrp_str_t *field, int unescape)
+{
+    char *str;
+
+    if (!field->ptr)
+        return NULL;
+
+    str = malloc (field->len + 1);
+    if (!str)
+        return NULL;
+
+    if (unescape)
+        svdrp_fields_unescape (str, field->ptr, field->len);
+    else
+        memcpy (str, field->ptr, field->len);
+    str[field->len] = '\0';
+
+    return str;
+}
+
+int svdrp_fields_int (const svdrp_str_t *field)
+{
+    const char *p = field->ptr, *end = field->ptr + field->len;
+    int val = 0, neg = 0;
+
+    if (!p)
+        return 0;
+
+    if (p < end && *p == '-') {
+        neg = 1;
+        p++;
+    }
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+        val = val * 10 + (*p - '0');
+
+    return neg ? -val : val;
+}
@@ -0,0 +1,76 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#ifndef SVDRP_FIELDS_H
+#define SVDRP_FIELDS_H
+
+/**
+ * \file fields.h
+ *
+ * libsvdrp internal splitter of the VDR colon-separated records.
+ */
+
+#include <stddef.h>
+
+/** \brief Character VDR writes in place of a ':' inside a field. */
+#define SVDRP_FIELD_ESCAPE '|'
+
+/**
+ * \brief Split a record at each separator.
+ *
+ * \param[in] str          record to split
+ * \param[in] len          length of the record
+ * \param[in] sep          separator
+ * \param[out] fields      the fields, pointing into str
+ * \param[in] max          size of fields, the last one taking the remainder
+ * \return                 number of fields found, at most max.
+ */
+int svdrp_fields_split (const char *str, size_t len, char sep,
+                        svdrp_str_t *fields, int max);
+
+/**
+ * \brief Copy a field, turning the escape characters back into colons.
+ *
+ * \param[out] dst         destination, may be the field itself
+ * \param[in] src          field to copy
+ * \param[in] len          length of the field
+ */
+void svdrp_fields_unescape (char *dst, const char *src, size_t len);
+
+/**
+ * \brief Allocate a NUL-terminated copy of a field.
+ *
+ * \param[in] field        field to copy
+ * \param[in] unescape     whether to turn escape characters into colons
+ * \return                 the copy, NULL if the field is absent or on error.
+ */
+char *svdrp_fields_strdup (const svdrp_str_t *field, int unescape);
+
+/**
+ * \brief Parse the decimal number at the start of a field.
+ *
+ * \param[in] field        field to parse
+ * \return                 the number, 0 if the field has none.
+ */
+int svdrp_fields_int (const svdrp_str_t *field);
+
+#endif /* SVDRP_FIELDS_H */
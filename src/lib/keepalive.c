@@ -0,0 +1,124 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "svdrp.h"
+#include "svdrp_internals.h"
+#include "logs.h"
+#include "commands.h"
+
+void svdrp_set_keepalive (svdrp_t *svdrp, int interval)
+{
+    if (!svdrp)
+        return;
+
+    svdrp->keepalive = interval > 0 ? interval : 0;
+    if (!svdrp->keepalive_cmd)
+        svdrp->keepalive_cmd = "PING";
+}
+
+/* one no-op round trip, leaving the caller's last reply and error alone */
+static int keepalive_ping (svdrp_t *svdrp)
+{
+    strbuf_t last_reply = svdrp->last_reply;
+    int last_code = svdrp->last_reply_code;
+    svdrp_error_t error = svdrp->error;
+    unsigned long long bytes_in, bytes_out;
+    long long start;
+    int code, verb;
+
+    memset (&svdrp->last_reply, 0, sizeof (strbuf_t));
+
+    verb = svdrp_verb_lookup (svdrp->keepalive_cmd,
+                              strlen (svdrp->keepalive_cmd));
+    svdrp->verb = verb;
+    svdrp->deadline = monotonic_ms () + svdrp->timeout * 1000LL;
+    start = monotonic_us ();
+    bytes_in = svdrp->rbuf.consumed;
+    bytes_out = svdrp->bytes_out;
+
+    svdrp_send (svdrp, svdrp->keepalive_cmd);
+    code = svdrp_read_reply (svdrp);
+
+    svdrp_metrics_record (svdrp, verb, code, monotonic_us () - start,
+                          svdrp->rbuf.consumed - bytes_in,
+                          svdrp->bytes_out - bytes_out);
+    svdrp->metrics.keepalives++;
+    svdrp->deadline = 0;
+    svdrp->verb = SVDRP_VERB_OTHER;
+
+    strbuf_free (&svdrp->last_reply);
+    svdrp->last_reply = last_reply;
+    svdrp->last_reply_code = last_code;
+    svdrp->error = error;
+
+    return code;
+}
+
+int svdrp_keepalive (svdrp_t *svdrp)
+{
+    int code;
+
+    if (!svdrp)
+        return SVDRP_ERROR;
+
+    if (!svdrp->keepalive || svdrp->replay)
+        return SVDRP_OK;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (svdrp->async) {
+        if (svdrp_async_keepalive_due (svdrp)
+            && svdrp_async_keepalive_due (svdrp) <= monotonic_ms ())
+            return svdrp_async_keepalive (svdrp);
+        return SVDRP_OK;
+    }
+
+    /* reconnect now rather than on the next command */
+    if (!svdrp_conn_alive (svdrp)) {
+        svdrp_log (svdrp, SVDRP_MSG_INFO, "Connection closed while idle, reconnecting");
+        if (svdrp->conn_open)
+            svdrp_close_conn (svdrp);
+        return svdrp_open_conn (svdrp) ? SVDRP_OK : SVDRP_ERROR;
+    }
+
+    if (monotonic_ms () - svdrp->last_activity < svdrp->keepalive * 1000LL)
+        return SVDRP_OK;
+
+    code = keepalive_ping (svdrp);
+
+    /* PING only came with VDR 1.7, STAT is as cheap on older ones */
+    if ((code == SVDRP_REPLY_UNKNOWN_CMD || code == SVDRP_REPLY_UNIMPEMENTED_CMD)
+        && strcmp (svdrp->keepalive_cmd, "PING") == 0) {
+        svdrp_log (svdrp, SVDRP_MSG_INFO, "VDR does not know PING, using STAT");
+        svdrp->keepalive_cmd = "STAT disk";
+        code = keepalive_ping (svdrp);
+    }
+
+    if (code == SVDRP_ERROR || code == SVDRP_REPLY_QUIT) {
+        if (svdrp->conn_open)
+            svdrp_close_conn (svdrp);
+        return svdrp_open_conn (svdrp) ? SVDRP_OK : SVDRP_ERROR;
+    }
+
+    return SVDRP_OK;
+}
@@ -0,0 +1,239 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "svdrp.h"
+
+/* how long the thread sleeps at most when it may have missed a wake-up */
+#define LOG_RING_IDLE_MS 100
+
+/*
+ * The ring is a bounded multi-producer queue after Dmitry Vyukov's design:
+ * each slot carries a sequence number telling whether it is free for the
+ * producer at a given position or filled for the consumer, so producers
+ * only contend on a compare-and-swap of the enqueue position.
+ */
+typedef struct log_slot_s {
+    size_t seq;
+    svdrp_verbosity_level_t level;
+    svdrp_t *svdrp;               /* never dereferenced, maybe closed */
+    struct timespec time;
+    size_t len;
+    char message[SVDRP_LOG_RING_MESSAGE_SIZE];
+} log_slot_t;
+
+struct svdrp_log_ring_s {
+    log_slot_t *slots;
+    size_t mask;
+    size_t enqueue_pos;
+    size_t dequeue_pos;           /* only used by the thread */
+    unsigned long dropped;
+    svdrp_log_sink_t sink;
+    void *data;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int sleeping;
+    int stop;
+};
+
+/* hand the next message to the sink, if there is one */
+static int log_ring_drain_one (svdrp_log_ring_t *ring)
+{
+    log_slot_t *slot = &ring->slots[ring->dequeue_pos & ring->mask];
+    svdrp_log_record_t record;
+
+    if (__atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE) != ring->dequeue_pos + 1)
+        return 0;
+
+    record.level = slot->level;
+    record.svdrp = slot->svdrp;
+    record.time = slot->time;
+    record.message = slot->message;
+    record.len = slot->len;
+    ring->sink (ring->data, &record);
+
+    /* the slot is free again for the producers of the next lap */
+    __atomic_store_n (&slot->seq, ring->dequeue_pos + ring->mask + 1,
+                      __ATOMIC_RELEASE);
+    ring->dequeue_pos++;
+
+    return 1;
+}
+
+static void *log_ring_thread (void *arg)
+{
+    svdrp_log_ring_t *ring = arg;
+
+    for (;;) {
+        struct timespec ts;
+
+        if (log_ring_drain_one (ring))
+            continue;
+
+        if (__atomic_load_n (&ring->stop, __ATOMIC_ACQUIRE))
+            break;
+
+        pthread_mutex_lock (&ring->lock);
+        __atomic_store_n (&ring->sleeping, 1, __ATOMIC_SEQ_CST);
+
+        /* a message may have come before the producers could see the flag */
+        clock_gettime (CLOCK_REALTIME, &ts);
+        ts.tv_nsec += LOG_RING_IDLE_MS * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+
+        if (__atomic_load_n (&ring->slots[ring->dequeue_pos & ring->mask].seq,
+                             __ATOMIC_SEQ_CST) != ring->dequeue_pos + 1
+            && !__atomic_load_n (&ring->stop, __ATOMIC_SEQ_CST))
+            pthread_cond_timedwait (&ring->cond, &ring->lock, &ts);
+
+        __atomic_store_n (&ring->sleeping, 0, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock (&ring->lock);
+    }
+
+    return NULL;
+}
+
+static void log_ring_wakeup (svdrp_log_ring_t *ring)
+{
+    pthread_mutex_lock (&ring->lock);
+    pthread_cond_signal (&ring->cond);
+    pthread_mutex_unlock (&ring->lock);
+}
+
+svdrp_log_ring_t *svdrp_log_ring_new (size_t slots,
+                                      svdrp_log_sink_t sink, void *data)
+{
+    svdrp_log_ring_t *ring;
+    size_t i, size = 2;
+
+    while (size < slots)
+        size <<= 1;
+
+    ring = calloc (1, sizeof (svdrp_log_ring_t));
+    if (!ring)
+        return NULL;
+
+    ring->slots = malloc (size * sizeof (log_slot_t));
+    if (!ring->slots) {
+        free (ring);
+        return NULL;
+    }
+
+    for (i = 0; i < size; i++)
+        ring->slots[i].seq = i;
+
+    ring->mask = size - 1;
+    ring->sink = sink ? sink : svdrp_log_stderr;
+    ring->data = data;
+
+    pthread_mutex_init (&ring->lock, NULL);
+    pthread_cond_init (&ring->cond, NULL);
+
+    if (pthread_create (&ring->thread, NULL, log_ring_thread, ring)) {
+        pthread_cond_destroy (&ring->cond);
+        pthread_mutex_destroy (&ring->lock);
+        free (ring->slots);
+        free (ring);
+        return NULL;
+    }
+
+    return ring;
+}
+
+void svdrp_log_ring_free (svdrp_log_ring_t *ring)
+{
+    if (!ring)
+        return;
+
+    __atomic_store_n (&ring->stop, 1, __ATOMIC_RELEASE);
+    log_ring_wakeup (ring);
+    pthread_join (ring->thread, NULL);
+
+    pthread_cond_destroy (&ring->cond);
+    pthread_mutex_destroy (&ring->lock);
+    free (ring->slots);
+    free (ring);
+}
+
+void svdrp_log_ring_sink (void *data, const svdrp_log_record_t *record)
+{
+    svdrp_log_ring_t *ring = data;
+    log_slot_t *slot;
+    size_t pos, len;
+
+    if (!ring || !record)
+        return;
+
+    pos = __atomic_load_n (&ring->enqueue_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        intptr_t diff;
+
+        slot = &ring->slots[pos & ring->mask];
+        diff = (intptr_t) __atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE)
+            - (intptr_t) pos;
+
+        if (!diff) {
+            if (__atomic_compare_exchange_n (&ring->enqueue_pos, &pos, pos + 1,
+                                             1, __ATOMIC_RELAXED,
+                                             __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0) {
+            /* full, the caller is never held up by a slow sink */
+            __atomic_add_fetch (&ring->dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        else
+            pos = __atomic_load_n (&ring->enqueue_pos, __ATOMIC_RELAXED);
+    }
+
+    len = record->len < sizeof (slot->message) - 1 ?
+        record->len : sizeof (slot->message) - 1;
+
+    slot->level = record->level;
+    slot->svdrp = record->svdrp;
+    slot->time = record->time;
+    memcpy (slot->message, record->message, len);
+    slot->message[len] = '\0';
+    slot->len = len;
+
+    __atomic_store_n (&slot->seq, pos + 1, __ATOMIC_SEQ_CST);
+
+    /* the lock is only taken when the thread has nothing left to do */
+    if (__atomic_load_n (&ring->sleeping, __ATOMIC_SEQ_CST))
+        log_ring_wakeup (ring);
+}
+
+unsigned long svdrp_log_ring_dropped (svdrp_log_ring_t *ring)
+{
+    return ring ? __atomic_load_n (&ring->dropped, __ATOMIC_RELAXED) : 0;
+}
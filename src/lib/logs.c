@@ -24,9 +24,11 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "svdrp.h"
 #include "svdrp_internals.h"
+#include "logs.h"
 
 #ifdef USE_LOGCOLOR
 #define NORMAL   "\033[0m"
@@ -39,28 +41,11 @@
 #define B_RED    COLOR(41)
 #endif /* USE_LOGCOLOR */
 
-static int
-svdrp_log_test (svdrp_t *svdrp, svdrp_verbosity_level_t level)
-{
-    int verbosity;
-
-    if (!svdrp)
-        return 0;
-
-    verbosity = svdrp->verbosity;
-
-    /* do we really want logging ? */
-    if (verbosity == SVDRP_MSG_NONE)
-        return 0;
-
-    if (level < verbosity)
-        return 0;
-
-    return 1;
-}
+/* longer messages are truncated */
+#define SVDRP_LOG_MESSAGE_SIZE 1024
 
 void
-svdrp_log (svdrp_t *svdrp, svdrp_verbosity_level_t level, const char *format, ...)
+svdrp_log_stderr (void *data, const svdrp_log_record_t *record)
 {
 #ifdef USE_LOGCOLOR
     static const char const *c[] = {
@@ -78,24 +63,62 @@ svdrp_log (svdrp_t *svdrp, svdrp_verbosity_level_t level, const char *format, ..
         [SVDRP_MSG_ERROR]    = "Err",
         [SVDRP_MSG_CRITICAL] = "Crit",
     };
-    va_list va;
 
-    if (!svdrp || !format)
-        return;
+    (void) data;
 
-    if (!svdrp_log_test (svdrp, level))
+    if (!record || record->level <= SVDRP_MSG_NONE
+        || record->level > SVDRP_MSG_CRITICAL)
         return;
 
-    va_start (va, format);
-
+    /* a single write, so that messages of several threads do not mix */
 #ifdef USE_LOGCOLOR
-    fprintf (stderr, "[" BOLD "libsvdrp" NORMAL "] %s%s" NORMAL ": ",
-        c[level], l[level]);
+    fprintf (stderr, "[" BOLD "libsvdrp" NORMAL "] %s%s" NORMAL ": %.*s\n",
+        c[record->level], l[record->level], (int) record->len, record->message);
 #else
-    fprintf (stderr, "[libsvdrp] %s: ", l[level]);
+    fprintf (stderr, "[libsvdrp] %s: %.*s\n",
+        l[record->level], (int) record->len, record->message);
 #endif /* USE_LOGCOLOR */
+}
 
-    vfprintf (stderr, format, va);
-    fprintf (stderr, "\n");
+void
+svdrp_set_log_sink (svdrp_t *svdrp, svdrp_log_sink_t sink, void *data)
+{
+    if (!svdrp)
+        return;
+
+    svdrp->log_sink = sink;
+    svdrp->log_data = data;
+}
+
+void
+svdrp_log_message (svdrp_t *svdrp, svdrp_verbosity_level_t level,
+                   const char *format, ...)
+{
+    char message[SVDRP_LOG_MESSAGE_SIZE];
+    svdrp_log_record_t record;
+    va_list va;
+    int len;
+
+    if (!svdrp || !format)
+        return;
+
+    va_start (va, format);
+    len = vsnprintf (message, sizeof (message), format, va);
     va_end (va);
+
+    if (len < 0)
+        return;
+    if (len >= (int) sizeof (message))
+        len = sizeof (message) - 1;
+
+    record.level = level;
+    record.svdrp = svdrp;
+    clock_gettime (CLOCK_REALTIME, &record.time);
+    record.message = message;
+    record.len = len;
+
+    if (svdrp->log_sink)
+        svdrp->log_sink (svdrp->log_data, &record);
+    else
+        svdrp_log_stderr (NULL, &record);
 }
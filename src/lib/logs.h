@@ -29,17 +29,62 @@
  */
 
 /**
- * \brief Log a message.
+ * \brief Lowest level of the messages built into the library.
+ *
+ * Messages of a lower level are compiled out, SVDRP_MSG_NONE compiles out
+ * all of them. It is set with the --with-log-min-level configure option.
+ */
+#ifndef SVDRP_LOG_MIN_LEVEL
+#define SVDRP_LOG_MIN_LEVEL SVDRP_MSG_VERBOSE
+#endif
+
+/**
+ * \brief Check whether a message would be logged.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] level        level of verbosity of the message
+ * \return                 1 if the message has to be logged, 0 otherwise
+ */
+static inline int
+svdrp_log_test (svdrp_t *svdrp, svdrp_verbosity_level_t level)
+{
+    if (SVDRP_LOG_MIN_LEVEL == SVDRP_MSG_NONE || level < SVDRP_LOG_MIN_LEVEL)
+        return 0;
+
+    /* do we really want logging ? */
+    if (!svdrp || svdrp->verbosity == SVDRP_MSG_NONE)
+        return 0;
+
+    return level >= svdrp->verbosity;
+}
+
+/**
+ * \brief Format and record a message, whatever its level.
  *
  * \param[in] svdrp        an SVDRP connection object
  * \param[in] level        level of verbosity of the message
  * \param[in] format       format string of the message (like printf)
  * \param[in] ...          items of the format string
+ */
+void svdrp_log_message (svdrp_t *svdrp, svdrp_verbosity_level_t level,
+                        const char *format, ...);
+
+/**
+ * \brief Log a message.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] level        level of verbosity of the message
+ * \param[in] ...          format string of the message (like printf) and
+ *                         its items
  *
  * Records a message in the log. If the log verbosity level is higher than the
- * message level the message will not be displayed.
+ * message level the message will not be displayed. The level is checked
+ * before the items are evaluated, so a discarded message costs nothing.
  */
-void svdrp_log (svdrp_t *svdrp, svdrp_verbosity_level_t level,
-           const char *format, ...);
+#define svdrp_log(svdrp, level, ...)                            \
+    do {                                                        \
+        if (svdrp_log_test (svdrp, level))                      \
+            svdrp_log_message (svdrp, level, __VA_ARGS__);      \
+    } while (0)
 
 #endif /* SVDRP_LOGS_H */
@@ -0,0 +1,284 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "svdrp.h"
+#include "svdrp_internals.h"
+#include "commands.h"
+
+#define LATENCY_SUB (1 << SVDRP_LATENCY_SUB_BITS)
+
+/* the public array has to match the table of the verbs */
+typedef char metrics_verbs_check[SVDRP_METRICS_VERBS == SVDRP_VERB_COUNT ? 1 : -1];
+
+static int latency_bucket (long long us)
+{
+    int msb, index;
+
+    if (us < LATENCY_SUB)
+        return us > 0 ? us : 0;
+
+    msb = 63 - __builtin_clzll (us);
+    index = (msb - SVDRP_LATENCY_SUB_BITS + 1) * LATENCY_SUB
+        + ((us >> (msb - SVDRP_LATENCY_SUB_BITS)) & (LATENCY_SUB - 1));
+
+    return index < SVDRP_LATENCY_BUCKETS ? index : SVDRP_LATENCY_BUCKETS - 1;
+}
+
+unsigned long long svdrp_latency_bucket_bound (int index)
+{
+    int shift, sub;
+
+    if (index < 0)
+        return 0;
+    if (index < LATENCY_SUB)
+        return index;
+    if (index >= SVDRP_LATENCY_BUCKETS)
+        index = SVDRP_LATENCY_BUCKETS - 1;
+
+    shift = index / LATENCY_SUB - 1;
+    sub = index % LATENCY_SUB;
+
+    return ((unsigned long long) (LATENCY_SUB + sub + 1) << shift) - 1;
+}
+
+void svdrp_metrics_init (svdrp_metrics_t *metrics)
+{
+    int i;
+
+    memset (metrics, 0, sizeof (svdrp_metrics_t));
+    for (i = 0; i < SVDRP_VERB_COUNT; i++)
+        metrics->verbs[i].verb = svdrp_verbs[i].name;
+}
+
+void svdrp_metrics_record (svdrp_t *svdrp, int verb, int code,
+                           long long latency,
+                           unsigned long long bytes_in,
+                           unsigned long long bytes_out)
+{
+    svdrp_verb_metrics_t *m = &svdrp->metrics.verbs[verb];
+
+    m->count++;
+    m->bytes_in += bytes_in;
+    m->bytes_out += bytes_out;
+
+    if (code == SVDRP_ERROR) {
+        m->errors++;
+        return;
+    }
+
+    if (code >= 400)
+        m->rejected++;
+
+    m->latency_sum += latency;
+    m->latency[latency_bucket (latency)]++;
+}
+
+void svdrp_metrics_connected (svdrp_t *svdrp)
+{
+    if (svdrp->metrics.connects++)
+        svdrp->metrics.reconnects++;
+}
+
+int svdrp_get_metrics (svdrp_t *svdrp, svdrp_metrics_t *metrics)
+{
+    if (!svdrp || !metrics)
+        return SVDRP_ERROR;
+
+    memcpy (metrics, &svdrp->metrics, sizeof (svdrp_metrics_t));
+
+    return SVDRP_OK;
+}
+
+void svdrp_reset_metrics (svdrp_t *svdrp)
+{
+    if (svdrp)
+        svdrp_metrics_init (&svdrp->metrics);
+}
+
+unsigned long long svdrp_latency_quantile (const svdrp_verb_metrics_t *metrics,
+                                           double quantile)
+{
+    unsigned long total = 0, rank, seen = 0;
+    int i;
+
+    if (!metrics)
+        return 0;
+
+    for (i = 0; i < SVDRP_LATENCY_BUCKETS; i++)
+        total += metrics->latency[i];
+    if (!total)
+        return 0;
+
+    if (quantile < 0)
+        quantile = 0;
+    rank = quantile * total;
+    if (rank >= total)
+        rank = total - 1;
+
+    for (i = 0; i < SVDRP_LATENCY_BUCKETS; i++) {
+        seen += metrics->latency[i];
+        if (seen > rank)
+            break;
+    }
+
+    return svdrp_latency_bucket_bound (i);
+}
+
+/* a counter of the connections */
+static void prometheus_counter (FILE *out, const char *name, const char *help,
+                                const svdrp_metrics_t *metrics,
+                                const char *const *hosts, int count,
+                                size_t offset)
+{
+    int i;
+
+    fprintf (out, "# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+    for (i = 0; i < count; i++)
+        fprintf (out, "%s{host=\"%s\"} %lu\n", name, hosts[i] ? hosts[i] : "",
+                 *(const unsigned long *) ((const char *) &metrics[i] + offset));
+}
+
+/* a counter of the verbs */
+static void prometheus_verb_counter (FILE *out, const char *name,
+                                     const char *help,
+                                     const svdrp_metrics_t *metrics,
+                                     const char *const *hosts, int count,
+                                     size_t offset, int wide)
+{
+    int i, j;
+
+    fprintf (out, "# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+    for (i = 0; i < count; i++)
+        for (j = 0; j < SVDRP_METRICS_VERBS; j++) {
+            const svdrp_verb_metrics_t *m = &metrics[i].verbs[j];
+            const char *field = (const char *) m + offset;
+
+            if (!m->count)
+                continue;
+
+            fprintf (out, "%s{host=\"%s\",verb=\"%s\"} %llu\n", name,
+                     hosts[i] ? hosts[i] : "", m->verb,
+                     wide ? *(const unsigned long long *) field
+                     : (unsigned long long) *(const unsigned long *) field);
+        }
+}
+
+int svdrp_metrics_dump_prometheus (const svdrp_metrics_t *metrics,
+                                   const char *const *hosts, int count,
+                                   FILE *out)
+{
+    static const char name[] = "svdrp_command_duration_seconds";
+    int i, j, k;
+
+    if (!metrics || !hosts || count < 0 || !out)
+        return SVDRP_ERROR;
+
+    prometheus_counter (out, "svdrp_connects_total",
+                        "Connections established.", metrics, hosts, count,
+                        offsetof (svdrp_metrics_t, connects));
+    prometheus_counter (out, "svdrp_reconnects_total",
+                        "Connections established again.", metrics, hosts, count,
+                        offsetof (svdrp_metrics_t, reconnects));
+    prometheus_counter (out, "svdrp_server_closes_total",
+                        "Connections closed by VDR.", metrics, hosts, count,
+                        offsetof (svdrp_metrics_t, server_closes));
+    prometheus_counter (out, "svdrp_retries_total",
+                        "Commands sent again.", metrics, hosts, count,
+                        offsetof (svdrp_metrics_t, retries));
+    prometheus_counter (out, "svdrp_timeouts_total",
+                        "Operations which timed out.", metrics, hosts, count,
+                        offsetof (svdrp_metrics_t, timeouts));
+    prometheus_counter (out, "svdrp_cache_hits_total",
+                        "Replies served by the cache.", metrics, hosts, count,
+                        offsetof (svdrp_metrics_t, cache_hits));
+    prometheus_counter (out, "svdrp_cache_misses_total",
+                        "Cacheable commands sent to VDR.", metrics, hosts, count,
+                        offsetof (svdrp_metrics_t, cache_misses));
+    prometheus_counter (out, "svdrp_cache_invalidations_total",
+                        "Cached replies dropped by a mutating command.",
+                        metrics, hosts, count,
+                        offsetof (svdrp_metrics_t, cache_invalidations));
+    prometheus_counter (out, "svdrp_keepalives_total",
+                        "No-ops sent on an idle connection.",
+                        metrics, hosts, count,
+                        offsetof (svdrp_metrics_t, keepalives));
+    prometheus_counter (out, "svdrp_breaker_trips_total",
+                        "Times the circuit breaker opened.",
+                        metrics, hosts, count,
+                        offsetof (svdrp_metrics_t, breaker_trips));
+    prometheus_counter (out, "svdrp_breaker_rejects_total",
+                        "Connections refused by the circuit breaker.",
+                        metrics, hosts, count,
+                        offsetof (svdrp_metrics_t, breaker_rejects));
+
+    prometheus_verb_counter (out, "svdrp_commands_total", "Commands sent.",
+                             metrics, hosts, count,
+                             offsetof (svdrp_verb_metrics_t, count), 0);
+    prometheus_verb_counter (out, "svdrp_command_errors_total",
+                             "Commands without a reply.", metrics, hosts, count,
+                             offsetof (svdrp_verb_metrics_t, errors), 0);
+    prometheus_verb_counter (out, "svdrp_command_rejected_total",
+                             "Commands answered with an error code.",
+                             metrics, hosts, count,
+                             offsetof (svdrp_verb_metrics_t, rejected), 0);
+    prometheus_verb_counter (out, "svdrp_received_bytes_total",
+                             "Bytes of the replies.", metrics, hosts, count,
+                             offsetof (svdrp_verb_metrics_t, bytes_in), 1);
+    prometheus_verb_counter (out, "svdrp_sent_bytes_total",
+                             "Bytes of the commands.", metrics, hosts, count,
+                             offsetof (svdrp_verb_metrics_t, bytes_out), 1);
+
+    fprintf (out, "# HELP %s Latency of the commands.\n# TYPE %s histogram\n",
+             name, name);
+    for (i = 0; i < count; i++) {
+        const char *host = hosts[i] ? hosts[i] : "";
+
+        for (j = 0; j < SVDRP_METRICS_VERBS; j++) {
+            const svdrp_verb_metrics_t *m = &metrics[i].verbs[j];
+            unsigned long total = 0;
+
+            if (!m->count)
+                continue;
+
+            /* empty buckets add nothing to the cumulative counts */
+            for (k = 0; k < SVDRP_LATENCY_BUCKETS; k++) {
+                if (!m->latency[k])
+                    continue;
+                total += m->latency[k];
+                fprintf (out, "%s_bucket{host=\"%s\",verb=\"%s\",le=\"%g\"} %lu\n",
+                         name, host, m->verb,
+                         (svdrp_latency_bucket_bound (k) + 1) / 1e6, total);
+            }
+
+            fprintf (out, "%s_bucket{host=\"%s\",verb=\"%s\",le=\"+Inf\"} %lu\n",
+                     name, host, m->verb, total);
+            fprintf (out, "%s_sum{host=\"%s\",verb=\"%s\"} %g\n",
+                     name, host, m->verb, m->latency_sum / 1e6);
+            fprintf (out, "%s_count{host=\"%s\",verb=\"%s\"} %lu\n",
+                     name, host, m->verb, total);
+        }
+    }
+
+    return ferror (out) ? SVDRP_ERROR : SVDRP_OK;
+}
@@ -0,0 +1,343 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "svdrp.h"
+#include "svdrp_internals.h"
+#include "logs.h"
+
+typedef struct multi_host_s {
+    svdrp_t *svdrp;
+    int fd;                       /* descriptor registered with epoll */
+    int events;                   /* events registered with epoll */
+    int pending;                  /* commands waiting for their reply */
+    int code;                     /* reply code of the last command */
+} multi_host_t;
+
+/* one command sent to one host */
+typedef struct multi_req_s {
+    svdrp_multi_t *multi;
+    int index;
+    svdrp_multi_cb_t cb;
+    void *data;
+} multi_req_t;
+
+struct svdrp_multi_s {
+    int epfd;
+    int timeout;
+    svdrp_verbosity_level_t verbosity;
+    multi_host_t *hosts;
+    int count;
+    int size;
+};
+
+svdrp_multi_t *svdrp_multi_new (int timeout, svdrp_verbosity_level_t verbosity)
+{
+    svdrp_multi_t *multi;
+
+    multi = calloc (1, sizeof (svdrp_multi_t));
+    if (!multi)
+        return NULL;
+
+    multi->epfd = epoll_create (16);
+    if (multi->epfd < 0) {
+        free (multi);
+        return NULL;
+    }
+
+    multi->timeout = timeout ? timeout : SVDRP_DEFAULT_TIMEOUT;
+    multi->verbosity = verbosity;
+
+    return multi;
+}
+
+void svdrp_multi_free (svdrp_multi_t *multi)
+{
+    int i;
+
+    if (!multi)
+        return;
+
+    for (i = 0; i < multi->count; i++)
+        svdrp_close (multi->hosts[i].svdrp);
+
+    close (multi->epfd);
+    free (multi->hosts);
+    free (multi);
+}
+
+/*
+ * A descriptor leaves the set before it is closed: its number may be
+ * handed to another host reconnecting within the same loop.
+ */
+static void multi_fd_close (void *data, svdrp_t *svdrp, int fd)
+{
+    svdrp_multi_t *multi = data;
+    int i;
+
+    for (i = 0; i < multi->count; i++) {
+        multi_host_t *h = &multi->hosts[i];
+
+        if (h->svdrp == svdrp && h->fd == fd) {
+            epoll_ctl (multi->epfd, EPOLL_CTL_DEL, fd, NULL);
+            h->fd = -1;
+            h->events = 0;
+            return;
+        }
+    }
+}
+
+int svdrp_multi_add_host (svdrp_multi_t *multi, char *host, int port)
+{
+    multi_host_t *h;
+
+    if (!multi || !host)
+        return -1;
+
+    if (multi->count == multi->size) {
+        int size = multi->size ? 2 * multi->size : 8;
+        multi_host_t *hosts;
+
+        hosts = realloc (multi->hosts, size * sizeof (multi_host_t));
+        if (!hosts)
+            return -1;
+
+        multi->hosts = hosts;
+        multi->size = size;
+    }
+
+    h = &multi->hosts[multi->count];
+    memset (h, 0, sizeof (multi_host_t));
+    h->fd = -1;
+    h->code = SVDRP_ERROR;
+
+    /* every host starts connecting right away */
+    h->svdrp = svdrp_open_async (host, port, multi->timeout, multi->verbosity);
+    if (!h->svdrp)
+        return -1;
+
+    h->svdrp->fd_close_cb = multi_fd_close;
+    h->svdrp->fd_close_data = multi;
+
+    return multi->count++;
+}
+
+int svdrp_multi_count (svdrp_multi_t *multi)
+{
+    return multi ? multi->count : 0;
+}
+
+svdrp_t *svdrp_multi_get (svdrp_multi_t *multi, int index)
+{
+    if (!multi || index < 0 || index >= multi->count)
+        return NULL;
+
+    return multi->hosts[index].svdrp;
+}
+
+int svdrp_multi_status (svdrp_multi_t *multi, int index)
+{
+    if (!multi || index < 0 || index >= multi->count)
+        return SVDRP_ERROR;
+
+    return multi->hosts[index].code;
+}
+
+static void multi_line_cb (void *data, int code,
+                           const char *line, size_t len, int last)
+{
+    multi_req_t *req = data;
+
+    if (req->cb)
+        req->cb (req->data, req->index, code, line, len, last);
+}
+
+static void multi_done_cb (void *data, int code)
+{
+    multi_req_t *req = data;
+    multi_host_t *h = &req->multi->hosts[req->index];
+
+    h->code = code;
+    h->pending--;
+    free (req);
+}
+
+int svdrp_multi_command (svdrp_multi_t *multi, const char *cmd,
+                         svdrp_multi_cb_t cb, void *data)
+{
+    int i, ret = SVDRP_OK;
+
+    if (!multi || !cmd)
+        return SVDRP_ERROR;
+
+    for (i = 0; i < multi->count; i++) {
+        multi_host_t *h = &multi->hosts[i];
+        multi_req_t *req;
+
+        req = malloc (sizeof (multi_req_t));
+        if (!req) {
+            h->code = SVDRP_ERROR;
+            ret = SVDRP_ERROR;
+            continue;
+        }
+
+        req->multi = multi;
+        req->index = i;
+        req->cb = cb;
+        req->data = data;
+
+        h->pending++;
+        if (svdrp_command_async (h->svdrp, cmd, multi_line_cb,
+                                 multi_done_cb, req) != SVDRP_OK) {
+            /* host unreachable, e.g. unknown host name */
+            h->pending--;
+            h->code = SVDRP_ERROR;
+            free (req);
+            ret = SVDRP_ERROR;
+        }
+    }
+
+    return ret;
+}
+
+/* keep the epoll set in line with the descriptor and events of a host */
+static void multi_sync_host (svdrp_multi_t *multi, int index)
+{
+    multi_host_t *h = &multi->hosts[index];
+    struct epoll_event ev;
+    int fd, events;
+
+    fd = h->pending ? svdrp_get_fd (h->svdrp) : -1;
+    events = fd >= 0 ? svdrp_get_io_events (h->svdrp) : 0;
+
+    if (fd == h->fd && events == h->events)
+        return;
+
+    memset (&ev, 0, sizeof (ev));
+    ev.data.u32 = index;
+    ev.events = ((events & SVDRP_IO_READ) ? EPOLLIN : 0)
+        | ((events & SVDRP_IO_WRITE) ? EPOLLOUT : 0);
+
+    /* a descriptor still open, but no longer waited for */
+    if (h->fd >= 0 && fd != h->fd)
+        epoll_ctl (multi->epfd, EPOLL_CTL_DEL, h->fd, NULL);
+
+    /* closed descriptors have left the set through multi_fd_close() */
+    if (fd >= 0)
+        epoll_ctl (multi->epfd, fd == h->fd ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                   fd, &ev);
+
+    h->fd = fd;
+    h->events = events;
+}
+
+int svdrp_multi_run (svdrp_multi_t *multi, int timeout_ms)
+{
+    struct epoll_event events[64];
+    long long deadline;
+    int i, n, pending;
+
+    if (!multi)
+        return SVDRP_ERROR;
+
+    if (timeout_ms <= 0)
+        timeout_ms = multi->timeout * 1000;
+    deadline = monotonic_ms () + timeout_ms;
+
+    for (;;) {
+        long long left;
+
+        pending = 0;
+        for (i = 0; i < multi->count; i++) {
+            multi_sync_host (multi, i);
+            pending += multi->hosts[i].pending;
+        }
+
+        if (!pending) {
+            for (i = 0; i < multi->count; i++)
+                if (multi->hosts[i].code == SVDRP_ERROR)
+                    return SVDRP_ERROR;
+            return SVDRP_OK;
+        }
+
+        left = deadline - monotonic_ms ();
+        if (left <= 0)
+            break;
+
+        /* wake up in time for the earliest expiring host */
+        for (i = 0; i < multi->count; i++) {
+            multi_host_t *h = &multi->hosts[i];
+            int timeout;
+
+            if (!h->pending)
+                continue;
+
+            timeout = svdrp_get_io_timeout (h->svdrp);
+            if (timeout == 0) {
+                svdrp_process_io (h->svdrp, 0);
+                left = 0;
+            }
+            else if (timeout > 0 && timeout < left)
+                left = timeout;
+        }
+
+        if (!left)
+            continue;
+
+        n = epoll_wait (multi->epfd, events, 64, left);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (i = 0; i < n; i++) {
+            multi_host_t *h = &multi->hosts[events[i].data.u32];
+            int io = 0;
+
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                io |= SVDRP_IO_READ;
+            if (events[i].events & (EPOLLOUT | EPOLLERR))
+                io |= SVDRP_IO_WRITE;
+
+            svdrp_process_io (h->svdrp, io);
+        }
+    }
+
+    /* give up on the slow hosts, their commands complete with an error */
+    for (i = 0; i < multi->count; i++) {
+        multi_host_t *h = &multi->hosts[i];
+
+        if (!h->pending)
+            continue;
+
+        svdrp_log (h->svdrp, SVDRP_MSG_WARNING, "Timeout, closing connection");
+        svdrp_close_conn (h->svdrp);
+        multi_sync_host (multi, i);
+    }
+
+    return SVDRP_ERROR;
+}
@@ -0,0 +1,245 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "svdrp.h"
+#include "svdrp_internals.h"
+#include "logs.h"
+#include "commands.h"
+
+typedef struct pipeline_cmd_s {
+    size_t offset;                /* command position in the pipeline pool */
+    size_t len;                   /* command length, newline included */
+    svdrp_reply_cb_t cb;
+    void *data;
+    int verb;
+    int code;
+} pipeline_cmd_t;
+
+struct svdrp_pipeline_s {
+    svdrp_t *svdrp;
+    strbuf_t cmds;                /* all the commands, ready to be sent */
+    pipeline_cmd_t *entries;
+    int count;
+    int size;
+};
+
+svdrp_pipeline_t *svdrp_pipeline_new (svdrp_t *svdrp)
+{
+    svdrp_pipeline_t *pipeline;
+
+    if (!svdrp)
+        return NULL;
+
+    pipeline = calloc (1, sizeof (svdrp_pipeline_t));
+    if (!pipeline)
+        return NULL;
+
+    pipeline->svdrp = svdrp;
+
+    return pipeline;
+}
+
+void svdrp_pipeline_free (svdrp_pipeline_t *pipeline)
+{
+    if (!pipeline)
+        return;
+
+    strbuf_free (&pipeline->cmds);
+    free (pipeline->entries);
+    free (pipeline);
+}
+
+int svdrp_pipeline_add (svdrp_pipeline_t *pipeline, const char *cmd,
+                        svdrp_reply_cb_t cb, void *data)
+{
+    pipeline_cmd_t *entry;
+    size_t len;
+
+    if (!pipeline || !cmd)
+        return SVDRP_ERROR;
+
+    if (pipeline->count == pipeline->size) {
+        int size = pipeline->size ? 2 * pipeline->size : 8;
+        pipeline_cmd_t *entries;
+
+        entries = realloc (pipeline->entries, size * sizeof (pipeline_cmd_t));
+        if (!entries)
+            return SVDRP_ERROR;
+
+        pipeline->entries = entries;
+        pipeline->size = size;
+    }
+
+    entry = &pipeline->entries[pipeline->count];
+    entry->offset = pipeline->cmds.len;
+    entry->cb = cb;
+    entry->data = data;
+    entry->code = SVDRP_ERROR;
+
+    len = command_len (cmd);
+    if (strbuf_append (&pipeline->cmds, cmd, len) < 0
+        || strbuf_append (&pipeline->cmds, "\n", 1) < 0) {
+        pipeline->cmds.len = entry->offset;
+        return SVDRP_ERROR;
+    }
+
+    entry->len = len + 1;
+    entry->verb = svdrp_verb_lookup (cmd, len);
+    pipeline->count++;
+
+    return SVDRP_OK;
+}
+
+/* account for the commands left without a reply */
+static void pipeline_record (svdrp_pipeline_t *pipeline, int first,
+                             long long start)
+{
+    int i;
+
+    for (i = first; i < pipeline->count; i++)
+        svdrp_metrics_record (pipeline->svdrp, pipeline->entries[i].verb,
+                              SVDRP_ERROR, monotonic_us () - start,
+                              0, pipeline->entries[i].len);
+}
+
+static int pipeline_run (svdrp_pipeline_t *pipeline)
+{
+    svdrp_t *svdrp = pipeline->svdrp;
+    struct iovec iov;
+    long long start;
+    int i, tries;
+
+    /* VDR having dropped an idle connection is noticed before sending */
+    if (svdrp->is_connected && !svdrp->replay && !svdrp_conn_alive (svdrp)) {
+        svdrp_log (svdrp, SVDRP_MSG_INFO, "Connection closed while idle, reconnecting");
+        svdrp_close_conn (svdrp);
+    }
+
+    if (!svdrp_try_connect (svdrp))
+        return SVDRP_ERROR;
+
+    svdrp_log (svdrp, SVDRP_MSG_INFO, "Sending %i pipelined commands",
+               pipeline->count);
+    for (i = 0; i < pipeline->count; i++) {
+        svdrp_log (svdrp, SVDRP_MSG_VERBOSE, "Pipelined command: '%.*s'",
+                   (int) pipeline->entries[i].len - 1,
+                   pipeline->cmds.data + pipeline->entries[i].offset);
+        svdrp_cache_invalidate (svdrp, pipeline->entries[i].verb);
+    }
+
+    for (tries = 1; ; tries++) {
+        /* every command goes out at once, VDR will answer them in order */
+        iov.iov_base = pipeline->cmds.data;
+        iov.iov_len = pipeline->cmds.len;
+        start = monotonic_us ();
+        if (svdrp_writev (svdrp, &iov, 1) < 0) {
+            svdrp_log (svdrp, SVDRP_MSG_WARNING, "Write failed");
+            svdrp_close_conn (svdrp);
+            pipeline_record (pipeline, 0, start);
+            return SVDRP_ERROR;
+        }
+
+        for (i = 0; i < pipeline->count; i++) {
+            pipeline_cmd_t *entry = &pipeline->entries[i];
+            unsigned long long bytes_in = svdrp->rbuf.consumed;
+
+            svdrp->verb = entry->verb;
+            entry->code = svdrp_read_reply_lines (svdrp, entry->cb, entry->data);
+
+            /* VDR closed the connection before reading any of the commands */
+            if (!i && tries == 1 && entry->code == SVDRP_REPLY_QUIT
+                && entry->verb != SVDRP_VERB_QUIT)
+                break;
+
+            svdrp_metrics_record (svdrp, entry->verb, entry->code,
+                                  monotonic_us () - start,
+                                  svdrp->rbuf.consumed - bytes_in, entry->len);
+
+            /* the remaining replies are lost along with the connection */
+            if (entry->code == SVDRP_ERROR || entry->code == SVDRP_REPLY_QUIT) {
+                pipeline_record (pipeline, i + 1, start);
+                return SVDRP_ERROR;
+            }
+        }
+
+        if (i == pipeline->count)
+            return SVDRP_OK;
+
+        svdrp_log (svdrp, SVDRP_MSG_INFO, "Connection closed by vdr, sending the pipeline again");
+        svdrp_set_error (svdrp, SVDRP_ERR_NONE);
+        svdrp->metrics.retries++;
+        if (!svdrp_try_connect (svdrp)) {
+            pipeline_record (pipeline, 0, start);
+            return SVDRP_ERROR;
+        }
+    }
+}
+
+int svdrp_pipeline_run (svdrp_pipeline_t *pipeline)
+{
+    svdrp_t *svdrp;
+    int i, ret;
+
+    if (!pipeline)
+        return SVDRP_ERROR;
+
+    svdrp = pipeline->svdrp;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (!pipeline->count)
+        return SVDRP_OK;
+
+    if (svdrp->async) {
+        svdrp_log (svdrp, SVDRP_MSG_ERROR, "Blocking command on a non-blocking connection");
+        return SVDRP_ERROR;
+    }
+
+    for (i = 0; i < pipeline->count; i++)
+        pipeline->entries[i].code = SVDRP_ERROR;
+
+    /* the pipeline as a whole is bounded by the timeout */
+    svdrp_set_error (svdrp, SVDRP_ERR_NONE);
+    svdrp->deadline = monotonic_ms () + svdrp->timeout * 1000LL;
+
+    ret = pipeline_run (pipeline);
+
+    svdrp->deadline = 0;
+    svdrp->verb = SVDRP_VERB_OTHER;
+
+    return ret;
+}
+
+int svdrp_pipeline_count (svdrp_pipeline_t *pipeline)
+{
+    return pipeline ? pipeline->count : 0;
+}
+
+int svdrp_pipeline_status (svdrp_pipeline_t *pipeline, int index)
+{
+    if (!pipeline || index < 0 || index >= pipeline->count)
+        return SVDRP_ERROR;
+
+    return pipeline->entries[index].code;
+}
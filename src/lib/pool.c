@@ -0,0 +1,457 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "svdrp.h"
+#include "svdrp_internals.h"
+#include "logs.h"
+
+typedef struct pool_conn_s {
+    struct pool_conn_s *next;
+    svdrp_t *svdrp;               /* NULL while connecting */
+    char *host;
+    int port;
+    int leased;
+    long long idle_since;         /* when it was returned, in ms */
+} pool_conn_t;
+
+/* the circuit breaker of a host, outliving its connections */
+typedef struct pool_host_s {
+    struct pool_host_s *next;
+    char *host;
+    int port;
+    int failures;                 /* failed connections in a row */
+    long long until;              /* end of the open state, in ms, 0 if closed */
+} pool_host_t;
+
+struct svdrp_pool_s {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;          /* a connection was returned */
+    pool_conn_t *conns;
+    pool_host_t *hosts;
+    svdrp_retry_policy_t retry;   /* of the connections handed out */
+    int timeout;
+    int idle_timeout;             /* in s */
+    int max_per_host;
+    svdrp_verbosity_level_t verbosity;
+};
+
+svdrp_pool_t *svdrp_pool_new (int timeout, svdrp_verbosity_level_t verbosity)
+{
+    svdrp_pool_t *pool;
+
+    pool = calloc (1, sizeof (svdrp_pool_t));
+    if (!pool)
+        return NULL;
+
+    if (pthread_mutex_init (&pool->lock, NULL)) {
+        free (pool);
+        return NULL;
+    }
+    if (pthread_cond_init (&pool->cond, NULL)) {
+        pthread_mutex_destroy (&pool->lock);
+        free (pool);
+        return NULL;
+    }
+
+    pool->timeout = timeout ? timeout : SVDRP_DEFAULT_TIMEOUT;
+    pool->idle_timeout = SVDRP_POOL_DEFAULT_IDLE_TIMEOUT;
+    pool->max_per_host = 1;
+    pool->verbosity = verbosity;
+    svdrp_retry_policy_default (&pool->retry);
+
+    return pool;
+}
+
+void svdrp_pool_free (svdrp_pool_t *pool)
+{
+    pool_conn_t *conn, *next;
+    pool_host_t *h, *h_next;
+
+    if (!pool)
+        return;
+
+    for (conn = pool->conns; conn; conn = next) {
+        next = conn->next;
+        svdrp_close (conn->svdrp);
+        free (conn->host);
+        free (conn);
+    }
+
+    for (h = pool->hosts; h; h = h_next) {
+        h_next = h->next;
+        free (h->host);
+        free (h);
+    }
+
+    pthread_cond_destroy (&pool->cond);
+    pthread_mutex_destroy (&pool->lock);
+    free (pool);
+}
+
+void svdrp_pool_set_idle_timeout (svdrp_pool_t *pool, int idle_timeout)
+{
+    if (!pool)
+        return;
+
+    pthread_mutex_lock (&pool->lock);
+    pool->idle_timeout = idle_timeout > 0 ? idle_timeout : 0;
+    pthread_mutex_unlock (&pool->lock);
+}
+
+void svdrp_pool_set_max_per_host (svdrp_pool_t *pool, int max)
+{
+    if (!pool)
+        return;
+
+    pthread_mutex_lock (&pool->lock);
+    pool->max_per_host = max > 0 ? max : 1;
+    pthread_cond_broadcast (&pool->cond);
+    pthread_mutex_unlock (&pool->lock);
+}
+
+int svdrp_pool_set_retry_policy (svdrp_pool_t *pool,
+                                 const svdrp_retry_policy_t *policy)
+{
+    pool_host_t *h;
+
+    if (!pool || (policy && !svdrp_retry_policy_valid (policy)))
+        return SVDRP_ERROR;
+
+    pthread_mutex_lock (&pool->lock);
+    if (policy)
+        pool->retry = *policy;
+    else
+        svdrp_retry_policy_default (&pool->retry);
+
+    for (h = pool->hosts; h; h = h->next) {
+        h->failures = 0;
+        h->until = 0;
+    }
+    pthread_mutex_unlock (&pool->lock);
+
+    return SVDRP_OK;
+}
+
+static int pool_match (pool_conn_t *conn, const char *host, int port)
+{
+    return conn->port == port && !strcmp (conn->host, host);
+}
+
+static int pool_expired (svdrp_pool_t *pool, pool_conn_t *conn, long long now)
+{
+    return pool->idle_timeout
+        && now - conn->idle_since >= pool->idle_timeout * 1000LL;
+}
+
+static void pool_unlink (svdrp_pool_t *pool, pool_conn_t *conn)
+{
+    pool_conn_t **prev;
+
+    for (prev = &pool->conns; *prev; prev = &(*prev)->next)
+        if (*prev == conn) {
+            *prev = conn->next;
+            return;
+        }
+}
+
+/* the breaker record of a host, created on first use; under the lock */
+static pool_host_t *pool_host (svdrp_pool_t *pool, const char *host, int port)
+{
+    pool_host_t *h;
+
+    for (h = pool->hosts; h; h = h->next)
+        if (h->port == port && !strcmp (h->host, host))
+            return h;
+
+    h = calloc (1, sizeof (pool_host_t));
+    if (!h || !(h->host = strdup (host))) {
+        free (h);
+        return NULL;
+    }
+    h->port = port;
+    h->next = pool->hosts;
+    pool->hosts = h;
+
+    return h;
+}
+
+/* whether a connection to the host may be attempted; under the lock */
+static int pool_breaker_allow (svdrp_pool_t *pool, pool_host_t *h)
+{
+    if (!h->until)
+        return 1;
+
+    /* half-open: let a single connection through */
+    if (monotonic_ms () >= h->until) {
+        h->until = 0;
+        h->failures = pool->retry.breaker_threshold - 1;
+        return 1;
+    }
+
+    return 0;
+}
+
+static void pool_breaker_record (svdrp_pool_t *pool, pool_host_t *h,
+                                 svdrp_t *svdrp, int connected)
+{
+    int failures = 0, cooldown = 0;
+
+    pthread_mutex_lock (&pool->lock);
+    if (connected)
+        h->failures = 0;
+    else if (pool->retry.breaker_threshold
+             && ++h->failures >= pool->retry.breaker_threshold) {
+        failures = h->failures;
+        cooldown = pool->retry.breaker_cooldown;
+        h->until = monotonic_ms () + cooldown;
+        if (!h->until)
+            h->until = 1;
+    }
+    pthread_mutex_unlock (&pool->lock);
+
+    if (failures)
+        svdrp_log (svdrp, SVDRP_MSG_WARNING,
+                   "%i connections to %s failed, failing fast for %i ms",
+                   failures, h->host, cooldown);
+}
+
+/* an idle connection of the host, a free slot, or NULL to wait */
+static pool_conn_t *pool_take (svdrp_pool_t *pool, const char *host, int port,
+                               int *slot)
+{
+    pool_conn_t *conn, *found = NULL;
+    int count = 0;
+
+    for (conn = pool->conns; conn; conn = conn->next) {
+        if (!pool_match (conn, host, port))
+            continue;
+        count++;
+
+        /* the most recently returned one is the least likely to be stale */
+        if (!conn->leased && (!found || conn->idle_since > found->idle_since))
+            found = conn;
+    }
+
+    *slot = !found && count < pool->max_per_host;
+
+    return found;
+}
+
+svdrp_t *svdrp_pool_lease (svdrp_pool_t *pool, char *host, int port)
+{
+    svdrp_retry_policy_t retry;
+    pool_conn_t *conn;
+    pool_host_t *h;
+    struct timespec ts;
+    svdrp_t *svdrp;
+    int slot, stale = 0, allowed = 1;
+
+    if (!pool || !host)
+        return NULL;
+
+    if (!port)
+        port = SVDRP_DEFAULT_PORT;
+
+    /* VDR takes one client at a time, so a busy host is waited for */
+    clock_gettime (CLOCK_REALTIME, &ts);
+    ts.tv_sec += pool->timeout;
+
+    pthread_mutex_lock (&pool->lock);
+    h = pool_host (pool, host, port);
+    if (!h) {
+        pthread_mutex_unlock (&pool->lock);
+        return NULL;
+    }
+
+    while (!(conn = pool_take (pool, host, port, &slot)) && !slot)
+        if (pthread_cond_timedwait (&pool->cond, &pool->lock, &ts) == ETIMEDOUT) {
+            conn = pool_take (pool, host, port, &slot);
+            break;
+        }
+
+    if (conn) {
+        conn->leased = 1;
+        stale = pool_expired (pool, conn, monotonic_ms ());
+    }
+    /* a host known to be down is not tried again before the cooldown */
+    else if (slot)
+        allowed = pool_breaker_allow (pool, h);
+    retry = pool->retry;
+    pthread_mutex_unlock (&pool->lock);
+
+    if (!conn && (!slot || !allowed))
+        return NULL;
+
+    /* a warm connection, unless VDR is about to drop it or already did */
+    if (conn) {
+        svdrp = conn->svdrp;
+        if (stale || !svdrp_conn_alive (svdrp)) {
+            svdrp_log (svdrp, SVDRP_MSG_INFO, "Idle connection is stale, reconnecting");
+            if (svdrp->conn_open)
+                svdrp_close_conn (svdrp);
+        }
+        else {
+            svdrp_set_retry_policy (svdrp, &retry);
+            return svdrp;
+        }
+
+        pthread_mutex_lock (&pool->lock);
+        allowed = pool_breaker_allow (pool, h);
+        pthread_mutex_unlock (&pool->lock);
+
+        if (allowed) {
+            svdrp_set_retry_policy (svdrp, &retry);
+            if (svdrp_try_connect (svdrp)) {
+                pool_breaker_record (pool, h, svdrp, 1);
+                return svdrp;
+            }
+            pool_breaker_record (pool, h, svdrp, 0);
+        }
+
+        pthread_mutex_lock (&pool->lock);
+        pool_unlink (pool, conn);
+        pthread_cond_broadcast (&pool->cond);
+        pthread_mutex_unlock (&pool->lock);
+
+        svdrp_close (svdrp);
+        free (conn->host);
+        free (conn);
+        return NULL;
+    }
+
+    /* the slot is taken before connecting, outside of the lock */
+    conn = calloc (1, sizeof (pool_conn_t));
+    if (!conn || !(conn->host = strdup (host))) {
+        free (conn);
+        return NULL;
+    }
+    conn->port = port;
+    conn->leased = 1;
+
+    pthread_mutex_lock (&pool->lock);
+    conn->next = pool->conns;
+    pool->conns = conn;
+    pthread_mutex_unlock (&pool->lock);
+
+    svdrp = svdrp_open (host, port, pool->timeout, pool->verbosity);
+    if (svdrp)
+        svdrp_set_retry_policy (svdrp, &retry);
+    if (svdrp && svdrp->is_connected) {
+        pool_breaker_record (pool, h, svdrp, 1);
+        pthread_mutex_lock (&pool->lock);
+        conn->svdrp = svdrp;
+        pthread_mutex_unlock (&pool->lock);
+        return svdrp;
+    }
+
+    if (svdrp)
+        pool_breaker_record (pool, h, svdrp, 0);
+
+    pthread_mutex_lock (&pool->lock);
+    pool_unlink (pool, conn);
+    pthread_cond_broadcast (&pool->cond);
+    pthread_mutex_unlock (&pool->lock);
+
+    svdrp_close (svdrp);
+    free (conn->host);
+    free (conn);
+
+    return NULL;
+}
+
+void svdrp_pool_return (svdrp_pool_t *pool, svdrp_t *svdrp)
+{
+    pool_conn_t *conn;
+
+    if (!pool || !svdrp)
+        return;
+
+    pthread_mutex_lock (&pool->lock);
+    for (conn = pool->conns; conn; conn = conn->next)
+        if (conn->svdrp == svdrp && conn->leased) {
+            conn->leased = 0;
+            conn->idle_since = monotonic_ms ();
+            pthread_cond_broadcast (&pool->cond);
+            break;
+        }
+    pthread_mutex_unlock (&pool->lock);
+}
+
+int svdrp_pool_prune (svdrp_pool_t *pool)
+{
+    pool_conn_t *conn, *next, **prev, *pruned = NULL;
+    long long now = monotonic_ms ();
+    int count = 0;
+
+    if (!pool)
+        return 0;
+
+    pthread_mutex_lock (&pool->lock);
+    for (prev = &pool->conns; (conn = *prev); ) {
+        if (conn->leased
+            || (!pool_expired (pool, conn, now) && svdrp_conn_alive (conn->svdrp))) {
+            prev = &conn->next;
+            continue;
+        }
+
+        *prev = conn->next;
+        conn->next = pruned;
+        pruned = conn;
+        count++;
+    }
+    if (count)
+        pthread_cond_broadcast (&pool->cond);
+    pthread_mutex_unlock (&pool->lock);
+
+    /* VDR is free to serve another client from now on */
+    for (conn = pruned; conn; conn = next) {
+        next = conn->next;
+        svdrp_log (conn->svdrp, SVDRP_MSG_INFO, "Closing idle connection");
+        svdrp_close (conn->svdrp);
+        free (conn->host);
+        free (conn);
+    }
+
+    return count;
+}
+
+int svdrp_pool_idle (svdrp_pool_t *pool)
+{
+    pool_conn_t *conn;
+    int count = 0;
+
+    if (!pool)
+        return 0;
+
+    pthread_mutex_lock (&pool->lock);
+    for (conn = pool->conns; conn; conn = conn->next)
+        if (!conn->leased)
+            count++;
+    pthread_mutex_unlock (&pool->lock);
+
+    return count;
+}
@@ -0,0 +1,221 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "svdrp.h"
+#include "svdrp_internals.h"
+#include "logs.h"
+#include "commands.h"
+
+void svdrp_retry_policy_default (svdrp_retry_policy_t *policy)
+{
+    if (!policy)
+        return;
+
+    policy->max_tries = 4;
+    policy->base_delay = 50;
+    policy->max_delay = 2000;
+    policy->deadline = 0;
+    policy->retry_writes = 0;
+    policy->breaker_threshold = 5;
+    policy->breaker_cooldown = 10000;
+}
+
+void svdrp_retry_init (svdrp_t *svdrp)
+{
+    svdrp_retry_policy_default (&svdrp->retry);
+
+    /* handles created at the same time in several processes differ */
+    svdrp->rand_state = (unsigned long long) monotonic_us ()
+        ^ ((unsigned long long) getpid () << 32)
+        ^ (unsigned long long) (uintptr_t) svdrp;
+    if (!svdrp->rand_state)
+        svdrp->rand_state = 1;
+}
+
+int svdrp_retry_policy_valid (const svdrp_retry_policy_t *policy)
+{
+    return policy->max_tries >= 1 && policy->base_delay >= 0
+        && policy->max_delay >= policy->base_delay && policy->deadline >= 0
+        && policy->breaker_threshold >= 0 && policy->breaker_cooldown >= 0;
+}
+
+int svdrp_set_retry_policy (svdrp_t *svdrp, const svdrp_retry_policy_t *policy)
+{
+    if (!svdrp)
+        return SVDRP_ERROR;
+
+    if (!policy) {
+        svdrp_retry_policy_default (&svdrp->retry);
+    }
+    else {
+        if (!svdrp_retry_policy_valid (policy))
+            return SVDRP_ERROR;
+        svdrp->retry = *policy;
+    }
+
+    svdrp->breaker_failures = 0;
+    svdrp->breaker_until = 0;
+
+    return SVDRP_OK;
+}
+
+int svdrp_get_retry_policy (svdrp_t *svdrp, svdrp_retry_policy_t *policy)
+{
+    if (!svdrp || !policy)
+        return SVDRP_ERROR;
+
+    *policy = svdrp->retry;
+
+    return SVDRP_OK;
+}
+
+long long svdrp_retry_deadline (svdrp_t *svdrp)
+{
+    if (svdrp->retry.deadline)
+        return monotonic_ms () + svdrp->retry.deadline;
+
+    return monotonic_ms () + svdrp->timeout * 1000LL;
+}
+
+/* xorshift64*, good enough to spread the delays */
+static unsigned long long retry_rand (svdrp_t *svdrp)
+{
+    svdrp->rand_state ^= svdrp->rand_state >> 12;
+    svdrp->rand_state ^= svdrp->rand_state << 25;
+    svdrp->rand_state ^= svdrp->rand_state >> 27;
+
+    return svdrp->rand_state * 2685821657736338717ULL;
+}
+
+/* full jitter: anywhere between 0 and the capped exponential delay */
+static long long retry_delay (svdrp_t *svdrp, int retry)
+{
+    long long delay = svdrp->retry.base_delay;
+
+    while (--retry > 0 && delay < svdrp->retry.max_delay)
+        delay *= 2;
+    if (delay > svdrp->retry.max_delay)
+        delay = svdrp->retry.max_delay;
+
+    return delay ? (long long) (retry_rand (svdrp) % (delay + 1)) : 0;
+}
+
+static void retry_sleep (long long ms)
+{
+    struct timespec ts;
+
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+    while (nanosleep (&ts, &ts) < 0 && errno == EINTR)
+        ;
+}
+
+int svdrp_retry_wait (svdrp_t *svdrp, int verb, int tries, int sent)
+{
+    long long delay;
+
+    /* a replayed session holds the retries of the recorded one */
+    if (svdrp->replay || tries >= svdrp->retry.max_tries)
+        return 0;
+
+    if (svdrp->error == SVDRP_ERR_UNAVAILABLE
+        || svdrp->error == SVDRP_ERR_RESOLVE || svdrp_breaker_open (svdrp))
+        return 0;
+
+    if (sent && !svdrp_verbs[verb].idempotent && !svdrp->retry.retry_writes) {
+        svdrp_log (svdrp, SVDRP_MSG_WARNING,
+                   "Connection lost, %s may have been executed, not retrying",
+                   svdrp_verbs[verb].name);
+        return 0;
+    }
+
+    /* VDR closing an idle connection says nothing about its health */
+    if (tries == 1 && svdrp->error == SVDRP_ERR_CLOSED)
+        delay = 0;
+    else
+        delay = retry_delay (svdrp, tries);
+
+    if (svdrp->deadline && monotonic_ms () + delay >= svdrp->deadline) {
+        svdrp_log (svdrp, SVDRP_MSG_WARNING, "No time left to retry");
+        return 0;
+    }
+
+    svdrp_log (svdrp, SVDRP_MSG_INFO, "Retrying in %lli ms (attempt %i of %i)",
+               delay, tries + 1, svdrp->retry.max_tries);
+    if (delay)
+        retry_sleep (delay);
+
+    svdrp->metrics.retries++;
+    svdrp_set_error (svdrp, SVDRP_ERR_NONE);
+
+    return 1;
+}
+
+int svdrp_breaker_allow (svdrp_t *svdrp)
+{
+    if (!svdrp->breaker_until)
+        return 1;
+
+    /* half-open: let a single connection through */
+    if (monotonic_ms () >= svdrp->breaker_until) {
+        svdrp_log (svdrp, SVDRP_MSG_INFO, "Circuit breaker half-open, trying VDR");
+        svdrp->breaker_until = 0;
+        svdrp->breaker_failures = svdrp->retry.breaker_threshold - 1;
+        return 1;
+    }
+
+    svdrp->metrics.breaker_rejects++;
+    svdrp_set_error (svdrp, SVDRP_ERR_UNAVAILABLE);
+
+    return 0;
+}
+
+void svdrp_breaker_record (svdrp_t *svdrp, int connected)
+{
+    if (connected) {
+        svdrp->breaker_failures = 0;
+        return;
+    }
+
+    if (!svdrp->retry.breaker_threshold
+        || ++svdrp->breaker_failures < svdrp->retry.breaker_threshold)
+        return;
+
+    svdrp_log (svdrp, SVDRP_MSG_WARNING,
+               "%i connections failed, failing fast for %i ms",
+               svdrp->breaker_failures, svdrp->retry.breaker_cooldown);
+    svdrp->breaker_until = monotonic_ms () + svdrp->retry.breaker_cooldown;
+    if (!svdrp->breaker_until)
+        svdrp->breaker_until = 1;
+    svdrp->metrics.breaker_trips++;
+}
+
+int svdrp_breaker_open (svdrp_t *svdrp)
+{
+    return svdrp && svdrp->breaker_until
+        && monotonic_ms () < svdrp->breaker_until;
+}
@@ -23,13 +23,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
 
 #include "svdrp.h"
 #include "svdrp_internals.h"
 #include "logs.h"
+#include "commands.h"
+#include "fields.h"
 
-svdrp_t *svdrp_open (char* host, int port, int timeout, svdrp_verbosity_level_t verbosity)
+static svdrp_t *svdrp_new (char* host, int port, int timeout, svdrp_verbosity_level_t verbosity)
 {
     svdrp_t *svdrp = NULL;
 
@@ -39,8 +42,31 @@ svdrp_t *svdrp_open (char* host, int port, int timeout, svdrp_verbosity_level_t
 
     svdrp->host = strdup (host);
     svdrp->port = port ? port : SVDRP_DEFAULT_PORT;
+    svdrp->resolve_ttl = SVDRP_DEFAULT_RESOLVE_TTL;
     svdrp->timeout = timeout ? timeout : SVDRP_DEFAULT_TIMEOUT;
     svdrp->verbosity = verbosity;
+    svdrp->transport = &svdrp_transport_tcp;
+    svdrp->conn = -1;
+    svdrp->verb = SVDRP_VERB_OTHER;
+    svdrp_metrics_init (&svdrp->metrics);
+    svdrp_retry_init (svdrp);
+
+    if (linebuf_init (&svdrp->rbuf, LINEBUF_DEFAULT_SIZE) < 0) {
+        free (svdrp->host);
+        free (svdrp);
+        return NULL;
+    }
+
+    return svdrp;
+}
+
+svdrp_t *svdrp_open (char* host, int port, int timeout, svdrp_verbosity_level_t verbosity)
+{
+    svdrp_t *svdrp;
+
+    svdrp = svdrp_new (host, port, timeout, verbosity);
+    if (!svdrp)
+        return NULL;
 
     svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
 
@@ -50,6 +76,74 @@ svdrp_t *svdrp_open (char* host, int port, int timeout, svdrp_verbosity_level_t
     return svdrp;
 }
 
+svdrp_t *svdrp_open_async (char* host, int port, int timeout, svdrp_verbosity_level_t verbosity)
+{
+    svdrp_t *svdrp;
+
+    svdrp = svdrp_new (host, port, timeout, verbosity);
+    if (!svdrp)
+        return NULL;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    svdrp->async = 1;
+    svdrp_open_conn(svdrp);
+
+    return svdrp;
+}
+
+svdrp_t *svdrp_open_transport (const svdrp_transport_t *transport, void *data,
+                               char *host, int port, int timeout, int async,
+                               svdrp_verbosity_level_t verbosity)
+{
+    svdrp_t *svdrp;
+
+    if (!transport || !transport->open || !transport->read
+        || !transport->write || !transport->close)
+        return NULL;
+
+    svdrp = svdrp_new (host ? host : (char *) transport->name, port, timeout, verbosity);
+    if (!svdrp)
+        return NULL;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    svdrp->transport = transport;
+    svdrp->transport_data = data;
+    svdrp->async = async;
+    svdrp_open_conn (svdrp);
+
+    return svdrp;
+}
+
+svdrp_t *svdrp_open_replay (const char *path, int flags, svdrp_verbosity_level_t verbosity)
+{
+    svdrp_t *svdrp;
+
+    if (!path)
+        return NULL;
+
+    svdrp = svdrp_new ((char *) path, 0, 0, verbosity);
+    if (!svdrp)
+        return NULL;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    svdrp->replay = svdrp_replay_load (path, flags & SVDRP_REPLAY_REALTIME);
+    if (!svdrp->replay) {
+        svdrp_log (svdrp, SVDRP_MSG_ERROR, "Cannot load capture %s", path);
+        svdrp_close (svdrp);
+        return NULL;
+    }
+
+    svdrp->transport = &svdrp_transport_replay;
+    svdrp->transport_data = svdrp->replay;
+    svdrp->async = !!(flags & SVDRP_REPLAY_ASYNC);
+    svdrp_open_conn (svdrp);
+
+    return svdrp;
+}
+
 void svdrp_close (svdrp_t *svdrp)
 {
     svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
@@ -57,28 +151,146 @@ void svdrp_close (svdrp_t *svdrp)
     if (!svdrp)
         return;
 
-    if (svdrp->conn)
+    if (svdrp->conn_open)
         svdrp_close_conn (svdrp);
 
     if (svdrp->host)
         free (svdrp->host);
 
-    /* FIXME make sure to properly free all members */
+    svdrp_record_stop (svdrp);
+    svdrp_replay_free (svdrp->replay);
+    svdrp_resolve_clear (svdrp);
+    linebuf_free (&svdrp->rbuf);
+    strbuf_free (&svdrp->wbuf);
+    strbuf_free (&svdrp->last_reply);
+    svdrp_arena_free (svdrp->banner);
+    svdrp_cache_disable (svdrp);
+
     free (svdrp);
 }
 
-static int svdrp_simple_cmd (svdrp_t *svdrp, const char *cmd)
+int svdrp_command (svdrp_t *svdrp, const char *cmd,
+                   svdrp_reply_cb_t cb, void *data)
 {
+    unsigned long long bytes_in, bytes_out, reply_start;
+    svdrp_cache_fill_t fill;
+    svdrp_reply_code_t code;
+    long long start;
+    size_t len;
+    int verb, tries, sent;
+
     svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
 
-    svdrp_send(svdrp, cmd);
+    if (!svdrp || !cmd)
+        return SVDRP_ERROR;
 
-    if (svdrp_read_reply(svdrp) == SVDRP_REPLY_OK)
+    if (svdrp->async) {
+        svdrp_log (svdrp, SVDRP_MSG_ERROR, "Blocking command on a non-blocking connection");
+        return SVDRP_ERROR;
+    }
+
+    svdrp_set_error (svdrp, SVDRP_ERR_NONE);
+    svdrp_set_last_reply (svdrp, SVDRP_ERROR, "", 0);
+
+    len = command_len (cmd);
+    verb = svdrp_verb_lookup (cmd, len);
+
+    svdrp_cache_invalidate (svdrp, verb);
+    code = svdrp_cache_replay (svdrp, cmd, len, verb, cb, data);
+    if (code != SVDRP_ERROR)
+        return code;
+
+    /* the reply goes through the cache on its way to the callback */
+    memset (&fill, 0, sizeof (fill));
+    if (svdrp->cache) {
+        fill.cb = cb;
+        fill.data = data;
+        cb = svdrp_cache_fill_cb;
+        data = &fill;
+    }
+
+    /* the whole command, retries included, is bounded by the deadline */
+    svdrp->deadline = svdrp_retry_deadline (svdrp);
+
+    /* VDR having dropped an idle connection is noticed before sending */
+    if (svdrp->keepalive && svdrp->is_connected && !svdrp->replay
+        && !svdrp_conn_alive (svdrp)) {
+        svdrp_log (svdrp, SVDRP_MSG_INFO, "Connection closed while idle, reconnecting");
+        svdrp_close_conn (svdrp);
+    }
+
+    svdrp->verb = verb;
+    start = monotonic_us ();
+    bytes_in = svdrp->rbuf.consumed;
+    bytes_out = svdrp->bytes_out;
+
+    for (tries = 1; ; tries++) {
+        sent = 0;
+        reply_start = svdrp->rbuf.consumed;
+        if (svdrp_send (svdrp, cmd) < 0)
+            code = SVDRP_ERROR;
+        else {
+            sent = 1;
+            reply_start = svdrp->rbuf.consumed;
+            code = svdrp_read_reply_lines (svdrp, cb, data);
+        }
+
+        /* VDR closed the connection before reading the command */
+        if (code == SVDRP_REPLY_QUIT && verb != SVDRP_VERB_QUIT) {
+            svdrp_log (svdrp, SVDRP_MSG_VERBOSE, "vdr has closed connection");
+            sent = 0;
+        }
+        else if (code != SVDRP_ERROR)
+            break;
+        /* the callback has already seen part of the reply */
+        else if (svdrp->rbuf.consumed != reply_start)
+            break;
+
+        if (!svdrp_retry_wait (svdrp, verb, tries, sent))
+            break;
+
+        fill.lines.len = 0;
+        fill.error = 0;
+    }
+
+    svdrp_metrics_record (svdrp, svdrp->verb, code, monotonic_us () - start,
+                          svdrp->rbuf.consumed - bytes_in,
+                          svdrp->bytes_out - bytes_out);
+
+    svdrp->deadline = 0;
+    svdrp->verb = SVDRP_VERB_OTHER;
+
+    if (svdrp->cache)
+        svdrp_cache_store (svdrp, cmd, len, verb, code, &fill);
+
+    return code;
+}
+
+static int svdrp_simple_cmd (svdrp_t *svdrp, const char *cmd)
+{
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (svdrp_command(svdrp, cmd, NULL, NULL) == SVDRP_REPLY_OK)
         return SVDRP_OK;
     else
         return SVDRP_ERROR;
 }
 
+static int svdrp_pipeline_all_ok (svdrp_pipeline_t *pipeline)
+{
+    int i, ret;
+
+    ret = svdrp_pipeline_run (pipeline);
+
+    for (i = 0; i < svdrp_pipeline_count (pipeline); i++)
+        if (svdrp_pipeline_status (pipeline, i) != SVDRP_REPLY_OK)
+            ret = SVDRP_ERROR;
+
+    svdrp_pipeline_free (pipeline);
+
+    return ret;
+}
+
 int svdrp_epg_clear (svdrp_t *svdrp, int channel_id)
 {
     char *cmd;
@@ -103,6 +315,27 @@ int svdrp_epg_clear (svdrp_t *svdrp, int channel_id)
     return ret;
 }
 
+int svdrp_epg_clear_channels (svdrp_t *svdrp, const int *channels, int count)
+{
+    svdrp_pipeline_t *pipeline;
+    char cmd[16];
+    int i;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    pipeline = svdrp_pipeline_new (svdrp);
+    if (!pipeline)
+        return SVDRP_ERROR;
+
+    for (i = 0; i < count; i++) {
+        svdrp_log (svdrp, SVDRP_MSG_INFO, "Clear EPG for channel '%i'", channels[i]);
+        snprintf (cmd, sizeof (cmd), "CLRE %i\n", channels[i]);
+        svdrp_pipeline_add (pipeline, cmd, NULL, NULL);
+    }
+
+    return svdrp_pipeline_all_ok (pipeline);
+}
+
 int svdrp_epg_scan (svdrp_t *svdrp)
 {
     svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
@@ -117,23 +350,20 @@ int svdrp_next_timer_event (svdrp_t *svdrp, int *timer_id, time_t *time)
 
     svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
 
-    svdrp_send(svdrp, "NEXT abs\n");
-
-    code=svdrp_read_reply(svdrp);
-    if (code == SVDRP_REPLY_QUIT) //retry
-    {
-        svdrp_log (svdrp, SVDRP_MSG_VERBOSE, "vdr has closed connection, retrying...");
-        svdrp_send(svdrp, "NEXT abs\n");        
-        code=svdrp_read_reply(svdrp);
-    }
+    code = svdrp_command(svdrp, "NEXT abs\n", NULL, NULL);
 
     if (code == SVDRP_REPLY_OK) {
         int mytimer;
         struct tm tm = {0};
-        char *time_str = strstr(svdrp->last_reply, " ") + 1;
+        const char *reply = svdrp_get_last_reply (svdrp, NULL);
+        const char *time_str = strchr (reply, ' ');
         char full_time_str[256];
 
-        mytimer = atoi (svdrp->last_reply);
+        if (!time_str)
+            return SVDRP_ERROR;
+        time_str++;
+
+        mytimer = atoi (reply);
         strptime(time_str, "%s", &tm);
         strftime(full_time_str, 256, "%Y-%m-%d %H:%M:%S %z(%Z) (stamp: %s)", &tm);
 
@@ -174,78 +404,100 @@ int svdrp_osd_message (svdrp_t *svdrp, const char *msg)
     return ret;
 }
 
+static const char const *svdrp_keys[] = {
+    [SVDRP_KEY_UP]           = "Up",
+    [SVDRP_KEY_DOWN]         = "Down",
+    [SVDRP_KEY_MENU]         = "Menu",
+    [SVDRP_KEY_OK]           = "Ok",
+    [SVDRP_KEY_BACK]         = "Back",
+    [SVDRP_KEY_LEFT]         = "Left",
+    [SVDRP_KEY_RIGHT]        = "Right",
+    [SVDRP_KEY_RED]          = "Red",
+    [SVDRP_KEY_GREEN]        = "Green",
+    [SVDRP_KEY_YELLOW]       = "Yellow",
+    [SVDRP_KEY_BLUE]         = "Blue",
+    [SVDRP_KEY_0]            = "0",
+    [SVDRP_KEY_1]            = "1",
+    [SVDRP_KEY_2]            = "2",
+    [SVDRP_KEY_3]            = "3",
+    [SVDRP_KEY_4]            = "4",
+    [SVDRP_KEY_5]            = "5",
+    [SVDRP_KEY_6]            = "6",
+    [SVDRP_KEY_7]            = "7",
+    [SVDRP_KEY_8]            = "8",
+    [SVDRP_KEY_9]            = "9",
+    [SVDRP_KEY_INFO]         = "Info",
+    [SVDRP_KEY_PLAY]         = "Play",
+    [SVDRP_KEY_PAUSE]        = "Pause",
+    [SVDRP_KEY_STOP]         = "Stop",
+    [SVDRP_KEY_RECORD]       = "Record",
+    [SVDRP_KEY_FASTFWD]      = "FastFwd",
+    [SVDRP_KEY_FASTREW]      = "FastRew",
+    [SVDRP_KEY_NEXT]         = "Next",
+    [SVDRP_KEY_PREV]         = "Prev",
+    [SVDRP_KEY_POWER]        = "Power",
+    [SVDRP_KEY_CHANNELPLUS]  = "Channel+",
+    [SVDRP_KEY_CHANNELMINUS] = "Channel-",
+    [SVDRP_KEY_PREVCHANNEL]  = "PrevChannel",
+    [SVDRP_KEY_VOLUMEPLUS]   = "Volume+",
+    [SVDRP_KEY_VOLUMEMINUS]  = "Volume-",
+    [SVDRP_KEY_MUTE]         = "Mute",
+    [SVDRP_KEY_AUDIO]        = "Audio",
+    [SVDRP_KEY_SUBTITLES]    = "Subtitles",
+    [SVDRP_KEY_SCHEDULE]     = "Schedule",
+    [SVDRP_KEY_CHANNELS]     = "Channels",
+    [SVDRP_KEY_TIMERS]       = "Timers",
+    [SVDRP_KEY_RECORDINGS]   = "Recordings",
+    [SVDRP_KEY_SETUP]        = "Setup",
+    [SVDRP_KEY_COMMANDS]     = "Commands",
+    [SVDRP_KEY_USER1]        = "User1",
+    [SVDRP_KEY_USER2]        = "User2",
+    [SVDRP_KEY_USER3]        = "User3",
+    [SVDRP_KEY_USER4]        = "User4",
+    [SVDRP_KEY_USER5]        = "User5",
+    [SVDRP_KEY_USER6]        = "User6",
+    [SVDRP_KEY_USER7]        = "User7",
+    [SVDRP_KEY_USER8]        = "User8",
+    [SVDRP_KEY_USER9]        = "User9",
+};
+
 int svdrp_hit_key(svdrp_t *svdrp, svdrp_key_t key)
 {
-    static const char const *keys[] = {
-        [SVDRP_KEY_UP]           = "Up",
-        [SVDRP_KEY_DOWN]         = "Down",
-        [SVDRP_KEY_MENU]         = "Menu",
-        [SVDRP_KEY_OK]           = "Ok",
-        [SVDRP_KEY_BACK]         = "Back",
-        [SVDRP_KEY_LEFT]         = "Left",
-        [SVDRP_KEY_RIGHT]        = "Right",
-        [SVDRP_KEY_RED]          = "Red",
-        [SVDRP_KEY_GREEN]        = "Green",
-        [SVDRP_KEY_YELLOW]       = "Yellow",
-        [SVDRP_KEY_BLUE]         = "Blue",
-        [SVDRP_KEY_0]            = "0",
-        [SVDRP_KEY_1]            = "1",
-        [SVDRP_KEY_2]            = "2",
-        [SVDRP_KEY_3]            = "3",
-        [SVDRP_KEY_4]            = "4",
-        [SVDRP_KEY_5]            = "5",
-        [SVDRP_KEY_6]            = "6",
-        [SVDRP_KEY_7]            = "7",
-        [SVDRP_KEY_8]            = "8",
-        [SVDRP_KEY_9]            = "9",
-        [SVDRP_KEY_INFO]         = "Info",
-        [SVDRP_KEY_PLAY]         = "Play",
-        [SVDRP_KEY_PAUSE]        = "Pause",
-        [SVDRP_KEY_STOP]         = "Stop",
-        [SVDRP_KEY_RECORD]       = "Record",
-        [SVDRP_KEY_FASTFWD]      = "FastFwd",
-        [SVDRP_KEY_FASTREW]      = "FastRew",
-        [SVDRP_KEY_NEXT]         = "Next",
-        [SVDRP_KEY_PREV]         = "Prev",
-        [SVDRP_KEY_POWER]        = "Power",
-        [SVDRP_KEY_CHANNELPLUS]  = "Channel+",
-        [SVDRP_KEY_CHANNELMINUS] = "Channel-",
-        [SVDRP_KEY_PREVCHANNEL]  = "PrevChannel",
-        [SVDRP_KEY_VOLUMEPLUS]   = "Volume+",
-        [SVDRP_KEY_VOLUMEMINUS]  = "Volume-",
-        [SVDRP_KEY_MUTE]         = "Mute",
-        [SVDRP_KEY_AUDIO]        = "Audio",
-        [SVDRP_KEY_SUBTITLES]    = "Subtitles",
-        [SVDRP_KEY_SCHEDULE]     = "Schedule",
-        [SVDRP_KEY_CHANNELS]     = "Channels",
-        [SVDRP_KEY_TIMERS]       = "Timers",
-        [SVDRP_KEY_RECORDINGS]   = "Recordings",
-        [SVDRP_KEY_SETUP]        = "Setup",
-        [SVDRP_KEY_COMMANDS]     = "Commands",
-        [SVDRP_KEY_USER1]        = "User1",
-        [SVDRP_KEY_USER2]        = "User2",
-        [SVDRP_KEY_USER3]        = "User3",
-        [SVDRP_KEY_USER4]        = "User4",
-        [SVDRP_KEY_USER5]        = "User5",
-        [SVDRP_KEY_USER6]        = "User6",
-        [SVDRP_KEY_USER7]        = "User7",
-        [SVDRP_KEY_USER8]        = "User8",
-        [SVDRP_KEY_USER9]        = "User9",
-    };
-    const size_t len = strlen(keys[key]) + 7;
+    const size_t len = strlen(svdrp_keys[key]) + 7;
     char *cmd = malloc(len);
     int ret;
 
     svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
-    svdrp_log (svdrp, SVDRP_MSG_INFO, "Hit key '%s'", keys[key]);
+    svdrp_log (svdrp, SVDRP_MSG_INFO, "Hit key '%s'", svdrp_keys[key]);
 
-    snprintf (cmd, len, "HITK %s\n", keys[key]);
+    snprintf (cmd, len, "HITK %s\n", svdrp_keys[key]);
     ret = svdrp_simple_cmd(svdrp, cmd);
     free(cmd);
 
     return ret;
 }
 
+int svdrp_hit_keys(svdrp_t *svdrp, const svdrp_key_t *keys, int count)
+{
+    svdrp_pipeline_t *pipeline;
+    char cmd[32];
+    int i;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    pipeline = svdrp_pipeline_new (svdrp);
+    if (!pipeline)
+        return SVDRP_ERROR;
+
+    for (i = 0; i < count; i++) {
+        svdrp_log (svdrp, SVDRP_MSG_INFO, "Hit key '%s'", svdrp_keys[keys[i]]);
+        snprintf (cmd, sizeof (cmd), "HITK %s\n", svdrp_keys[keys[i]]);
+        svdrp_pipeline_add (pipeline, cmd, NULL, NULL);
+    }
+
+    return svdrp_pipeline_all_ok (pipeline);
+}
+
 int svdrp_volume_mute (svdrp_t *svdrp)
 {
     svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
@@ -313,6 +565,49 @@ int svdrp_is_connected(svdrp_t *svdrp)
     return svdrp->is_connected;
 }
 
+void svdrp_set_resolve_ttl(svdrp_t *svdrp, int ttl)
+{
+    if (!svdrp)
+        return;
+
+    svdrp->resolve_ttl = ttl > 0 ? ttl : 0;
+
+    /* take the new lifetime into account from the next connection on */
+    svdrp_resolve_clear (svdrp);
+}
+
+svdrp_error_t svdrp_get_error(svdrp_t *svdrp)
+{
+    return svdrp ? svdrp->error : SVDRP_ERR_NONE;
+}
+
+const char *svdrp_strerror(svdrp_error_t error)
+{
+    switch (error)
+    {
+    case SVDRP_ERR_NONE:    return "Success";
+    case SVDRP_ERR_RESOLVE: return "Unknown host";
+    case SVDRP_ERR_CONNECT: return "Connection failed";
+    case SVDRP_ERR_TIMEOUT: return "Timeout";
+    case SVDRP_ERR_IO:      return "Input/output error";
+    case SVDRP_ERR_CLOSED:  return "Connection closed by VDR";
+    case SVDRP_ERR_UNAVAILABLE: return "VDR unavailable";
+    }
+
+    return "Unknown error";
+}
+
+const char *svdrp_get_last_reply(svdrp_t *svdrp, int *code)
+{
+    if (code)
+        *code = svdrp ? svdrp->last_reply_code : SVDRP_ERROR;
+
+    if (!svdrp || !svdrp->last_reply.data)
+        return "";
+
+    return svdrp->last_reply.data;
+}
+
 const char *svdrp_get_property(svdrp_t *svdrp, svdrp_property_t property)
 {
     svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
@@ -328,76 +623,251 @@ const char *svdrp_get_property(svdrp_t *svdrp, svdrp_property_t property)
     return NULL;
 }
 
-int svdrp_get_timer(svdrp_t *svdrp, int timer_id, svdrp_timer_t *timer)
+/* copy a string of a timer, into an arena or else on its own */
+static char *svdrp_timer_str(svdrp_arena_t *arena, const svdrp_str_t *field,
+                             int unescape)
 {
-    const int len = 10;
-    char cmd[len];
+    char *str;
+
+    if (!arena)
+        return svdrp_fields_strdup (field, unescape);
+
+    str = svdrp_arena_strndup (arena, field->ptr, field->len);
+    if (str && unescape)
+        svdrp_fields_unescape (str, str, field->len);
+
+    return str;
+}
+
+static int svdrp_fetch_timer(svdrp_t *svdrp, svdrp_arena_t *arena,
+                             int timer_id, svdrp_timer_t *timer)
+{
+    char cmd[32];
     svdrp_reply_code_t code;
+    svdrp_timer_view_t view;
+    const char *reply;
 
     svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
 
-    snprintf(cmd, len, "LSTT %i\n", timer_id);
+    snprintf(cmd, sizeof (cmd), "LSTT %i\n", timer_id);
 
-    svdrp_send(svdrp, cmd);
-
-    code=svdrp_read_reply(svdrp);
-    if (code == SVDRP_REPLY_QUIT) //retry
-    {
-        svdrp_log (svdrp, SVDRP_MSG_VERBOSE, "vdr has closed connection, retrying...");
-        svdrp_send(svdrp, cmd);      
-        code=svdrp_read_reply(svdrp);
-    }
+    code = svdrp_command(svdrp, cmd, NULL, NULL);
 
     if (code == SVDRP_REPLY_OK) {
-        unsigned char flags;
-        char day[256], start[256], stop[256], file[256], data[256];
-
         if (!timer)
             return SVDRP_ERROR;
 
-        sscanf(svdrp->last_reply + 2,
-               "%i:%hhi:%[^:]:%[^:]:%[^:]:%i:%i:%[^:]:%[^:]",
-               &(timer->channel),
-               &flags,
-               day,
-               start,
-               stop,
-               &(timer->priority),
-               &(timer->lifetime),
-               file,
-               data);
+        reply = svdrp_get_last_reply (svdrp, NULL);
+        if (svdrp_parse_timer (reply, strlen (reply), &view) != SVDRP_OK) {
+            svdrp_log (svdrp, SVDRP_MSG_WARNING, "Invalid timer '%s'", reply);
+            return SVDRP_ERROR;
+        }
 
+        memset (timer, 0, sizeof (svdrp_timer_t));
         timer->id = timer_id;
-        timer->start = strdup (start);
-        timer->stop = strdup (stop);
-        timer->file = strdup (file);
-        timer->data = strdup (data);
-        timer->is_active = ((flags & SVDRP_TIMER_ACTIVE_FLAG) != 0);
-        timer->is_recording = ((flags & SVDRP_TIMER_RECORDING_FLAG) != 0);
-        timer->is_instant = ((flags & SVDRP_TIMER_INSTANT_FLAG) != 0);
-        timer->use_vps = ((flags & SVDRP_TIMER_VPS_FLAG) != 0);
-
-        if (day[0] == 'M' || day[0] == '-') /* repeating timer */
-        {
-            int i;
-
-            for (i = 0; i < 7; i++)
-                if (day[i] != '-')
-                    timer->repeating |= ((unsigned char) (1 << i));
-
-            if (strlen(day) > 7 && day[7] == '@')
-                timer->first_date = strdup (day + 8);
-            else
-                timer->first_date = NULL;
-        }
-        else /* one shot timer */
-        {
-            timer->first_date = strdup (day);
-            timer->repeating = 0;
-        }
+        timer->channel = view.channel;
+        timer->first_date = svdrp_timer_str (arena, &view.first_date, 0);
+        timer->start = svdrp_timer_str (arena, &view.start, 0);
+        timer->stop = svdrp_timer_str (arena, &view.stop, 0);
+        timer->repeating = view.repeating;
+        timer->is_active = view.is_active;
+        timer->is_recording = view.is_recording;
+        timer->is_instant = view.is_instant;
+        timer->use_vps = view.use_vps;
+        timer->priority = view.priority;
+        timer->lifetime = view.lifetime;
+        timer->file = svdrp_timer_str (arena, &view.file, 1);
+        timer->data = svdrp_timer_str (arena, &view.data, 0);
 
         return SVDRP_OK;
     } else { /* usually 501 Timer not defined */
         return SVDRP_ERROR;
     }
 }
+
+int svdrp_get_timer(svdrp_t *svdrp, int timer_id, svdrp_timer_t *timer)
+{
+    return svdrp_fetch_timer (svdrp, NULL, timer_id, timer);
+}
+
+int svdrp_snapshot_timer(svdrp_t *svdrp, svdrp_arena_t *arena, int timer_id,
+                         svdrp_timer_t *timer)
+{
+    if (!arena)
+        return SVDRP_ERROR;
+
+    return svdrp_fetch_timer (svdrp, arena, timer_id, timer);
+}
+
+/* terminate a field of a line in place */
+static char *svdrp_timer_field(char *line, const svdrp_str_t *field,
+                               int unescape)
+{
+    char *str;
+
+    if (!field->ptr)
+        return NULL;
+
+    str = line + (field->ptr - line);
+    if (unescape)
+        svdrp_fields_unescape (str, str, field->len);
+    str[field->len] = '\0';
+
+    return str;
+}
+
+/* parse an LSTT line in place, the timer strings point into line */
+static int svdrp_parse_timer_line(char *line, svdrp_timer_t *timer)
+{
+    svdrp_timer_view_t view;
+
+    if (svdrp_parse_timer (line, strlen (line), &view) != SVDRP_OK)
+        return SVDRP_ERROR;
+
+    timer->id = view.id;
+    timer->channel = view.channel;
+    timer->repeating = view.repeating;
+    timer->is_active = view.is_active;
+    timer->is_recording = view.is_recording;
+    timer->is_instant = view.is_instant;
+    timer->use_vps = view.use_vps;
+    timer->priority = view.priority;
+    timer->lifetime = view.lifetime;
+
+    /* the first date is the end of the day field, cut along with it */
+    timer->first_date = svdrp_timer_field (line, &view.first_date, 0);
+    timer->start = svdrp_timer_field (line, &view.start, 0);
+    timer->stop = svdrp_timer_field (line, &view.stop, 0);
+    timer->file = svdrp_timer_field (line, &view.file, 1);
+    timer->data = svdrp_timer_field (line, &view.data, 0);
+
+    return SVDRP_OK;
+}
+
+typedef struct timer_lines_s {
+    strbuf_t pool;
+    int count;
+    int error;
+} timer_lines_t;
+
+static void svdrp_timer_line_cb(void *data, int code,
+                                const char *line, size_t len, int last)
+{
+    timer_lines_t *lines = data;
+
+    (void) last;
+
+    if (code != SVDRP_REPLY_OK || lines->error)
+        return;
+
+    /* keep the terminating NUL of each line in the pool */
+    if (strbuf_append (&lines->pool, line, len + 1) < 0)
+        lines->error = 1;
+    else
+        lines->count++;
+}
+
+int svdrp_list_timers(svdrp_t *svdrp, svdrp_timer_t **timers, int *count)
+{
+    timer_lines_t lines = { { NULL, 0, 0 }, 0, 0 };
+    svdrp_reply_code_t code;
+    svdrp_timer_t *array;
+    char *pool;
+    int i, n = 0;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (!svdrp || !timers || !count)
+        return SVDRP_ERROR;
+
+    *timers = NULL;
+    *count = 0;
+
+    code = svdrp_command(svdrp, "LSTT\n", svdrp_timer_line_cb, &lines);
+    if (code == SVDRP_REPLY_ACTION_NOT_TAKEN) { /* 550 No timers defined */
+        strbuf_free (&lines.pool);
+        return SVDRP_OK;
+    }
+
+    if (code != SVDRP_REPLY_OK || lines.error || !lines.count) {
+        strbuf_free (&lines.pool);
+        return SVDRP_ERROR;
+    }
+
+    /* timers first, followed by the strings they point to */
+    array = malloc (lines.count * sizeof (svdrp_timer_t) + lines.pool.len);
+    if (!array) {
+        strbuf_free (&lines.pool);
+        return SVDRP_ERROR;
+    }
+
+    pool = (char *) (array + lines.count);
+    memcpy (pool, lines.pool.data, lines.pool.len);
+    strbuf_free (&lines.pool);
+
+    for (i = 0; i < lines.count; i++) {
+        char *line = pool;
+
+        pool += strlen (line) + 1;
+        if (svdrp_parse_timer_line (line, &array[n]) == SVDRP_OK)
+            n++;
+        else
+            svdrp_log (svdrp, SVDRP_MSG_WARNING, "Invalid timer '%s'", line);
+    }
+
+    svdrp_log (svdrp, SVDRP_MSG_INFO, "Got %i timers", n);
+
+    *timers = array;
+    *count = n;
+
+    return SVDRP_OK;
+}
+
+void svdrp_free_timers(svdrp_timer_t *timers)
+{
+    free (timers);
+}
+
+int svdrp_snapshot_timers(svdrp_t *svdrp, svdrp_arena_t *arena,
+                          svdrp_timer_t **timers, int *count)
+{
+    svdrp_arena_lines_t lines = { arena, NULL, NULL, 0, 0 };
+    svdrp_arena_line_t *line;
+    svdrp_reply_code_t code;
+    svdrp_timer_t *array;
+    int n = 0;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (!svdrp || !arena || !timers || !count)
+        return SVDRP_ERROR;
+
+    *timers = NULL;
+    *count = 0;
+
+    code = svdrp_command(svdrp, "LSTT\n", svdrp_arena_line_cb, &lines);
+    if (code == SVDRP_REPLY_ACTION_NOT_TAKEN) /* 550 No timers defined */
+        return SVDRP_OK;
+
+    if (code != SVDRP_REPLY_OK || lines.error || !lines.count)
+        return SVDRP_ERROR;
+
+    array = svdrp_arena_alloc (arena, lines.count * sizeof (svdrp_timer_t));
+    if (!array)
+        return SVDRP_ERROR;
+
+    /* the timers point into their lines, already in the arena */
+    for (line = lines.head; line; line = line->next) {
+        if (svdrp_parse_timer_line (line->text, &array[n]) == SVDRP_OK)
+            n++;
+        else
+            svdrp_log (svdrp, SVDRP_MSG_WARNING, "Invalid timer '%s'", line->text);
+    }
+
+    svdrp_log (svdrp, SVDRP_MSG_INFO, "Got %i timers", n);
+
+    *timers = array;
+    *count = n;
+
+    return SVDRP_OK;
+}
@@ -26,8 +26,25 @@
  * \file svdrp.h
  *
  * GeeXboX libsvdrp public API header.
+ *
+ * The library keeps no global state: everything about a session lives in
+ * its connection object. Distinct connection objects can be used from as
+ * many threads at once; one object must only be used by one thread at a
+ * time. No operation raises SIGPIPE when VDR goes away.
+ *
+ * Strings handed to reply callbacks point into the receive buffer of the
+ * connection and are only valid for the duration of the call. The strings
+ * returned by a connection object belong to it: the last reply is valid
+ * until the next command, the server properties until the next connection
+ * to VDR, and both until svdrp_close().
  */
 
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
 /** \brief libsvdrp version */
 #define LIBSVDRP_VERSION "0.0.1"
 
@@ -37,6 +54,28 @@
 /** \brief Default port for SVDRP connections */
 #define SVDRP_DEFAULT_PORT 2001
 
+/** \brief Number of command verbs metrics are kept for, "OTHER" included */
+#define SVDRP_METRICS_VERBS 37
+
+/** \brief Sub-buckets per power of two of the latency histograms */
+#define SVDRP_LATENCY_SUB_BITS 2
+
+/** \brief Number of buckets of the latency histograms, up to about 4 min */
+#define SVDRP_LATENCY_BUCKETS 108
+
+/** \brief Maximum length of a message queued in a log ring */
+#define SVDRP_LOG_RING_MESSAGE_SIZE 256
+
+/** \brief Default lifetime in seconds of resolved VDR addresses */
+#define SVDRP_DEFAULT_RESOLVE_TTL 300
+
+/**
+ * \brief Default time in seconds a pooled connection may stay idle.
+ *
+ * VDR closes SVDRP connections idle for 300 seconds by default.
+ */
+#define SVDRP_POOL_DEFAULT_IDLE_TIMEOUT 240
+
 /** \brief SVDRP return code for successful operations */
 #define SVDRP_OK    1
 
@@ -50,6 +89,86 @@
  */
 typedef struct svdrp_s svdrp_t;
 
+/* SVDRP Reply Codes
+Reply codes are in the format
+<Reply code><-|Space><Text><Newline>
+In the last line the "-" is replace be a space.
+
+901..999 Plugin specific reply codes
+*/
+
+/** \brief SVDRP Reply Codes */
+typedef enum svdrp_reply_code {
+    SVDRP_REPLY_HELP               = 214, /**< Help message */
+    SVDRP_REPLY_EPG_DATA           = 215, /**< EPG or recording data record */
+    SVDRP_REPLY_GRAB_DATA          = 216, /**< Image grab data (base 64) */
+    SVDRP_REPLY_READY              = 220, /**< VDR service ready */
+    SVDRP_REPLY_QUIT               = 221, /**< VDR service closing transmission
+                                           *   channel */
+    SVDRP_REPLY_OK                 = 250, /**< Requested VDR action okay,
+                                           *   completed */
+    SVDRP_REPLY_EPG_START          = 354, /**< Start sending EPG data */
+    SVDRP_REPLY_ABORT              = 451, /**< Requested action aborted: local
+                                           *   error in processing */
+    SVDRP_REPLY_UNKNOWN_CMD        = 500, /**< Syntax error, command
+                                           *   unrecognized */
+    SVDRP_REPLY_UNKNOWN_PARAM      = 501, /**< Syntax error in parameters or
+                                           *   arguments */
+    SVDRP_REPLY_UNIMPEMENTED_CMD   = 502, /**< Command not implemented */
+    SVDRP_REPLY_UNIMPEMENTED_PARAM = 504, /**< Command parameter not
+                                           *   implemented */
+    SVDRP_REPLY_ACTION_NOT_TAKEN   = 550, /**< Requested action not taken */
+    SVDRP_REPLY_TRANSACTION_FAILED = 554, /**< Transaction failed */
+    SVDRP_REPLY_PLUGIN             = 900, /**< Default plugin reply code */
+} svdrp_reply_code_t;
+
+/**
+ * \brief Callback receiving the lines of an SVDRP reply.
+ *
+ * \param[in] data        user data given along with the callback
+ * \param[in] code        reply code of the line
+ * \param[in] line        text of the line, without the reply code prefix
+ * \param[in] len         length of the text
+ * \param[in] last        whether this is the last line of the reply
+ *
+ * The text points into the connection receive buffer: it is NUL-terminated
+ * but only valid for the duration of the call.
+ */
+typedef void (*svdrp_reply_cb_t) (void *data, int code,
+                                  const char *line, size_t len, int last);
+
+/**
+ * \brief Callback invoked when a non-blocking command has completed.
+ *
+ * \param[in] data        user data given along with the callback
+ * \param[in] code        reply code of the last line, SVDRP_ERROR if the
+ *                        connection was lost before the reply arrived
+ */
+typedef void (*svdrp_done_cb_t) (void *data, int code);
+
+/** \brief Wait for the SVDRP socket to become readable */
+#define SVDRP_IO_READ  (1 << 0)
+
+/** \brief Wait for the SVDRP socket to become writable */
+#define SVDRP_IO_WRITE (1 << 1)
+
+/** \brief Replay a capture with its original timing */
+#define SVDRP_REPLAY_REALTIME (1 << 0)
+
+/** \brief Replay a capture on a non-blocking connection */
+#define SVDRP_REPLAY_ASYNC    (1 << 1)
+
+/** \brief Cause of the last failure on an SVDRP connection. */
+typedef enum {
+    SVDRP_ERR_NONE,               /**< no error */
+    SVDRP_ERR_RESOLVE,            /**< host name could not be resolved */
+    SVDRP_ERR_CONNECT,            /**< connection refused or unreachable */
+    SVDRP_ERR_TIMEOUT,            /**< operation did not complete in time */
+    SVDRP_ERR_IO,                 /**< read or write failure */
+    SVDRP_ERR_CLOSED,             /**< connection closed by VDR */
+    SVDRP_ERR_UNAVAILABLE,        /**< VDR known to be down, not tried */
+} svdrp_error_t;
+
 /** \brief SVDRP verbosity. */
 typedef enum {
     SVDRP_MSG_NONE,          /**< no error messages */
@@ -160,6 +279,349 @@ typedef struct svdrp_timer_s {
     char *data;                   /**< Auxiliary data */
 } svdrp_timer_t;
 
+/** \brief Borrowed string: not NUL-terminated, owned by someone else. */
+typedef struct svdrp_str_s {
+    const char *ptr;              /**< First character, NULL if absent */
+    size_t len;                   /**< Length in bytes */
+} svdrp_str_t;
+
+/** \brief Timer parsed from an LSTT line, its strings pointing into it. */
+typedef struct svdrp_timer_view_s {
+    int id;
+    int channel;
+    svdrp_str_t day;              /**< Day field, as sent by VDR */
+    svdrp_str_t first_date;       /**< Date of the (first) recording, may be absent */
+    svdrp_str_t start;            /**< Start time, "hhmm" */
+    svdrp_str_t stop;             /**< Stop time, "hhmm" */
+    unsigned char repeating;      /**< Days of the week the timer repeats (bitfield) */
+    int is_active;                /**< Whether the timer is active or not */
+    int is_recording;             /**< Whether the timer is currently recording or not */
+    int is_instant;               /**< Whether this is an instant recording timer */
+    int use_vps;                  /**< Whether the timer uses VPS */
+    int priority;                 /**< Timer priority (0-99), highest wins */
+    int lifetime;                 /**< Recording lifetime (0-99) */
+    svdrp_str_t file;             /**< File name */
+    svdrp_str_t data;             /**< Auxiliary data */
+} svdrp_timer_view_t;
+
+/** \brief Channel parsed from an LSTC line, its strings pointing into it. */
+typedef struct svdrp_channel_view_s {
+    int number;                   /**< Channel number */
+    svdrp_str_t name;             /**< Name, with the short name after a ',' */
+    svdrp_str_t provider;         /**< Provider, may be absent */
+    int frequency;
+    svdrp_str_t parameters;       /**< Transponder parameters */
+    svdrp_str_t source;           /**< Source (e.g. S19.2E) */
+    int srate;                    /**< Symbol rate */
+    svdrp_str_t vpid;             /**< Video PID(s) */
+    svdrp_str_t apid;             /**< Audio PIDs, with their languages */
+    svdrp_str_t tpid;             /**< Teletext PID */
+    svdrp_str_t caid;             /**< Conditional access IDs */
+    int sid;                      /**< Service ID */
+    int nid;                      /**< Network ID */
+    int tid;                      /**< Transport stream ID */
+    int rid;                      /**< Radio ID */
+} svdrp_channel_view_t;
+
+/** \brief Recording parsed from an LSTR line, its strings pointing into it. */
+typedef struct svdrp_recording_view_s {
+    int id;                       /**< Recording number, for PLAY, DELR... */
+    svdrp_str_t date;             /**< Date, "dd.mm.yy" */
+    svdrp_str_t time;             /**< Time, "hh:mm" */
+    svdrp_str_t length;           /**< Length, "h:mm", absent before VDR 1.7.21 */
+    int is_new;                   /**< Whether it has not been watched yet */
+    svdrp_str_t name;             /**< Name, '~' separating folders */
+} svdrp_recording_view_t;
+
+/**
+ * \brief Callback receiving a timer of a listing.
+ *
+ * \param[in] data        user data given along with the callback
+ * \param[in] timer       the timer; only valid during the call
+ */
+typedef void (*svdrp_timer_view_cb_t) (void *data,
+                                       const svdrp_timer_view_t *timer);
+
+/**
+ * \brief Callback receiving a channel of a listing.
+ *
+ * \param[in] data        user data given along with the callback
+ * \param[in] channel     the channel; only valid during the call
+ */
+typedef void (*svdrp_channel_view_cb_t) (void *data,
+                                         const svdrp_channel_view_t *channel);
+
+/**
+ * \brief Callback receiving a recording of a listing.
+ *
+ * \param[in] data        user data given along with the callback
+ * \param[in] recording   the recording; only valid during the call
+ */
+typedef void (*svdrp_recording_view_cb_t) (void *data,
+                                           const svdrp_recording_view_t *recording);
+
+/** \brief Stream component of an EPG event. */
+typedef struct svdrp_epg_component_s {
+    int stream;                   /**< Stream content (1 video, 2 audio...) */
+    int type;                     /**< Component type */
+    const char *language;         /**< ISO 639 language code */
+    const char *description;      /**< Component description, may be NULL */
+} svdrp_epg_component_t;
+
+/** \brief Channel an EPG event belongs to. */
+typedef struct svdrp_epg_channel_s {
+    const char *id;               /**< Channel ID (e.g. S19.2E-1-1101-28106) */
+    const char *name;             /**< Channel name, may be NULL */
+} svdrp_epg_channel_t;
+
+/** \brief EPG event, as delivered by VDR's LSTE command. */
+typedef struct svdrp_epg_event_s {
+    const svdrp_epg_channel_t *channel; /**< Channel broadcasting the event */
+    unsigned int id;              /**< Event ID */
+    time_t start;                 /**< Start time, seconds since the epoch */
+    int duration;                 /**< Duration in seconds */
+    int table_id;                 /**< DVB table ID */
+    int version;                  /**< DVB table version */
+    const char *title;            /**< Title, may be NULL */
+    const char *short_text;       /**< Short text, may be NULL */
+    const char *description;      /**< Description ('|' separates lines),
+                                   *   may be NULL */
+    int parental_rating;          /**< Minimum age, 0 if unrated */
+    time_t vps;                   /**< VPS time, 0 if none */
+    int components_count;         /**< Number of entries in components */
+    const svdrp_epg_component_t *components; /**< Stream components */
+} svdrp_epg_event_t;
+
+/**
+ * \brief Callback receiving an EPG channel, as soon as it is opened.
+ *
+ * \param[in] data        user data given along with the callback
+ * \param[in] channel     the channel; only valid during the call
+ */
+typedef void (*svdrp_epg_channel_cb_t) (void *data,
+                                        const svdrp_epg_channel_t *channel);
+
+/**
+ * \brief Callback receiving an EPG event, as soon as it is complete.
+ *
+ * \param[in] data        user data given along with the callback
+ * \param[in] event       the event; only valid during the call
+ */
+typedef void (*svdrp_epg_event_cb_t) (void *data,
+                                      const svdrp_epg_event_t *event);
+
+/**
+ * \brief SVDRP command pipeline.
+ *
+ * Queues several commands, sends them with a single write and reads the
+ * replies back in order, so that a batch costs about one round trip.
+ */
+typedef struct svdrp_pipeline_s svdrp_pipeline_t;
+
+/**
+ * \brief Set of SVDRP connections to several VDR servers.
+ *
+ * Sends the same commands to many hosts at once and drives all the
+ * connections from a single event loop, so that the total time is close to
+ * the time taken by the slowest host.
+ */
+typedef struct svdrp_multi_s svdrp_multi_t;
+
+/**
+ * \brief Pool of warm SVDRP connections to one or several VDR servers.
+ *
+ * Hands out connections for one task at a time and keeps them open in
+ * between, so that a task does not pay for connecting to VDR.
+ */
+typedef struct svdrp_pool_s svdrp_pool_t;
+
+/**
+ * \brief Callback receiving the reply lines of one host of a set.
+ *
+ * \param[in] data        user data given along with the callback
+ * \param[in] host        index of the host, as returned by
+ *                        svdrp_multi_add_host()
+ * \param[in] code        reply code of the line
+ * \param[in] line        text of the line, without the reply code prefix
+ * \param[in] len         length of the text
+ * \param[in] last        whether this is the last line of the reply
+ */
+typedef void (*svdrp_multi_cb_t) (void *data, int host, int code,
+                                  const char *line, size_t len, int last);
+
+/**
+ * \brief Incremental parser for EPG data.
+ *
+ * Turns the C/E/T/S/D/G/R/X/V/e/c record stream of LSTE (or of an
+ * epg.data file) into channel and event callbacks. Peak memory is bounded
+ * by the size of a single event.
+ */
+typedef struct svdrp_epg_parser_s svdrp_epg_parser_t;
+
+/**
+ * \brief In-memory EPG, indexed for lookups by channel and time.
+ *
+ * Filled from LSTE, it keeps the events of each channel in an array sorted
+ * by start time, so that "what is on now", "what comes next" and "what
+ * airs between two times" are binary searches rather than round trips to
+ * VDR.
+ */
+typedef struct svdrp_epg_index_s svdrp_epg_index_t;
+
+/**
+ * \brief Region allocator, for snapshots released all at once.
+ *
+ * Allocations are carved out of large chunks and cannot be freed one by
+ * one: resetting the arena releases all of them in O(1), keeping the
+ * chunks for the next snapshot.
+ */
+typedef struct svdrp_arena_s svdrp_arena_t;
+
+/**
+ * \brief Metrics of a command verb.
+ *
+ * Latencies are in microseconds, from sending the command to the end of its
+ * reply. The histogram has a logarithmic scale with linear sub-buckets,
+ * bucket i holding the latencies up to svdrp_latency_bucket_bound(i).
+ */
+typedef struct svdrp_verb_metrics_s {
+    const char *verb;             /**< verb name, e.g. "LSTT" */
+    unsigned long count;          /**< commands sent */
+    unsigned long errors;         /**< commands without a reply */
+    unsigned long rejected;       /**< commands answered with a 4xx/5xx code */
+    unsigned long long bytes_in;  /**< bytes of the replies */
+    unsigned long long bytes_out; /**< bytes of the commands */
+    unsigned long long latency_sum; /**< sum of the latencies */
+    unsigned int latency[SVDRP_LATENCY_BUCKETS]; /**< latency histogram */
+} svdrp_verb_metrics_t;
+
+/** \brief Metrics of an SVDRP connection. */
+typedef struct svdrp_metrics_s {
+    unsigned long connects;       /**< connections established */
+    unsigned long reconnects;     /**< connections established again */
+    unsigned long server_closes;  /**< connections closed by VDR (221) */
+    unsigned long retries;        /**< commands sent again */
+    unsigned long timeouts;       /**< operations which timed out */
+    unsigned long cache_hits;     /**< replies served by the cache */
+    unsigned long cache_misses;   /**< cacheable commands sent to VDR */
+    unsigned long cache_invalidations; /**< replies dropped by a mutating command */
+    unsigned long keepalives;     /**< no-ops sent on an idle connection */
+    unsigned long breaker_trips;  /**< times the circuit breaker opened */
+    unsigned long breaker_rejects; /**< connections refused by the breaker */
+    svdrp_verb_metrics_t verbs[SVDRP_METRICS_VERBS];
+} svdrp_metrics_t;
+
+/**
+ * \brief How failed commands are retried.
+ *
+ * The delay before retry n is drawn at random between 0 and
+ * min(max_delay, base_delay * 2^(n-1)), so that clients losing VDR at the
+ * same time do not reconnect in lockstep.
+ */
+typedef struct svdrp_retry_policy_s {
+    int max_tries;                /**< attempts per command, the first one
+                                   *   included, 1 not to retry */
+    int base_delay;               /**< delay before the first retry, in ms */
+    int max_delay;                /**< cap of the delays, in ms */
+    int deadline;                 /**< time a command may take, retries
+                                   *   included, in ms, 0 for the timeout
+                                   *   of the connection */
+    int retry_writes;             /**< also retry the commands not safe to
+                                   *   repeat which may have been executed */
+    int breaker_threshold;        /**< failed connections in a row opening
+                                   *   the circuit breaker, 0 never */
+    int breaker_cooldown;         /**< time the circuit stays open, in ms */
+} svdrp_retry_policy_t;
+
+/** \brief A message of the library log. */
+typedef struct svdrp_log_record_s {
+    svdrp_verbosity_level_t level;
+    svdrp_t *svdrp;               /**< connection the message is about;
+                                   *   through a log ring, only an
+                                   *   identifier not to be dereferenced */
+    struct timespec time;         /**< wall clock time of the message */
+    const char *message;          /**< formatted message, NUL-terminated */
+    size_t len;                   /**< length of message */
+} svdrp_log_record_t;
+
+/**
+ * \brief Log sink.
+ *
+ * \param[in] data         user data given along with the sink
+ * \param[in] record       the message, only valid during the call
+ */
+typedef void (*svdrp_log_sink_t) (void *data, const svdrp_log_record_t *record);
+
+/**
+ * \brief Ring buffer decoupling logging from the output of the messages.
+ *
+ * Messages are copied into the ring without locking nor allocating, and a
+ * background thread hands them to the actual sink. By then the connection
+ * a message is about may have been closed: the sink must not dereference
+ * the svdrp field of the record, only compare it.
+ */
+typedef struct svdrp_log_ring_s svdrp_log_ring_t;
+
+/**
+ * \brief How the bytes of a connection get to and from VDR.
+ *
+ * Every operation gets the data given along with the transport to
+ * svdrp_open_transport() and the descriptor returned by open. Reads and
+ * writes follow read(2) and write(2): -1 with errno set to EAGAIN when
+ * they would block, the library then waits for the descriptor; a read
+ * returning 0 means VDR has closed the connection.
+ */
+typedef struct svdrp_transport_s {
+    /** \brief name of the transport, default host name for the logs */
+    const char *name;
+    /**
+     * \brief Open a new connection to the host and port of svdrp.
+     *
+     * Returns SVDRP_OK or SVDRP_ERROR and stores the descriptor to wait on
+     * in fd, -1 for a transport that never blocks. In non-blocking mode
+     * (see svdrp_open_async()) the connection may complete later, the
+     * descriptor then becomes writable.
+     */
+    int (*open) (void *data, svdrp_t *svdrp, int *fd);
+    /** \brief Read up to len bytes. */
+    ssize_t (*read) (void *data, int fd, void *buf, size_t len);
+    /** \brief Write up to len bytes. */
+    ssize_t (*write) (void *data, int fd, const void *buf, size_t len);
+    /** \brief Write several buffers at once, NULL to use write instead. */
+    ssize_t (*writev) (void *data, int fd, const struct iovec *iov, int iovcnt);
+    /** \brief Close a connection. */
+    void (*close) (void *data, int fd);
+} svdrp_transport_t;
+
+/** \brief TCP transport, the default one: host name and port of VDR. */
+extern const svdrp_transport_t svdrp_transport_tcp;
+
+/** \brief Unix-domain socket transport: the host is the socket path. */
+extern const svdrp_transport_t svdrp_transport_unix;
+
+/**
+ * \brief In-memory transport, its data being an svdrp_memory_pipe_t.
+ *
+ * No system call is made: commands are handed to the pipe handler as they
+ * are written and its replies are read back from memory.
+ */
+extern const svdrp_transport_t svdrp_transport_memory;
+
+/** \brief Server end of the in-memory transport. */
+typedef struct svdrp_memory_pipe_s svdrp_memory_pipe_t;
+
+/**
+ * \brief Callback playing VDR on an in-memory pipe.
+ *
+ * \param[in] data        user data given along with the callback
+ * \param[in] pipe        the pipe, to reply with svdrp_memory_pipe_reply()
+ * \param[in] cmd         command line, without line terminator, or NULL
+ *                        when a connection opens and a banner is expected
+ * \param[in] len         length of the command line
+ */
+typedef void (*svdrp_memory_handler_t) (void *data, svdrp_memory_pipe_t *pipe,
+                                        const char *cmd, size_t len);
+
 /**
  * \name SVDRP (Un)Initialization.
  * @{
@@ -175,9 +637,30 @@ typedef struct svdrp_timer_s {
  * \return SVDRP connection object or NULL.
  *
  * Creates a new SVDRP connection object and returns it. In case of errors, NULL is returned.
+ *
+ * The timeout, in seconds, bounds the establishment of the connection as
+ * well as every command as a whole, from sending it to the end of its
+ * reply.
  */
 svdrp_t *svdrp_open(char* host, int port, int timeout, svdrp_verbosity_level_t verbosity);
 
+/**
+ * \brief Initialize a new non-blocking SVDRP connection.
+ *
+ * \param[in] host         host name of target VDR.
+ * \param[in] port         SVDRP port.
+ * \param[in] timeout      connection timeout.
+ * \param[in] verbosity    level of verbosity to set.
+ * \return SVDRP connection object or NULL.
+ *
+ * Creates a new SVDRP connection object meant to be driven from an event
+ * loop, and starts connecting in the background. The caller waits for the
+ * events returned by svdrp_get_io_events() on svdrp_get_fd(), then calls
+ * svdrp_process_io(). Commands are issued with svdrp_command_async();
+ * blocking functions cannot be used on such a connection.
+ */
+svdrp_t *svdrp_open_async(char* host, int port, int timeout, svdrp_verbosity_level_t verbosity);
+
 /**
  * \brief Close an SVDRP connection.
  *
@@ -209,6 +692,57 @@ int svdrp_try_connect(svdrp_t *svdrp);
  */
 int svdrp_is_connected(svdrp_t *svdrp);
 
+/**
+ * \brief Set how long resolved addresses are kept.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] ttl          lifetime in seconds, 0 to resolve on every connection
+ *
+ * The host name is resolved once and its addresses are reused by the
+ * following reconnections until they expire, SVDRP_DEFAULT_RESOLVE_TTL
+ * seconds by default. IPv6 and IPv4 addresses are tried in parallel, each
+ * new attempt starting shortly after the previous one if it has not
+ * completed yet. A non-blocking connection tries them in turn instead,
+ * each getting an equal share of the time left, so that one dropping the
+ * packets does not use up the whole timeout.
+ */
+void svdrp_set_resolve_ttl(svdrp_t *svdrp, int ttl);
+
+/**
+ * \brief Get the cause of the last failure.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \return                 the error of the last command, SVDRP_ERR_NONE if
+ *                         it succeeded
+ *
+ * Commands returning SVDRP_ERROR tell whether VDR rejected them or whether
+ * the connection failed; in the latter case, this gives the reason, such
+ * as SVDRP_ERR_TIMEOUT when the timeout given to svdrp_open() expired.
+ */
+svdrp_error_t svdrp_get_error(svdrp_t *svdrp);
+
+/**
+ * \brief Get a description of an error.
+ *
+ * \param[in] error        an error code
+ * \return                 a static string describing the error
+ */
+const char *svdrp_strerror(svdrp_error_t error);
+
+/**
+ * \brief Get the last line of the reply to the last command.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[out] code        reply code of the line, SVDRP_ERROR if there was
+ *                         no reply; may be NULL
+ * \return                 text of the line, without the reply code prefix,
+ *                         an empty string if there was no reply
+ *
+ * The text is a copy owned by the connection object, valid until the next
+ * command is run or answered on it, or svdrp_close().
+ */
+const char *svdrp_get_last_reply(svdrp_t *svdrp, int *code);
+
 /**
  * \brief Get a property of the VDR server.
  *
@@ -216,10 +750,86 @@ int svdrp_is_connected(svdrp_t *svdrp);
  * \param[in] property     the property to get
  * \return                 the property value
  *
- * Returns the value of a property of the VDR server.
+ * Returns the value of a property of the VDR server, as given in the
+ * banner of the current connection. The string is owned by the connection
+ * object and valid until it reconnects to VDR or svdrp_close().
  */
 const char *svdrp_get_property(svdrp_t *svdrp, svdrp_property_t property);
 
+/**
+ * @}
+ */
+
+/**
+ * \name Transports.
+ * @{
+ */
+
+/**
+ * \brief Initialize a new SVDRP connection over a given transport.
+ *
+ * \param[in] transport    transport to use, e.g. svdrp_transport_unix
+ * \param[in] data         user data passed to the transport operations
+ * \param[in] host         host of target VDR, meaning up to the transport,
+ *                         NULL for the name of the transport
+ * \param[in] port         SVDRP port, if the transport has any use for it
+ * \param[in] timeout      connection timeout.
+ * \param[in] async        non-zero for a non-blocking connection
+ * \param[in] verbosity    level of verbosity to set.
+ * \return SVDRP connection object or NULL.
+ *
+ * Same as svdrp_open(), or svdrp_open_async() when async is set, but the
+ * connection goes through the given transport instead of TCP. The
+ * transport and its data must outlive the connection.
+ */
+svdrp_t *svdrp_open_transport(const svdrp_transport_t *transport, void *data,
+                              char *host, int port, int timeout, int async,
+                              svdrp_verbosity_level_t verbosity);
+
+/**
+ * \brief Create the server end of an in-memory transport.
+ *
+ * \param[in] handler      callback answering the commands
+ * \param[in] data         user data passed to the callback
+ * \return                 pipe object or NULL.
+ *
+ * The pipe serves one connection at a time, a new one starting over
+ * with an empty pipe. The handler is called from within the library
+ * functions writing the commands, pipelined ones being answered one after
+ * the other.
+ */
+svdrp_memory_pipe_t *svdrp_memory_pipe_new(svdrp_memory_handler_t handler,
+                                           void *data);
+
+/**
+ * \brief Destroy the server end of an in-memory transport.
+ *
+ * \param[in] pipe         pipe object
+ */
+void svdrp_memory_pipe_free(svdrp_memory_pipe_t *pipe);
+
+/**
+ * \brief Send raw reply data to the client of an in-memory pipe.
+ *
+ * \param[in] pipe         pipe object
+ * \param[in] buf          reply lines, with their CRLF terminators
+ * \param[in] len          length of buf
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ */
+int svdrp_memory_pipe_reply(svdrp_memory_pipe_t *pipe,
+                            const char *buf, size_t len);
+
+/**
+ * \brief Close the connection of an in-memory pipe, as VDR does after 221.
+ *
+ * \param[in] pipe         pipe object
+ *
+ * The client reads the replies sent so far, then the end of the
+ * connection. A client waiting for a reply that the handler never sends
+ * times out instead.
+ */
+void svdrp_memory_pipe_hangup(svdrp_memory_pipe_t *pipe);
+
 /**
  * @}
  */
@@ -278,8 +888,40 @@ int svdrp_osd_message (svdrp_t *svdrp, const char *msg);
  */
 int svdrp_next_timer_event(svdrp_t *svdrp, int *timer_id, time_t *time);
 
+/**
+ * \brief Get a timer.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] timer_id     the number of the timer
+ * \param[out] timer       the timer
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ *
+ * Every string of the timer is allocated on its own, to be freed by the
+ * caller. svdrp_snapshot_timer() takes them from an arena instead.
+ */
 int svdrp_get_timer(svdrp_t *svdrp, int timer_id, svdrp_timer_t *timer);
 
+/**
+ * \brief Get all the timers at once.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[out] timers      array of timers, NULL if there is none
+ * \param[out] count       number of timers in the array
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ *
+ * Fetches every timer with a single LSTT command. The timers and all their
+ * strings are stored in one allocation, to be released with
+ * svdrp_free_timers().
+ */
+int svdrp_list_timers(svdrp_t *svdrp, svdrp_timer_t **timers, int *count);
+
+/**
+ * \brief Free a timer array returned by svdrp_list_timers().
+ *
+ * \param[in] timers       the timer array
+ */
+void svdrp_free_timers(svdrp_timer_t *timers);
+
 int svdrp_volume_mute (svdrp_t *svdrp);
 int svdrp_volume_up (svdrp_t *svdrp);
 int svdrp_volume_down (svdrp_t *svdrp);
@@ -287,6 +929,1301 @@ int svdrp_volume_set (svdrp_t *svdrp, int volume);
 int svdrp_hit_key(svdrp_t *svdrp, svdrp_key_t key);
 int svdrp_set_remote(svdrp_t *svdrp, int state);
 
+/**
+ * \brief Hit a sequence of keys.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] keys         the keys to hit, in order
+ * \param[in] count        number of keys
+ * \return                 SVDRP_OK if every key was accepted, SVDRP_ERROR
+ *                         otherwise.
+ *
+ * All the keys are sent in a single pipeline.
+ */
+int svdrp_hit_keys(svdrp_t *svdrp, const svdrp_key_t *keys, int count);
+
+/**
+ * \brief Clear the EPG of several channels.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] channels     numbers of the channels to clear
+ * \param[in] count        number of channels
+ * \return                 SVDRP_OK if every channel was cleared, SVDRP_ERROR
+ *                         otherwise.
+ *
+ * All the CLRE commands are sent in a single pipeline.
+ */
+int svdrp_epg_clear_channels(svdrp_t *svdrp, const int *channels, int count);
+
+/**
+ * \brief Send a raw SVDRP command and stream its reply.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] cmd          the command, with or without trailing newline
+ * \param[in] cb           callback invoked for every reply line, or NULL
+ * \param[in] data         user data passed to the callback
+ * \return                 the reply code of the last line, SVDRP_ERROR on
+ *                         failure.
+ *
+ * Lines are handed to the callback as soon as they are read from the
+ * connection, so multi-line replies such as LSTT, LSTC, LSTE, LSTR or HELP
+ * can be consumed in constant memory, whatever their size. If VDR has
+ * closed the connection meanwhile, the command is sent again once over a
+ * new connection.
+ */
+int svdrp_command(svdrp_t *svdrp, const char *cmd,
+                  svdrp_reply_cb_t cb, void *data);
+
+/**
+ * \brief Fetch EPG data and stream it event by event.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] args         LSTE arguments (channel, "now", "at <time>"...),
+ *                         NULL for the whole EPG
+ * \param[in] channel_cb   callback invoked for every channel, or NULL
+ * \param[in] event_cb     callback invoked for every event, or NULL
+ * \param[in] data         user data passed to the callbacks
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ *
+ * Events are delivered while the reply is being read, so that fetching a
+ * complete EPG dump requires memory for one event only.
+ */
+int svdrp_get_epg(svdrp_t *svdrp, const char *args,
+                  svdrp_epg_channel_cb_t channel_cb,
+                  svdrp_epg_event_cb_t event_cb, void *data);
+
+/**
+ * @}
+ */
+
+/**
+ * \name Borrowed views.
+ *
+ * Listings parsed without copying: the strings of a view point into the
+ * line it comes from, i.e. into the receive buffer of the connection, and
+ * are only valid until the next read on it. Walking a listing makes no
+ * allocation. Views to be kept are materialized first.
+ *
+ * VDR writes a ':' inside a name as '|'. Views hold the names as sent,
+ * materialized copies and svdrp_str_unescape() give them back their colons.
+ * @{
+ */
+
+/**
+ * \brief Parse a timer line.
+ *
+ * \param[in] line         LSTT reply line, without its reply code
+ * \param[in] len          length of the line
+ * \param[out] timer       the timer, pointing into line
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ */
+int svdrp_parse_timer(const char *line, size_t len, svdrp_timer_view_t *timer);
+
+/**
+ * \brief Parse a channel line.
+ *
+ * \param[in] line         LSTC reply line, without its reply code
+ * \param[in] len          length of the line
+ * \param[out] channel     the channel, pointing into line
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ */
+int svdrp_parse_channel(const char *line, size_t len,
+                        svdrp_channel_view_t *channel);
+
+/**
+ * \brief Parse a recording line.
+ *
+ * \param[in] line         LSTR reply line, without its reply code
+ * \param[in] len          length of the line
+ * \param[out] recording   the recording, pointing into line
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ */
+int svdrp_parse_recording(const char *line, size_t len,
+                          svdrp_recording_view_t *recording);
+
+/**
+ * \brief Walk the timers.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] cb           callback invoked for every timer
+ * \param[in] data         user data passed to the callback
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ *
+ * Invalid lines are skipped. No timer at all is a success.
+ */
+int svdrp_each_timer(svdrp_t *svdrp, svdrp_timer_view_cb_t cb, void *data);
+
+/**
+ * \brief Walk the channels.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] args         LSTC arguments (number, name...), NULL for all
+ * \param[in] cb           callback invoked for every channel
+ * \param[in] data         user data passed to the callback
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ */
+int svdrp_each_channel(svdrp_t *svdrp, const char *args,
+                       svdrp_channel_view_cb_t cb, void *data);
+
+/**
+ * \brief Walk the recordings.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] cb           callback invoked for every recording
+ * \param[in] data         user data passed to the callback
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ */
+int svdrp_each_recording(svdrp_t *svdrp, svdrp_recording_view_cb_t cb,
+                         void *data);
+
+/**
+ * \brief Copy a string out of a view, turning '|' back into ':'.
+ *
+ * \param[in] str          a string of a view
+ * \param[out] buf         destination buffer, always NUL-terminated
+ * \param[in] size         size of the buffer
+ * \return                 length of the copy, truncated to fit the buffer.
+ */
+size_t svdrp_str_unescape (const svdrp_str_t *str, char *buf, size_t size);
+
+/**
+ * \brief Copy a timer view along with its strings.
+ *
+ * \param[in] timer        a timer view
+ * \return                 an owned copy, its strings NUL-terminated, to be
+ *                         released with svdrp_view_free(); NULL on error.
+ */
+svdrp_timer_view_t *svdrp_timer_materialize(const svdrp_timer_view_t *timer);
+
+/**
+ * \brief Copy a channel view along with its strings.
+ *
+ * \param[in] channel      a channel view
+ * \return                 an owned copy, its strings NUL-terminated, to be
+ *                         released with svdrp_view_free(); NULL on error.
+ */
+svdrp_channel_view_t *svdrp_channel_materialize(const svdrp_channel_view_t *channel);
+
+/**
+ * \brief Copy a recording view along with its strings.
+ *
+ * \param[in] recording    a recording view
+ * \return                 an owned copy, its strings NUL-terminated, to be
+ *                         released with svdrp_view_free(); NULL on error.
+ */
+svdrp_recording_view_t *svdrp_recording_materialize(const svdrp_recording_view_t *recording);
+
+/**
+ * \brief Release a materialized view.
+ *
+ * \param[in] view         a view returned by one of the materialize
+ *                         functions, may be NULL
+ */
+void svdrp_view_free(void *view);
+
+/**
+ * @}
+ */
+
+/**
+ * \name Snapshots.
+ *
+ * A snapshot is the whole content of a listing, copied into an arena:
+ * every struct and string of a refresh is bump-allocated from it and the
+ * whole snapshot goes away with svdrp_arena_reset() or svdrp_arena_free().
+ * Resetting the arena before each refresh reuses its memory, so that
+ * steady refreshes hardly reach malloc().
+ *
+ * On error, the arena may hold part of the snapshot, released along with
+ * the rest.
+ * @{
+ */
+
+/**
+ * \brief Create an arena.
+ *
+ * \param[in] chunk_size   size of the chunks the allocations are carved
+ *                         out of, 0 for the default (64 KiB)
+ * \return                 the arena, NULL on error.
+ */
+svdrp_arena_t *svdrp_arena_new(size_t chunk_size);
+
+/**
+ * \brief Release all the allocations of an arena at once.
+ *
+ * \param[in] arena        an arena
+ *
+ * The chunks are kept, to be reused by the next allocations.
+ */
+void svdrp_arena_reset(svdrp_arena_t *arena);
+
+/**
+ * \brief Free an arena along with all its allocations.
+ *
+ * \param[in] arena        an arena, may be NULL
+ */
+void svdrp_arena_free(svdrp_arena_t *arena);
+
+/**
+ * \brief Allocate from an arena.
+ *
+ * \param[in] arena        an arena
+ * \param[in] size         size of the block
+ * \return                 a block suitably aligned for any type, NULL on
+ *                         error.
+ */
+void *svdrp_arena_alloc(svdrp_arena_t *arena, size_t size);
+
+/**
+ * \brief Copy a string into an arena.
+ *
+ * \param[in] arena        an arena
+ * \param[in] str          the string, may be NULL
+ * \return                 the copy, NULL if str is NULL or on error.
+ */
+char *svdrp_arena_strdup(svdrp_arena_t *arena, const char *str);
+
+/**
+ * \brief Copy the start of a string into an arena.
+ *
+ * \param[in] arena        an arena
+ * \param[in] str          the string, may be NULL
+ * \param[in] len          number of bytes to copy
+ * \return                 the NUL-terminated copy, NULL if str is NULL or on
+ *                         error.
+ */
+char *svdrp_arena_strndup(svdrp_arena_t *arena, const char *str, size_t len);
+
+/**
+ * \brief Get the number of bytes allocated since the last reset.
+ *
+ * \param[in] arena        an arena
+ * \return                 the bytes handed out, alignment included.
+ */
+size_t svdrp_arena_used(svdrp_arena_t *arena);
+
+/**
+ * \brief Get a timer into an arena.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] arena        arena holding the strings of the timer
+ * \param[in] timer_id     the number of the timer
+ * \param[out] timer       the timer
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ */
+int svdrp_snapshot_timer(svdrp_t *svdrp, svdrp_arena_t *arena, int timer_id,
+                         svdrp_timer_t *timer);
+
+/**
+ * \brief Get all the timers into an arena.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] arena        arena holding the snapshot
+ * \param[out] timers      array of timers, NULL if there is none
+ * \param[out] count       number of timers in the array
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ */
+int svdrp_snapshot_timers(svdrp_t *svdrp, svdrp_arena_t *arena,
+                          svdrp_timer_t **timers, int *count);
+
+/**
+ * \brief Get the channels into an arena.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] arena        arena holding the snapshot
+ * \param[in] args         LSTC arguments (number, name...), NULL for all
+ * \param[out] channels    array of channels, NULL if there is none
+ * \param[out] count       number of channels in the array
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ *
+ * The strings of the channels are NUL-terminated, names and providers
+ * with their colons back as in materialized views.
+ */
+int svdrp_snapshot_channels(svdrp_t *svdrp, svdrp_arena_t *arena,
+                            const char *args,
+                            svdrp_channel_view_t **channels, int *count);
+
+/**
+ * \brief Get the recordings into an arena.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] arena        arena holding the snapshot
+ * \param[out] recordings  array of recordings, NULL if there is none
+ * \param[out] count       number of recordings in the array
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ *
+ * The strings of the recordings are NUL-terminated.
+ */
+int svdrp_snapshot_recordings(svdrp_t *svdrp, svdrp_arena_t *arena,
+                              svdrp_recording_view_t **recordings, int *count);
+
+/**
+ * \brief Get EPG data into an arena.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] arena        arena holding the snapshot
+ * \param[in] args         LSTE arguments, NULL for the whole EPG
+ * \param[out] events      array of events, NULL if there is none
+ * \param[out] count       number of events in the array
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ *
+ * The events of a channel share a single copy of it.
+ */
+int svdrp_snapshot_epg(svdrp_t *svdrp, svdrp_arena_t *arena, const char *args,
+                       svdrp_epg_event_t **events, int *count);
+
+/**
+ * @}
+ */
+
+/**
+ * \name Response cache.
+ *
+ * An opt-in read-through cache of the replies to svdrp_command() and to
+ * everything built upon it. Commands are keyed by their exact text: a
+ * repeated LSTT, LSTC or STAT disk within its TTL is answered from memory,
+ * callbacks included, without a round trip to VDR.
+ *
+ * Only the listing commands (HELP, LSTC, LSTD, LSTE, LSTR, LSTT, NEXT,
+ * STAT) are cached, and not when they read relative to the current time:
+ * NEXT rel and LSTE with now, next or at always go to VDR. Any command
+ * changing VDR's state and sent through the same handle, pipelined and
+ * non-blocking ones included, drops the replies it may change: NEWT, MODT
+ * or DELT drop the timers, CLRE or PUTE the EPG, DELR the recordings and
+ * disk usage, and so on. Unknown commands, HITK and PLUG drop everything.
+ * Changes made by other VDR clients only show once the TTL expires.
+ * @{
+ */
+
+/**
+ * \brief Enable the cache of a connection.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] ttl          time to live of the replies, in milliseconds
+ * \param[in] max_size     bytes the cache may hold, 0 for the default
+ *                         (4 MiB); the least recently used replies go first
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ *
+ * The TTL applies to every cacheable verb, svdrp_cache_set_ttl() then
+ * tunes them one by one. Enabling the cache again keeps its content.
+ */
+int svdrp_cache_enable(svdrp_t *svdrp, int ttl, size_t max_size);
+
+/**
+ * \brief Disable the cache of a connection, dropping its content.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ */
+void svdrp_cache_disable(svdrp_t *svdrp);
+
+/**
+ * \brief Set the time to live of the replies to a verb.
+ *
+ * \param[in] svdrp        an SVDRP connection object, its cache enabled
+ * \param[in] verb         the verb, e.g. "STAT"
+ * \param[in] ttl          time to live, in milliseconds, 0 not to cache
+ * \return                 SVDRP_OK on success, SVDRP_ERROR if the cache is
+ *                         disabled or the verb cannot be cached.
+ */
+int svdrp_cache_set_ttl(svdrp_t *svdrp, const char *verb, int ttl);
+
+/**
+ * \brief Drop every cached reply.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ */
+void svdrp_cache_clear(svdrp_t *svdrp);
+
+/**
+ * @}
+ */
+
+/**
+ * \name Keepalive.
+ *
+ * VDR serves a single SVDRP client at a time and drops it after a few
+ * minutes without a command (300 s by default), so the next command of a
+ * long-lived handle pays for a reconnection. With a keepalive, a PING (or
+ * STAT disk on VDR older than 1.7) is sent whenever the connection has
+ * been idle for the interval, and a connection VDR closed anyway is
+ * re-established ahead of the next command.
+ *
+ * Non-blocking handles do it on their own: svdrp_get_io_timeout() wakes
+ * the event loop when a keepalive is due. Blocking handles have no thread
+ * of their own and rely on the application calling svdrp_keepalive()
+ * periodically, from the thread owning the handle; svdrp_command() also
+ * checks the connection before sending.
+ *
+ * Keeping a connection open keeps other SVDRP clients out of VDR, which is
+ * better left to handles serving a single application, like the upstream
+ * of a proxy.
+ * @{
+ */
+
+/**
+ * \brief Set the keepalive interval of a connection.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] interval     idle time before a no-op is sent, in seconds,
+ *                         0 to disable; it must be shorter than VDR's own
+ *                         timeout
+ */
+void svdrp_set_keepalive(svdrp_t *svdrp, int interval);
+
+/**
+ * \brief Keep an idle connection open.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \return                 SVDRP_OK if the connection is usable or the
+ *                         keepalive disabled, SVDRP_ERROR if it could not
+ *                         be re-established.
+ *
+ * Sends the no-op if the connection has been idle for the interval, and
+ * reconnects if VDR closed it. It is cheap when there is nothing to do and
+ * may be called as often as wanted. Neither the cache nor the last reply
+ * and error of the handle are affected.
+ */
+int svdrp_keepalive(svdrp_t *svdrp);
+
+/**
+ * @}
+ */
+
+/**
+ * \name Retry policy.
+ *
+ * A blocking command failing for a reason unrelated to VDR's answer is
+ * sent again, with an exponential backoff between the attempts, as long
+ * as the policy's deadline is not exceeded:
+ * - when it could not be written, or VDR closed the connection (221)
+ *   before answering, any command is retried: VDR never saw it;
+ * - when the connection was lost with the reply still to come, only the
+ *   listings (HELP, LSTC, LSTD, LSTE, LSTR, LSTT, NEXT), PING and STAT
+ *   are, unless retry_writes is set: a NEWT, HITK or MESG may have been
+ *   executed already;
+ * - once a reply line reached the callback, the command is not retried.
+ *
+ * Replies from VDR, errors included, are never retried. After
+ * breaker_threshold connections failed in a row, the circuit breaker opens
+ * and commands fail right away with SVDRP_ERR_UNAVAILABLE, non-blocking
+ * ones included, for breaker_cooldown. A single connection is then
+ * attempted, closing the circuit if it succeeds and opening it again
+ * otherwise. The breaker belongs to the connection object, each multi-host
+ * connection has its own. A pool keeps one breaker per host instead, set
+ * by svdrp_pool_set_retry_policy(), as its connections to a host that is
+ * down are closed and opened again.
+ * @{
+ */
+
+/**
+ * \brief Get the default retry policy.
+ *
+ * \param[out] policy      set to 4 tries, 50 ms of base delay capped at
+ *                         2 s, the connection timeout as deadline, no
+ *                         retry of state changing commands, and a breaker
+ *                         opening for 10 s after 5 failed connections
+ */
+void svdrp_retry_policy_default(svdrp_retry_policy_t *policy);
+
+/**
+ * \brief Set the retry policy of a connection.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] policy       the policy, copied, or NULL for the default one
+ * \return                 SVDRP_OK on success, SVDRP_ERROR if the policy is
+ *                         invalid.
+ *
+ * A new policy closes the circuit breaker.
+ */
+int svdrp_set_retry_policy(svdrp_t *svdrp, const svdrp_retry_policy_t *policy);
+
+/**
+ * \brief Get the retry policy of a connection.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[out] policy      set to the policy of the connection
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ */
+int svdrp_get_retry_policy(svdrp_t *svdrp, svdrp_retry_policy_t *policy);
+
+/**
+ * \brief Tell whether the circuit breaker of a connection is open.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \return                 1 if commands currently fail fast, 0 otherwise.
+ */
+int svdrp_breaker_open(svdrp_t *svdrp);
+
+/**
+ * @}
+ */
+
+/**
+ * \name Command pipelining.
+ * @{
+ */
+
+/**
+ * \brief Create a new command pipeline.
+ *
+ * \param[in] svdrp        the SVDRP connection the commands are sent to
+ * \return                 pipeline object or NULL.
+ */
+svdrp_pipeline_t *svdrp_pipeline_new(svdrp_t *svdrp);
+
+/**
+ * \brief Destroy a command pipeline.
+ *
+ * \param[in] pipeline     a pipeline object
+ */
+void svdrp_pipeline_free(svdrp_pipeline_t *pipeline);
+
+/**
+ * \brief Queue a command in a pipeline.
+ *
+ * \param[in] pipeline     a pipeline object
+ * \param[in] cmd          the command, with or without trailing newline
+ * \param[in] cb           callback invoked for every reply line, or NULL
+ * \param[in] data         user data passed to the callback
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ *
+ * Commands are numbered from 0 in the order they are queued.
+ */
+int svdrp_pipeline_add(svdrp_pipeline_t *pipeline, const char *cmd,
+                       svdrp_reply_cb_t cb, void *data);
+
+/**
+ * \brief Send the queued commands and read their replies.
+ *
+ * \param[in] pipeline     a pipeline object
+ * \return                 SVDRP_OK if every reply was read, SVDRP_ERROR
+ *                         otherwise.
+ *
+ * The commands are written at once, then each reply is streamed to the
+ * callback of its command. A command failing on the VDR side does not
+ * prevent the following replies from being read; use
+ * svdrp_pipeline_status() to check each of them. A connection VDR closed
+ * while idle is reopened first, and a 221 in place of the first reply
+ * has the whole pipeline sent once more, none of it having been executed.
+ */
+int svdrp_pipeline_run(svdrp_pipeline_t *pipeline);
+
+/**
+ * \brief Get the number of commands queued in a pipeline.
+ *
+ * \param[in] pipeline     a pipeline object
+ * \return                 number of commands
+ */
+int svdrp_pipeline_count(svdrp_pipeline_t *pipeline);
+
+/**
+ * \brief Get the reply code of a pipelined command.
+ *
+ * \param[in] pipeline     a pipeline object
+ * \param[in] index        number of the command
+ * \return                 the reply code, SVDRP_ERROR if no reply was read
+ */
+int svdrp_pipeline_status(svdrp_pipeline_t *pipeline, int index);
+
+/**
+ * @}
+ */
+
+/**
+ * \name Non-blocking mode.
+ * @{
+ */
+
+/**
+ * \brief Get the socket of a non-blocking SVDRP connection.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \return                 the file descriptor, -1 if there is no connection
+ *
+ * The descriptor changes whenever the connection is re-established.
+ */
+int svdrp_get_fd(svdrp_t *svdrp);
+
+/**
+ * \brief Get the events to wait for on a non-blocking SVDRP connection.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \return                 a combination of SVDRP_IO_READ and SVDRP_IO_WRITE
+ */
+int svdrp_get_io_events(svdrp_t *svdrp);
+
+/**
+ * \brief Get the time left before a non-blocking operation times out.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \return                 milliseconds to wait at most before calling
+ *                         svdrp_process_io(), -1 if there is no deadline
+ *
+ * Connecting and each command are bounded by the connection timeout. When
+ * the deadline has passed, svdrp_process_io() closes the connection and
+ * the error is SVDRP_ERR_TIMEOUT. An idle connection with a keepalive
+ * wakes up when the no-op is due.
+ */
+int svdrp_get_io_timeout(svdrp_t *svdrp);
+
+/**
+ * \brief Make progress on a non-blocking SVDRP connection.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] events       the SVDRP_IO_READ and SVDRP_IO_WRITE events that
+ *                         occurred on the socket
+ * \return                 SVDRP_OK, or SVDRP_ERROR if the connection has
+ *                         been lost or closed by VDR.
+ *
+ * Completes the connection, writes pending commands and reads the available
+ * replies, invoking the callbacks of the commands concerned. Callbacks may
+ * issue new commands but must not close the connection.
+ */
+int svdrp_process_io(svdrp_t *svdrp, int events);
+
+/**
+ * \brief Issue a command on a non-blocking SVDRP connection.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] cmd          the command, with or without trailing newline
+ * \param[in] cb           callback invoked for every reply line, or NULL
+ * \param[in] done         callback invoked once the reply is complete, or NULL
+ * \param[in] data         user data passed to the callbacks
+ * \return                 SVDRP_OK if the command was queued, SVDRP_ERROR
+ *                         otherwise.
+ *
+ * Commands are sent in order and may be issued before the connection is
+ * established, a closed connection is re-opened first. Pending commands
+ * complete with SVDRP_ERROR if the connection is lost or closed.
+ */
+int svdrp_command_async(svdrp_t *svdrp, const char *cmd,
+                        svdrp_reply_cb_t cb, svdrp_done_cb_t done,
+                        void *data);
+
+/**
+ * @}
+ */
+
+/**
+ * \name Multi-host fan-out.
+ * @{
+ */
+
+/**
+ * \brief Create a new set of SVDRP connections.
+ *
+ * \param[in] timeout      connection and default run timeout, in seconds
+ * \param[in] verbosity    level of verbosity of the connections
+ * \return                 the set or NULL.
+ */
+svdrp_multi_t *svdrp_multi_new(int timeout, svdrp_verbosity_level_t verbosity);
+
+/**
+ * \brief Destroy a set of SVDRP connections, closing all of them.
+ *
+ * \param[in] multi        a set of connections
+ */
+void svdrp_multi_free(svdrp_multi_t *multi);
+
+/**
+ * \brief Add a VDR server to a set.
+ *
+ * \param[in] multi        a set of connections
+ * \param[in] host         host name of target VDR
+ * \param[in] port         SVDRP port
+ * \return                 index of the host in the set, -1 on error.
+ *
+ * A non-blocking connection to the host is started right away.
+ */
+int svdrp_multi_add_host(svdrp_multi_t *multi, char *host, int port);
+
+/**
+ * \brief Get the number of hosts in a set.
+ *
+ * \param[in] multi        a set of connections
+ * \return                 number of hosts
+ */
+int svdrp_multi_count(svdrp_multi_t *multi);
+
+/**
+ * \brief Get the connection to one host of a set.
+ *
+ * \param[in] multi        a set of connections
+ * \param[in] index        index of the host
+ * \return                 the non-blocking SVDRP connection object
+ */
+svdrp_t *svdrp_multi_get(svdrp_multi_t *multi, int index);
+
+/**
+ * \brief Queue a command for every host of a set.
+ *
+ * \param[in] multi        a set of connections
+ * \param[in] cmd          the command
+ * \param[in] cb           callback invoked for every reply line, or NULL
+ * \param[in] data         user data passed to the callback
+ * \return                 SVDRP_OK if the command was queued for every
+ *                         host, SVDRP_ERROR otherwise.
+ */
+int svdrp_multi_command(svdrp_multi_t *multi, const char *cmd,
+                        svdrp_multi_cb_t cb, void *data);
+
+/**
+ * \brief Run the queued commands on all the hosts concurrently.
+ *
+ * \param[in] multi        a set of connections
+ * \param[in] timeout_ms   overall time limit in milliseconds, 0 to use the
+ *                         timeout of the set
+ * \return                 SVDRP_OK if every host replied in time,
+ *                         SVDRP_ERROR otherwise.
+ *
+ * Hosts still busy when the time limit expires are disconnected. The
+ * outcome for each host is given by svdrp_multi_status().
+ */
+int svdrp_multi_run(svdrp_multi_t *multi, int timeout_ms);
+
+/**
+ * \brief Get the reply code of the last command run on one host.
+ *
+ * \param[in] multi        a set of connections
+ * \param[in] index        index of the host
+ * \return                 the reply code, SVDRP_ERROR if there was none
+ */
+int svdrp_multi_status(svdrp_multi_t *multi, int index);
+
+/**
+ * @}
+ */
+
+/**
+ * \name Connection pool.
+ * @{
+ */
+
+/**
+ * \brief Create a new connection pool.
+ *
+ * \param[in] timeout      timeout of the connections, also bounding the
+ *                         wait for a busy host, in seconds
+ * \param[in] verbosity    level of verbosity of the connections
+ * \return                 the pool or NULL.
+ *
+ * A pool may be shared by several threads.
+ */
+svdrp_pool_t *svdrp_pool_new(int timeout, svdrp_verbosity_level_t verbosity);
+
+/**
+ * \brief Destroy a pool, closing all its connections.
+ *
+ * \param[in] pool         a connection pool
+ *
+ * The connections still leased are closed as well.
+ */
+void svdrp_pool_free(svdrp_pool_t *pool);
+
+/**
+ * \brief Set how long a connection may stay idle in a pool.
+ *
+ * \param[in] pool         a connection pool
+ * \param[in] idle_timeout time in seconds, 0 for no limit
+ *
+ * Should be below the SVDRP timeout of VDR, so that VDR never drops a
+ * pooled connection by itself. SVDRP_POOL_DEFAULT_IDLE_TIMEOUT by default.
+ */
+void svdrp_pool_set_idle_timeout(svdrp_pool_t *pool, int idle_timeout);
+
+/**
+ * \brief Set how many connections a pool keeps to a single host.
+ *
+ * \param[in] pool         a connection pool
+ * \param[in] max          maximum number of connections, 1 by default
+ *
+ * VDR serves one SVDRP client at a time, more connections only help with
+ * servers which accept several.
+ */
+void svdrp_pool_set_max_per_host(svdrp_pool_t *pool, int max);
+
+/**
+ * \brief Set the retry policy of the connections of a pool.
+ *
+ * \param[in] pool         a connection pool
+ * \param[in] policy       the policy, copied, or NULL for the default one
+ * \return                 SVDRP_OK on success, SVDRP_ERROR if the policy is
+ *                         invalid.
+ *
+ * Applies to every connection leased from then on. The breaker settings
+ * drive the per-host circuit breaker of the pool, which a new policy
+ * closes.
+ */
+int svdrp_pool_set_retry_policy(svdrp_pool_t *pool,
+                                const svdrp_retry_policy_t *policy);
+
+/**
+ * \brief Lease a connection to a host from a pool.
+ *
+ * \param[in] pool         a connection pool
+ * \param[in] host         host name of target VDR
+ * \param[in] port         SVDRP port
+ * \return                 a connected blocking SVDRP connection object,
+ *                         NULL on error or timeout.
+ *
+ * An idle connection to the host is handed out if there is one. It is
+ * checked first without a round trip: one VDR has closed, or which has
+ * been idle for longer than the idle timeout, is reconnected. Otherwise a
+ * new connection is opened if the host has fewer than the maximum, or the
+ * call waits for one to be returned, up to the timeout of the pool.
+ *
+ * Connections failing to open count against the circuit breaker of the
+ * host: once it is open, the lease fails at once instead of trying VDR
+ * until the cooldown has passed.
+ *
+ * The connection is for the caller alone until svdrp_pool_return(); it
+ * must not be closed with svdrp_close().
+ */
+svdrp_t *svdrp_pool_lease(svdrp_pool_t *pool, char *host, int port);
+
+/**
+ * \brief Return a leased connection to its pool.
+ *
+ * \param[in] pool         a connection pool
+ * \param[in] svdrp        a connection leased from the pool
+ *
+ * The connection stays open for the next lease, whatever the outcome of
+ * the last command; one left closed by an error is reopened on lease.
+ */
+void svdrp_pool_return(svdrp_pool_t *pool, svdrp_t *svdrp);
+
+/**
+ * \brief Close the idle connections of a pool which should not be kept.
+ *
+ * \param[in] pool         a connection pool
+ * \return                 number of connections closed
+ *
+ * Closes the connections idle for longer than the idle timeout and those
+ * VDR has closed. Meant to be called periodically, so that an idle pool
+ * does not keep VDR from serving other clients.
+ */
+int svdrp_pool_prune(svdrp_pool_t *pool);
+
+/**
+ * \brief Get the number of idle connections of a pool.
+ *
+ * \param[in] pool         a connection pool
+ * \return                 connections open and not leased
+ */
+int svdrp_pool_idle(svdrp_pool_t *pool);
+
+/**
+ * @}
+ */
+
+/**
+ * \name Metrics.
+ * @{
+ */
+
+/**
+ * \brief Get the metrics of a connection.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[out] metrics     where to copy the metrics
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ *
+ * Metrics are kept from the creation of the connection object, across
+ * reconnections. Commands sent with svdrp_command(), pipelines and
+ * non-blocking commands are all accounted for.
+ */
+int svdrp_get_metrics(svdrp_t *svdrp, svdrp_metrics_t *metrics);
+
+/**
+ * \brief Reset the metrics of a connection.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ */
+void svdrp_reset_metrics(svdrp_t *svdrp);
+
+/**
+ * \brief Get the upper bound of a latency histogram bucket.
+ *
+ * \param[in] index        a bucket index
+ * \return                 the highest latency of the bucket, in microseconds
+ */
+unsigned long long svdrp_latency_bucket_bound(int index);
+
+/**
+ * \brief Estimate a latency quantile of a command verb.
+ *
+ * \param[in] metrics      metrics of a verb
+ * \param[in] quantile     the quantile, between 0 and 1 (e.g. 0.99)
+ * \return                 upper bound in microseconds of the bucket holding
+ *                         the quantile, 0 if there is no data
+ */
+unsigned long long svdrp_latency_quantile(const svdrp_verb_metrics_t *metrics,
+                                          double quantile);
+
+/**
+ * \brief Write metrics in the Prometheus text format.
+ *
+ * \param[in] metrics      metrics of count connections, as given by
+ *                         svdrp_get_metrics()
+ * \param[in] hosts        value of the host label of each connection
+ * \param[in] count        number of connections
+ * \param[in] out          the file to write to
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ *
+ * Verbs which were never sent are left out. The metrics of all the
+ * connections are written at once, as each metric name may only appear in
+ * a single group.
+ */
+int svdrp_metrics_dump_prometheus(const svdrp_metrics_t *metrics,
+                                  const char *const *hosts, int count,
+                                  FILE *out);
+
+/**
+ * @}
+ */
+
+/**
+ * \name Logging.
+ * @{
+ */
+
+/**
+ * \brief Set where the messages of a connection go.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] sink         the sink, NULL for svdrp_log_stderr()
+ * \param[in] data         user data given to the sink
+ *
+ * The sink is called synchronously by the thread logging the message, for
+ * the messages passing the verbosity level of the connection. It must not
+ * use the connection.
+ */
+void svdrp_set_log_sink(svdrp_t *svdrp, svdrp_log_sink_t sink, void *data);
+
+/**
+ * \brief Log sink writing to the standard error.
+ *
+ * \param[in] data         unused
+ * \param[in] record       the message
+ *
+ * This is the default sink.
+ */
+void svdrp_log_stderr(void *data, const svdrp_log_record_t *record);
+
+/**
+ * \brief Create a log ring buffer.
+ *
+ * \param[in] slots        number of messages the ring holds, rounded up to a
+ *                         power of two
+ * \param[in] sink         the sink the messages are drained to, NULL for
+ *                         svdrp_log_stderr()
+ * \param[in] data         user data given to the sink
+ * \return                 a new log ring, NULL on error
+ *
+ * The ring is used by giving svdrp_log_ring_sink() and the ring to
+ * svdrp_set_log_sink(), from any number of connections and threads. Its
+ * thread then calls the sink for every message; the connection of the
+ * record may have been closed in the meantime, it is only an identifier
+ * and must not be dereferenced.
+ * Messages longer than SVDRP_LOG_RING_MESSAGE_SIZE are truncated.
+ */
+svdrp_log_ring_t *svdrp_log_ring_new(size_t slots,
+                                     svdrp_log_sink_t sink, void *data);
+
+/**
+ * \brief Destroy a log ring buffer.
+ *
+ * \param[in] ring         a log ring
+ *
+ * The pending messages are drained before the thread stops. No connection
+ * may log to the ring anymore.
+ */
+void svdrp_log_ring_free(svdrp_log_ring_t *ring);
+
+/**
+ * \brief Log sink queueing the messages into a ring buffer.
+ *
+ * \param[in] data         the log ring
+ * \param[in] record       the message
+ *
+ * It never blocks: when the ring is full, the message is dropped.
+ */
+void svdrp_log_ring_sink(void *data, const svdrp_log_record_t *record);
+
+/**
+ * \brief Get the number of messages a log ring has dropped.
+ *
+ * \param[in] ring         a log ring
+ * \return                 count of messages lost because the ring was full
+ */
+unsigned long svdrp_log_ring_dropped(svdrp_log_ring_t *ring);
+
+/**
+ * @}
+ */
+
+/**
+ * \name Session capture.
+ * @{
+ */
+
+/**
+ * \brief Start recording the traffic of an SVDRP connection.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] path         file to write the capture to, truncated
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ *
+ * Every byte sent and received from now on is written to the file along
+ * with its timing, as well as the reconnections. The capture can be
+ * played back with svdrp_open_replay(), e.g. to reproduce an issue or to
+ * benchmark the parsers without a VDR. A recording already in progress is
+ * stopped first.
+ */
+int svdrp_record_start(svdrp_t *svdrp, const char *path);
+
+/**
+ * \brief Stop recording the traffic of an SVDRP connection.
+ *
+ * \param[in] svdrp        an SVDRP connection object
+ */
+void svdrp_record_stop(svdrp_t *svdrp);
+
+/**
+ * \brief Open a connection to a recorded session.
+ *
+ * \param[in] path         capture written by svdrp_record_start()
+ * \param[in] flags        SVDRP_REPLAY_REALTIME, SVDRP_REPLAY_ASYNC or 0
+ * \param[in] verbosity    level of verbosity to set.
+ * \return SVDRP connection object or NULL if the capture cannot be read.
+ *
+ * The returned connection behaves like one opened with svdrp_open(), or
+ * svdrp_open_async() with SVDRP_REPLAY_ASYNC, but talks to a background
+ * thread playing VDR's part of the capture: each reply is sent once the
+ * bytes the client had sent before it have come in, right away or, with
+ * SVDRP_REPLAY_REALTIME, with the delay it had in the capture. Each
+ * reconnection moves to the next connection of the capture and fails
+ * once they are all used. The commands are not checked against the
+ * recorded ones, and failed commands are not retried, the capture holding
+ * the retries of the recorded session.
+ */
+svdrp_t *svdrp_open_replay(const char *path, int flags, svdrp_verbosity_level_t verbosity);
+
+/**
+ * \brief Send again the commands of a recorded session.
+ *
+ * \param[in] svdrp        a blocking connection from svdrp_open_replay()
+ * \param[in] cb           callback invoked for every reply line, or NULL
+ * \param[in] data         user data passed to the callback
+ * \return                 SVDRP_OK if every command got a reply,
+ *                         SVDRP_ERROR otherwise.
+ *
+ * Commands recorded as written at once are sent as a pipeline again.
+ */
+int svdrp_replay_run(svdrp_t *svdrp, svdrp_reply_cb_t cb, void *data);
+
+/**
+ * @}
+ */
+
+/**
+ * \name EPG parsing.
+ * @{
+ */
+
+/**
+ * \brief Create a new EPG parser.
+ *
+ * \param[in] channel_cb   callback invoked for every channel, or NULL
+ * \param[in] event_cb     callback invoked for every event, or NULL
+ * \param[in] data         user data passed to the callbacks
+ * \return                 EPG parser object or NULL.
+ */
+svdrp_epg_parser_t *svdrp_epg_parser_new(svdrp_epg_channel_cb_t channel_cb,
+                                         svdrp_epg_event_cb_t event_cb,
+                                         void *data);
+
+/**
+ * \brief Destroy an EPG parser.
+ *
+ * \param[in] parser       an EPG parser object
+ */
+void svdrp_epg_parser_free(svdrp_epg_parser_t *parser);
+
+/**
+ * \brief Feed raw EPG data to a parser.
+ *
+ * \param[in] parser       an EPG parser object
+ * \param[in] buf          data, as received from the network or a file
+ * \param[in] len          size of data
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ *
+ * Data may be split anywhere, incomplete lines are kept until the rest
+ * arrives. SVDRP reply code prefixes ("215-") are skipped.
+ */
+int svdrp_epg_parser_feed(svdrp_epg_parser_t *parser,
+                          const char *buf, size_t len);
+
+/**
+ * \brief Feed a single EPG line to a parser.
+ *
+ * \param[in] parser       an EPG parser object
+ * \param[in] line         the line, without line terminator
+ * \param[in] len          length of the line
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ */
+int svdrp_epg_parser_feed_line(svdrp_epg_parser_t *parser,
+                               const char *line, size_t len);
+
+/**
+ * \brief Fetch EPG data through a parser.
+ *
+ * \param[in] parser       an EPG parser object
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] args         LSTE arguments, NULL for the whole EPG
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ *
+ * Same as svdrp_get_epg() with the callbacks of the parser. A parser
+ * keeps its storage from one fetch to the next, so that refreshing the
+ * EPG with the same parser makes no allocation once it has seen the
+ * largest event.
+ */
+int svdrp_epg_parser_fetch(svdrp_epg_parser_t *parser, svdrp_t *svdrp,
+                           const char *args);
+
+/**
+ * \brief Copy an EPG event along with its channel, components and strings.
+ *
+ * \param[in] event        an event handed to an event callback
+ * \return                 an owned copy, to be released with
+ *                         svdrp_view_free(); NULL on error.
+ */
+svdrp_epg_event_t *svdrp_epg_event_materialize(const svdrp_epg_event_t *event);
+
+/**
+ * @}
+ */
+
+/**
+ * \name EPG index.
+ *
+ * The index holds what the fetches returned: fetching the whole EPG
+ * replaces it, fetching a channel (e.g. "S19.2E-1-1101-28106") replaces
+ * the schedule of that channel and keeps the others. The index only holds
+ * whole schedules: the time filters now, next and at are refused, as they
+ * would leave a channel with a single event. A failed fetch leaves the
+ * index as it was.
+ *
+ * Channels are designated by their ID, as in svdrp_epg_channel_t. The
+ * events returned are owned by the index and remain valid until their
+ * channel is fetched again, or the index is cleared or freed. An index is
+ * not locked: queries may run concurrently with each other, not with a
+ * fetch.
+ * @{
+ */
+
+/**
+ * \brief Create an empty EPG index.
+ *
+ * \return                 EPG index object or NULL.
+ */
+svdrp_epg_index_t *svdrp_epg_index_new(void);
+
+/**
+ * \brief Destroy an EPG index.
+ *
+ * \param[in] index        an EPG index object
+ */
+void svdrp_epg_index_free(svdrp_epg_index_t *index);
+
+/**
+ * \brief Drop every channel and event of an EPG index.
+ *
+ * \param[in] index        an EPG index object
+ */
+void svdrp_epg_index_clear(svdrp_epg_index_t *index);
+
+/**
+ * \brief Fill an EPG index from VDR.
+ *
+ * \param[in] index        an EPG index object
+ * \param[in] svdrp        an SVDRP connection object
+ * \param[in] args         LSTE arguments, NULL for the whole EPG; a channel
+ *                         but no now, next or at
+ * \return                 SVDRP_OK on success, SVDRP_ERROR otherwise.
+ */
+int svdrp_epg_index_fetch(svdrp_epg_index_t *index, svdrp_t *svdrp,
+                          const char *args);
+
+/**
+ * \brief Get the number of channels of an EPG index.
+ *
+ * \param[in] index        an EPG index object
+ * \return                 the number of channels, in the order of VDR.
+ */
+int svdrp_epg_index_channels(svdrp_epg_index_t *index);
+
+/**
+ * \brief Get a channel of an EPG index.
+ *
+ * \param[in] index        an EPG index object
+ * \param[in] i            position of the channel, from 0 to
+ *                         svdrp_epg_index_channels() - 1
+ * \return                 the channel, NULL if out of range.
+ */
+const svdrp_epg_channel_t *svdrp_epg_index_get_channel(svdrp_epg_index_t *index,
+                                                        int i);
+
+/**
+ * \brief Get all the events of a channel.
+ *
+ * \param[in] index        an EPG index object
+ * \param[in] channel_id   ID of the channel
+ * \param[out] events      set to the events sorted by start time, may be
+ *                         NULL
+ * \return                 the number of events, 0 for an unknown channel.
+ */
+int svdrp_epg_index_events(svdrp_epg_index_t *index, const char *channel_id,
+                           const svdrp_epg_event_t **events);
+
+/**
+ * \brief Get the event running on a channel at a given time.
+ *
+ * \param[in] index        an EPG index object
+ * \param[in] channel_id   ID of the channel
+ * \param[in] t            the time, e.g. time (NULL) for "now"
+ * \return                 the event, NULL if there is none.
+ */
+const svdrp_epg_event_t *svdrp_epg_index_at(svdrp_epg_index_t *index,
+                                            const char *channel_id, time_t t);
+
+/**
+ * \brief Get the first event starting on a channel after a given time.
+ *
+ * \param[in] index        an EPG index object
+ * \param[in] channel_id   ID of the channel
+ * \param[in] t            the time, e.g. time (NULL) for "next"
+ * \return                 the event, NULL if there is none.
+ */
+const svdrp_epg_event_t *svdrp_epg_index_next(svdrp_epg_index_t *index,
+                                              const char *channel_id, time_t t);
+
+/**
+ * \brief Get the events airing on a channel within a time range.
+ *
+ * \param[in] index        an EPG index object
+ * \param[in] channel_id   ID of the channel
+ * \param[in] from         start of the range
+ * \param[in] to           end of the range, excluded
+ * \param[out] events      set to the first event, the others follow it in
+ *                         the array; may be NULL
+ * \return                 the number of events, from the one running at
+ *                         from, if any, to the last one starting before to.
+ */
+int svdrp_epg_index_range(svdrp_epg_index_t *index, const char *channel_id,
+                          time_t from, time_t to,
+                          const svdrp_epg_event_t **events);
+
 /**
  * @}
  */
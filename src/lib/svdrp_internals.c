@@ -20,55 +20,196 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
 #include <netdb.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "svdrp.h"
 #include "svdrp_internals.h"
 #include "logs.h"
 #include "utils.h"
+#include "commands.h"
+#include "fields.h"
 
-#define SVDRP_MAX_TRIES 10
-#define MAXLINE 1024
 
-static char* svdrp_read(svdrp_t *svdrp)
+/* connection attempts racing each other, and delay between their starts */
+#define SVDRP_MAX_ATTEMPTS 8
+#define SVDRP_ATTEMPT_DELAY 250
+
+void svdrp_set_error (svdrp_t *svdrp, svdrp_error_t error)
+{
+    /* keep the root cause, not the failures it leads to */
+    if (svdrp->error == SVDRP_ERR_NONE || error == SVDRP_ERR_NONE)
+        svdrp->error = error;
+
+    if (error == SVDRP_ERR_TIMEOUT)
+        svdrp->metrics.timeouts++;
+}
+
+/* the receive buffer moves on with the next read, the reply is copied */
+void svdrp_set_last_reply (svdrp_t *svdrp, int code,
+                           const char *text, size_t len)
+{
+    svdrp->last_reply_code = code;
+
+    if (strbuf_set (&svdrp->last_reply, text, len) < 0 && svdrp->last_reply.data)
+        svdrp->last_reply.data[0] = '\0';
+}
+
+/* wait for the socket until the deadline of the current operation */
+static int svdrp_wait (svdrp_t *svdrp, short events)
+{
+    struct pollfd pfd;
+    int ret, timeout = -1;
+
+    pfd.fd = svdrp->conn;
+    pfd.events = events;
+
+    do {
+        if (svdrp->deadline) {
+            long long left = svdrp->deadline - monotonic_ms ();
+            timeout = left > 0 ? left : 0;
+        }
+        ret = poll (&pfd, 1, timeout);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret == 0) {
+        svdrp_log (svdrp, SVDRP_MSG_WARNING, "Timeout");
+        svdrp_set_error (svdrp, SVDRP_ERR_TIMEOUT);
+        return -1;
+    }
+
+    return ret < 0 ? -1 : 0;
+}
+
+static ssize_t svdrp_read(svdrp_t *svdrp, char **line)
 {
-    char* buf;
-    char line[MAXLINE];
-    int len;
+    ssize_t len;
 
     svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
 
-    len = readline (svdrp->conn, &line, MAXLINE);
+    for (;;) {
+        len = readline (svdrp->conn, &svdrp->rbuf, line);
+        if (len >= 0)
+            return len;
 
-    buf = calloc(1, len+1);
-    strncpy(buf, line, len);
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            svdrp_set_error (svdrp, errno == ECONNRESET ?
+                             SVDRP_ERR_CLOSED : SVDRP_ERR_IO);
+            return -1;
+        }
 
-    return buf;
+        if (svdrp_wait (svdrp, POLLIN) < 0)
+            return -1;
+    }
 }
 
+/* "name SVDRP VideoDiskRecorder version; date; charset" */
 static void svdrp_parse_banner(svdrp_t *svdrp, const char *banner)
 {
-    char name[256], version[256], charset[256];
+    svdrp_str_t parts[3] = { { NULL, 0 } }, words[4] = { { NULL, 0 } };
+    svdrp_str_t charset[2] = { { NULL, 0 } };
+    int count;
 
     svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
 
-    sscanf(banner, "%s SVDRP VideoDiskRecorder %[^;]; %*[^;]; %s",
-           name, version, charset);
+    count = svdrp_fields_split (banner, strlen (banner), ';', parts, 3);
+    if (svdrp_fields_split (parts[0].ptr, parts[0].len, ' ', words, 4) < 4) {
+        words[0].ptr = words[3].ptr = NULL;
+        words[0].len = words[3].len = 0;
+    }
+
+    /* the charset is only sent from VDR 1.7.11 on */
+    if (count == 3) {
+        while (parts[2].len && *parts[2].ptr == ' ') {
+            parts[2].ptr++;
+            parts[2].len--;
+        }
+        svdrp_fields_split (parts[2].ptr, parts[2].len, ' ', charset, 2);
+        if (!charset[0].len)
+            charset[0].ptr = NULL;
+    }
 
-    svdrp->name = strdup (name);
-    svdrp->version = strdup (version);
-    svdrp->charset = strdup (charset);
+    /* every connection brings its banner, the previous one goes away */
+    if (!svdrp->banner)
+        svdrp->banner = svdrp_arena_new (256);
+    if (!svdrp->banner) {
+        svdrp_log (svdrp, SVDRP_MSG_ERROR, "Cannot keep the banner properties");
+        svdrp->name = svdrp->version = svdrp->charset = NULL;
+        return;
+    }
+    svdrp_arena_reset (svdrp->banner);
+
+    svdrp->name = svdrp_arena_strndup (svdrp->banner, words[0].ptr, words[0].len);
+    svdrp->version = svdrp_arena_strndup (svdrp->banner, words[3].ptr, words[3].len);
+    svdrp->charset = svdrp_arena_strndup (svdrp->banner, charset[0].ptr, charset[0].len);
 }
 
-svdrp_reply_code_t svdrp_read_reply(svdrp_t *svdrp)
+static void svdrp_handle_line(svdrp_t *svdrp, svdrp_reply_code_t code,
+                              char *text)
+{
+    switch (code)
+    {
+    case SVDRP_REPLY_HELP:
+    case SVDRP_REPLY_EPG_DATA:
+    case SVDRP_REPLY_EPG_START:
+    case SVDRP_REPLY_ABORT:
+    case SVDRP_REPLY_UNKNOWN_CMD:
+    case SVDRP_REPLY_UNKNOWN_PARAM:
+    case SVDRP_REPLY_UNIMPEMENTED_CMD:
+    case SVDRP_REPLY_UNIMPEMENTED_PARAM:
+    case SVDRP_REPLY_ACTION_NOT_TAKEN:
+    case SVDRP_REPLY_TRANSACTION_FAILED:
+    case SVDRP_REPLY_GRAB_DATA:
+    case SVDRP_REPLY_PLUGIN:
+        /* handed to the caller as is */
+        break;
+    case SVDRP_REPLY_QUIT:
+        svdrp_log (svdrp, SVDRP_MSG_VERBOSE, "Vdr closed control connection");
+        if (svdrp->verb != SVDRP_VERB_QUIT)
+            svdrp->metrics.server_closes++;
+        svdrp_set_error (svdrp, SVDRP_ERR_CLOSED);
+        svdrp_close_conn(svdrp);
+        break;
+    case SVDRP_REPLY_READY:
+        svdrp_parse_banner(svdrp, text);
+        svdrp_log (svdrp, SVDRP_MSG_INFO, "Connected to VDR %s on %s (%s)", svdrp->version, svdrp->name, svdrp->charset);
+        break;
+    case SVDRP_REPLY_OK:
+        svdrp_log (svdrp, SVDRP_MSG_INFO, "Operation successfully completed");
+        break;
+    default:
+        svdrp_log (svdrp, SVDRP_MSG_VERBOSE, "Unknown return code: %i", code);
+    }
+}
+
+int svdrp_process_line(svdrp_t *svdrp, char *line, size_t len,
+                       svdrp_reply_code_t *code, char **text)
 {
-    char *line;
     char strcode[4]={0,0,0,0};
+
+    strncpy(strcode, line, 3);
+    *code = atoi (strcode);
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, "vdr reply was: code %i, %s", *code, line);
+
+    *text = len > 3 ? line + 4 : line + len;
+
+    svdrp_handle_line(svdrp, *code, *text);
+
+    return (len > 3 && line[3] == '-');
+}
+
+svdrp_reply_code_t svdrp_read_reply_lines(svdrp_t *svdrp,
+                                          svdrp_reply_cb_t cb, void *data)
+{
+    char *line, *text;
+    ssize_t len;
     svdrp_reply_code_t code;
     int read_next;
 
@@ -84,100 +225,278 @@ svdrp_reply_code_t svdrp_read_reply(svdrp_t *svdrp)
     }
 
     do {
-        line = svdrp_read(svdrp);
-        strncpy(strcode, line, 3);
-        code = atoi (strcode);
-        svdrp_log (svdrp, SVDRP_MSG_VERBOSE, "vdr reply was: code %i, %s", code, line);
-
-        switch (code)
-        {
-        case SVDRP_REPLY_HELP:
-        case SVDRP_REPLY_EPG_DATA:
-        case SVDRP_REPLY_EPG_START:
-        case SVDRP_REPLY_ABORT:
-        case SVDRP_REPLY_UNKNOWN_CMD:
-        case SVDRP_REPLY_UNKNOWN_PARAM:
-        case SVDRP_REPLY_UNIMPEMENTED_CMD:
-        case SVDRP_REPLY_UNIMPEMENTED_PARAM:
-        case SVDRP_REPLY_ACTION_NOT_TAKEN:
-        case SVDRP_REPLY_TRANSACTION_FAILED:
-        case SVDRP_REPLY_GRAB_DATA:
-        case SVDRP_REPLY_PLUGIN:
-            /* not implemented */
-            break;
-        case SVDRP_REPLY_QUIT:
-            svdrp_log (svdrp, SVDRP_MSG_VERBOSE, "Vdr closed control connection");
+        len = svdrp_read(svdrp, &line);
+        if (len < 0) {
+            svdrp_log (svdrp, SVDRP_MSG_WARNING, "Read failed");
             svdrp_close_conn(svdrp);
-            break;
-        case SVDRP_REPLY_READY:
-            svdrp_parse_banner(svdrp, line + 4);
-            svdrp_log (svdrp, SVDRP_MSG_INFO, "Connected to VDR %s on %s (%s)", svdrp->version, svdrp->name, svdrp->charset);
-            break;
-        case SVDRP_REPLY_OK:
-            svdrp_log (svdrp, SVDRP_MSG_INFO, "Operation successfully completed");
-            break;
-        default:
-            svdrp_log (svdrp, SVDRP_MSG_VERBOSE, "Unknown return code: %i", code);
+            return SVDRP_ERROR;
         }
 
-        if (line[3] == '-') {
-            read_next = 1;
-            free(line);
-        } else {
-            read_next = 0;
-        }
+        read_next = svdrp_process_line(svdrp, line, len, &code, &text);
+
+        if (cb && code != SVDRP_REPLY_QUIT)
+            cb(data, code, text, line + len - text, !read_next);
     } while (read_next);
 
-    svdrp->last_reply_code = code;
-    svdrp->last_reply = line + 4;
+    svdrp_set_last_reply (svdrp, code, text, line + len - text);
 
     return code;
 }
 
-int svdrp_open_conn (svdrp_t *svdrp)
+svdrp_reply_code_t svdrp_read_reply(svdrp_t *svdrp)
 {
-    struct sockaddr_in addr;
-    struct hostent *host;
-    int s;
+    return svdrp_read_reply_lines(svdrp, NULL, NULL);
+}
 
-    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+void svdrp_resolve_clear (svdrp_t *svdrp)
+{
+    free (svdrp->addrs);
+    svdrp->addrs = NULL;
+    svdrp->addrs_count = 0;
+    svdrp->addrs_next = 0;
+    svdrp->addrs_expire = 0;
+}
 
-    if (!svdrp)
+int svdrp_resolve (svdrp_t *svdrp)
+{
+    struct addrinfo hints, *res, *ai;
+    char port[16];
+    int i, n, err, family;
+
+    if (svdrp->addrs && monotonic_ms () < svdrp->addrs_expire)
         return 0;
 
-    s = socket (AF_INET, SOCK_STREAM, 0);
+    svdrp_resolve_clear (svdrp);
+
+    memset (&hints, 0, sizeof (hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+    snprintf (port, sizeof (port), "%i", svdrp->port);
+
+    err = getaddrinfo (svdrp->host, port, &hints, &res);
+    if (err) {
+        svdrp_log (svdrp, SVDRP_MSG_ERROR, "Cannot resolve %s: %s",
+                   svdrp->host, gai_strerror (err));
+        svdrp_set_error (svdrp, SVDRP_ERR_RESOLVE);
+        return -1;
+    }
+
+    for (n = 0, ai = res; ai; ai = ai->ai_next)
+        n++;
+
+    svdrp->addrs = calloc (n, sizeof (svdrp_addr_t));
+    if (!svdrp->addrs) {
+        freeaddrinfo (res);
+        svdrp_set_error (svdrp, SVDRP_ERR_RESOLVE);
+        return -1;
+    }
+
+    /* alternate the families, so that a broken one only delays the other */
+    family = res->ai_family;
+    for (i = 0; i < n; i++) {
+        svdrp_addr_t *addr = &svdrp->addrs[i];
+
+        for (ai = res; ai; ai = ai->ai_next)
+            if (ai->ai_addrlen && ai->ai_family == family)
+                break;
+        if (!ai)
+            for (ai = res; !ai->ai_addrlen; ai = ai->ai_next)
+                ;
+
+        addr->family = ai->ai_family;
+        addr->len = ai->ai_addrlen;
+        memcpy (&addr->addr, ai->ai_addr, ai->ai_addrlen);
+        ai->ai_addrlen = 0;       /* taken */
+
+        family = addr->family == AF_INET6 ? AF_INET : AF_INET6;
+    }
+
+    freeaddrinfo (res);
+
+    svdrp->addrs_count = n;
+    svdrp->addrs_expire = monotonic_ms () + svdrp->resolve_ttl * 1000LL;
+
+    return 0;
+}
+
+int svdrp_connect_addr (svdrp_t *svdrp, const svdrp_addr_t *addr)
+{
+    char name[NI_MAXHOST];
+    int s;
+
+    if (getnameinfo ((const struct sockaddr *) &addr->addr, addr->len,
+                     name, sizeof (name), NULL, 0, NI_NUMERICHOST))
+        strcpy (name, "?");
+
+    svdrp_log (svdrp, SVDRP_MSG_INFO, "Opening connection to %s (%s) port %i",
+               svdrp->host, name, svdrp->port);
+
+    s = socket (addr->family, SOCK_STREAM, 0);
     if (s < 0)
-        return 0;
+        return -1;
+
+    /* connect in the background, the timeout is enforced with poll */
+    if (fcntl (s, F_SETFL, fcntl (s, F_GETFL) | O_NONBLOCK) < 0) {
+        close (s);
+        return -1;
+    }
+
+    if (connect (s, (const struct sockaddr *) &addr->addr, addr->len) < 0
+        && errno != EINPROGRESS) {
+        svdrp_log (svdrp, SVDRP_MSG_WARNING, "Connection to %s failed with error %i", name, errno);
+        close (s);
+        return -1;
+    }
+
+    return s;
+}
+
+/* start connecting to the next address, the current attempt being done */
+int svdrp_connect_next (svdrp_t *svdrp)
+{
+    long long now, share;
+    int s = -1;
+
+    while (s < 0 && svdrp->addrs_next < svdrp->addrs_count)
+        s = svdrp_connect_addr (svdrp, &svdrp->addrs[svdrp->addrs_next++]);
 
     /*
-      TODO set socket timeout
-      man setsockopt
-      man 7 socket
-    */
-    host = gethostbyname (svdrp->host);
-
-    if (!host) {
-        svdrp_log (svdrp, SVDRP_MSG_ERROR, "Connection failed (gethostbyname)");
-        return 0;
+     * One address at a time: one silently dropping the packets only gets
+     * its share of the time left, so that the others are tried as well.
+     */
+    svdrp->attempt_deadline = 0;
+    if (s >= 0 && svdrp->addrs_next < svdrp->addrs_count) {
+        now = monotonic_ms ();
+        share = svdrp->deadline ?
+            svdrp->deadline - now : svdrp->timeout * 1000LL;
+        share /= svdrp->addrs_count - svdrp->addrs_next + 1;
+        if (share < SVDRP_ATTEMPT_DELAY)
+            share = SVDRP_ATTEMPT_DELAY;
+        svdrp->attempt_deadline = now + share;
     }
 
-    memcpy (&addr.sin_addr.s_addr, host->h_addr, host->h_length);
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons (svdrp->port);
+    return s;
+}
 
-    svdrp_log (svdrp, SVDRP_MSG_INFO, "Opening connection to %s:%i", svdrp->host, svdrp->port);
+int svdrp_connect_socket (svdrp_t *svdrp)
+{
+    struct pollfd pfd[SVDRP_MAX_ATTEMPTS];
+    long long next_attempt = 0;
+    int i, n = 0, next = 0, s = -1;
 
-    if (connect (s, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        svdrp_log (svdrp, SVDRP_MSG_ERROR, "Connection failed with error %i", errno);
-        return 0;
+    if (svdrp_resolve (svdrp) < 0)
+        return -1;
+
+    /*
+     * Race the addresses: a new attempt starts whenever the previous ones
+     * have failed or have not completed after a short delay, the first
+     * established connection wins.
+     */
+    while (s < 0) {
+        long long now = monotonic_ms ();
+        int ret, timeout;
+
+        if (next < svdrp->addrs_count && n < SVDRP_MAX_ATTEMPTS
+            && (!n || now >= next_attempt)) {
+            int fd = svdrp_connect_addr (svdrp, &svdrp->addrs[next++]);
+
+            if (fd >= 0) {
+                pfd[n].fd = fd;
+                pfd[n].events = POLLOUT;
+                n++;
+            }
+            next_attempt = now + SVDRP_ATTEMPT_DELAY;
+            continue;
+        }
+
+        if (!n)
+            break;
+
+        timeout = -1;
+        if (svdrp->deadline) {
+            if (now >= svdrp->deadline) {
+                svdrp_log (svdrp, SVDRP_MSG_WARNING, "Timeout");
+                svdrp_set_error (svdrp, SVDRP_ERR_TIMEOUT);
+                break;
+            }
+            timeout = svdrp->deadline - now;
+        }
+        if (next < svdrp->addrs_count && n < SVDRP_MAX_ATTEMPTS
+            && (timeout < 0 || next_attempt - now < timeout))
+            timeout = next_attempt - now;
+
+        ret = poll (pfd, n, timeout);
+        if (ret < 0 && errno != EINTR)
+            break;
+
+        for (i = n - 1; ret > 0 && i >= 0; i--) {
+            socklen_t len = sizeof (int);
+            int err = 0;
+
+            if (!pfd[i].revents)
+                continue;
+
+            if (getsockopt (pfd[i].fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+                err = errno;
+
+            if (!err && s < 0)
+                s = pfd[i].fd;
+            else {
+                if (err)
+                    svdrp_log (svdrp, SVDRP_MSG_WARNING, "Connection failed with error %i", err);
+                close (pfd[i].fd);
+            }
+
+            pfd[i] = pfd[--n];
+        }
     }
 
-    svdrp->conn = s;
-    svdrp->is_connected = 1;
+    /* give up on the attempts still in progress */
+    for (i = 0; i < n; i++)
+        close (pfd[i].fd);
 
-    svdrp_read_reply(svdrp);
+    if (s < 0) {
+        svdrp_log (svdrp, SVDRP_MSG_ERROR, "Connection to %s failed", svdrp->host);
+        svdrp_set_error (svdrp, SVDRP_ERR_CONNECT);
+    }
 
-    return 1;
+    return s;
+}
+
+int svdrp_open_conn (svdrp_t *svdrp)
+{
+    int own_deadline;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (!svdrp)
+        return 0;
+
+    if (svdrp->async)
+        return svdrp_async_connect (svdrp);
+
+    if (!svdrp_breaker_allow (svdrp))
+        return 0;
+
+    /* connecting is bounded by the timeout, within the current command */
+    own_deadline = !svdrp->deadline;
+    if (own_deadline)
+        svdrp->deadline = monotonic_ms () + svdrp->timeout * 1000LL;
+
+    if (svdrp_transport_open (svdrp) == SVDRP_OK) {
+        svdrp->is_connected = 1;
+        svdrp->last_activity = monotonic_ms ();
+
+        if (svdrp_read_reply(svdrp) == SVDRP_REPLY_READY && svdrp->is_connected)
+            svdrp_metrics_connected (svdrp);
+    }
+    svdrp_breaker_record (svdrp, svdrp->is_connected);
+
+    if (own_deadline)
+        svdrp->deadline = 0;
+
+    return svdrp->is_connected;
 }
 
 void svdrp_close_conn (svdrp_t *svdrp)
@@ -185,38 +504,112 @@ void svdrp_close_conn (svdrp_t *svdrp)
     svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
     svdrp_log (svdrp, SVDRP_MSG_INFO, "Closing connection");
 
-    close (svdrp->conn);
-
+    svdrp_transport_close (svdrp);
     svdrp->is_connected = 0;
+
+    /* a non-blocking connection failing before the banner */
+    if (svdrp->async && (svdrp->async_state == SVDRP_ASYNC_CONNECTING
+                         || svdrp->async_state == SVDRP_ASYNC_BANNER))
+        svdrp_breaker_record (svdrp, 0);
+
+    if (svdrp->async)
+        svdrp_async_reset (svdrp);
+}
+
+/*
+ * Nothing is due on a connection between two commands: if it turns
+ * readable, VDR has sent its 221 on idle timeout or gone away.
+ */
+int svdrp_conn_alive (svdrp_t *svdrp)
+{
+    struct pollfd pfd;
+
+    if (!svdrp->is_connected)
+        return 0;
+
+    if (svdrp->rbuf.start < svdrp->rbuf.end)
+        return 0;
+
+    if (svdrp->conn < 0)
+        return 1;
+
+    pfd.fd = svdrp->conn;
+    pfd.events = POLLIN;
+
+    return poll (&pfd, 1, 0) == 0;
+}
+
+int svdrp_writev (svdrp_t *svdrp, struct iovec *iov, int iovcnt)
+{
+    const svdrp_transport_t *transport = svdrp->transport;
+    ssize_t ret;
+
+    svdrp_record (svdrp, 'S', iov, iovcnt);
+
+    while (iovcnt > 0) {
+        if (transport->writev)
+            ret = transport->writev (svdrp->transport_data, svdrp->conn, iov, iovcnt);
+        else
+            ret = transport->write (svdrp->transport_data, svdrp->conn,
+                                    iov->iov_base, iov->iov_len);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (svdrp_wait (svdrp, POLLOUT) < 0)
+                    return -1;
+                continue;
+            }
+            svdrp_set_error (svdrp, SVDRP_ERR_IO);
+            return -1;
+        }
+
+        svdrp->bytes_out += ret;
+        svdrp->last_activity = monotonic_ms ();
+
+        /* skip what has been written, resume a partial write */
+        while (iovcnt > 0 && (size_t) ret >= iov->iov_len) {
+            ret -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *) iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+    }
+
+    return 0;
 }
 
 int svdrp_send (svdrp_t *svdrp, const char* cmd)
 {
+    struct iovec iov[2];
+    size_t len;
     int ret;
-    int tries = 0;
 
     svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
 
     if (!svdrp)
         return -1;
 
-    if (!(svdrp->is_connected))
-        svdrp_open_conn (svdrp);
+    /* retrying is up to the caller, see svdrp_retry_wait() */
+    if (!(svdrp->is_connected) && !svdrp_open_conn (svdrp))
+        return -1;
 
-    do {
-        char *logcmd = strdup (cmd);
-        logcmd[strlen(logcmd) - 1] = '\0'; /* strip newline from logged cmd */
-        svdrp_log (svdrp, SVDRP_MSG_INFO, "Sending command: '%s'", logcmd);
-        free (logcmd);
-        tries++;
-        ret = write (svdrp->conn, cmd, strlen (cmd));
-
-        if (ret == -1) {
-            svdrp_log (svdrp, SVDRP_MSG_WARNING, "Write failed");
-            svdrp_close_conn (svdrp);
-            svdrp_open_conn (svdrp);
-        }
-    } while (ret == -1 && tries < SVDRP_MAX_TRIES);
+    len = command_len (cmd);
+    svdrp_log (svdrp, SVDRP_MSG_INFO, "Sending command: '%.*s'", (int) len, cmd);
+
+    iov[0].iov_base = (void *) cmd;
+    iov[0].iov_len = len;
+    iov[1].iov_base = "\n";
+    iov[1].iov_len = 1;
+    ret = svdrp_writev (svdrp, iov, 2);
+
+    if (ret == -1) {
+        svdrp_log (svdrp, SVDRP_MSG_WARNING, "Write failed");
+        svdrp_close_conn (svdrp);
+    }
 
     return ret;
 }
@@ -28,56 +28,190 @@
  * libsvdrp private API functions.
  */
 
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "utils.h"
+
+/** \brief Progress of a non-blocking connection. */
+typedef enum svdrp_async_state {
+    SVDRP_ASYNC_CLOSED,           /**< no connection */
+    SVDRP_ASYNC_CONNECTING,       /**< TCP connection in progress */
+    SVDRP_ASYNC_BANNER,           /**< waiting for the VDR banner */
+    SVDRP_ASYNC_READY,            /**< ready to exchange commands */
+} svdrp_async_state_t;
+
+/** \brief Command sent in non-blocking mode, waiting for its reply. */
+typedef struct svdrp_request_s {
+    svdrp_reply_cb_t cb;
+    svdrp_done_cb_t done;
+    void *data;
+    long long deadline;
+    int verb;
+    long long start;              /* time the request was queued at */
+    unsigned long long bytes_in;
+    size_t bytes_out;
+    int keepalive;                /* sent by the library, not the caller */
+    struct svdrp_request_s *next;
+} svdrp_request_t;
+
+/* a resolved address of the VDR host */
+typedef struct svdrp_addr_s {
+    int family;
+    socklen_t len;
+    struct sockaddr_storage addr;
+} svdrp_addr_t;
+
+/* reply line copied into an arena, the text following the entry */
+typedef struct svdrp_arena_line_s {
+    struct svdrp_arena_line_s *next;
+    size_t len;
+    char *text;
+} svdrp_arena_line_t;
+
+/* lines of a listing gathered by svdrp_arena_line_cb() */
+typedef struct svdrp_arena_lines_s {
+    svdrp_arena_t *arena;
+    svdrp_arena_line_t *head;
+    svdrp_arena_line_t *tail;
+    int count;
+    int error;
+} svdrp_arena_lines_t;
+
+/* response cache of the blocking commands */
+typedef struct svdrp_cache_s svdrp_cache_t;
+
+/* reply being read, copied for the cache on its way to the callback */
+typedef struct svdrp_cache_fill_s {
+    svdrp_reply_cb_t cb;
+    void *data;
+    strbuf_t lines;
+    int error;
+} svdrp_cache_fill_t;
+
+/* a session capture being replayed */
+typedef struct svdrp_replay_s svdrp_replay_t;
+
+/* told about a descriptor about to be closed, while it is still valid */
+typedef void (*svdrp_fd_close_cb_t) (void *data, svdrp_t *svdrp, int fd);
+
 struct svdrp_s {
     svdrp_verbosity_level_t verbosity;
+    svdrp_log_sink_t log_sink;
+    void *log_data;
     char *host;
     int port;
+    svdrp_addr_t *addrs;
+    int addrs_count;
+    int addrs_next;               /* next address to try, non-blocking mode */
+    long long attempt_deadline;   /* end of the current address' turn, in ms,
+                                   * 0 for the last one */
+    long long addrs_expire;
+    int resolve_ttl;
     int timeout;
+    long long deadline;
+    svdrp_error_t error;
     int is_connected;
-    int conn;
+    const svdrp_transport_t *transport;
+    void *transport_data;
+    int conn;                     /* descriptor to wait on, -1 if none */
+    int conn_open;
+    svdrp_fd_close_cb_t fd_close_cb; /* e.g. to leave an epoll set */
+    void *fd_close_data;
+    linebuf_t rbuf;
     int last_reply_code;
-    char *last_reply;
+    strbuf_t last_reply;          /* text of the last line, owned */
     char *name;
     char *version;
     char *charset;
+    svdrp_arena_t *banner;        /* name, version and charset */
+    int async;
+    svdrp_async_state_t async_state;
+    strbuf_t wbuf;
+    size_t wpos;
+    svdrp_request_t *requests;
+    svdrp_request_t *requests_tail;
+    svdrp_metrics_t metrics;
+    int verb;                     /* verb of the command being answered */
+    unsigned long long bytes_out; /* bytes written so far */
+    FILE *record;                 /* session capture being written */
+    long long record_start;
+    svdrp_replay_t *replay;       /* session capture played instead of VDR */
+    svdrp_cache_t *cache;         /* NULL unless enabled */
+    int keepalive;                /* idle time before a no-op, in s, 0 if off */
+    const char *keepalive_cmd;    /* PING, or STAT on VDR without it */
+    long long last_activity;      /* last command sent, in ms */
+    svdrp_retry_policy_t retry;
+    unsigned long long rand_state; /* jitter of the retry delays */
+    int breaker_failures;         /* failed connections in a row */
+    long long breaker_until;      /* end of the open state, in ms, 0 if closed */
 };
 
-/* SVDRP Reply Codes
-Reply codes are in the format
-<Reply code><-|Space><Text><Newline>
-In the last line the "-" is replace be a space.
-
-901..999 Plugin specific reply codes
-*/
-
-/** \brief SVDRP Reply Codes */
-typedef enum svdrp_reply_code {
-    SVDRP_REPLY_HELP               = 214, /**< Help message */
-    SVDRP_REPLY_EPG_DATA           = 215, /**< EPG or recording data record */
-    SVDRP_REPLY_GRAB_DATA          = 216, /**< Image grab data (base 64) */
-    SVDRP_REPLY_READY              = 220, /**< VDR service ready */
-    SVDRP_REPLY_QUIT               = 221, /**< VDR service closing transmission
-                                           *   channel */
-    SVDRP_REPLY_OK                 = 250, /**< Requested VDR action okay,
-                                           *   completed */
-    SVDRP_REPLY_EPG_START          = 354, /**< Start sending EPG data */
-    SVDRP_REPLY_ABORT              = 451, /**< Requested action aborted: local
-                                           *   error in processing */
-    SVDRP_REPLY_UNKNOWN_CMD        = 500, /**< Syntax error, command
-                                           *   unrecognized */
-    SVDRP_REPLY_UNKNOWN_PARAM      = 501, /**< Syntax error in parameters or
-                                           *   arguments */
-    SVDRP_REPLY_UNIMPEMENTED_CMD   = 502, /**< Command not implemented */
-    SVDRP_REPLY_UNIMPEMENTED_PARAM = 504, /**< Command parameter not
-                                           *   implemented */
-    SVDRP_REPLY_ACTION_NOT_TAKEN   = 550, /**< Requested action not taken */
-    SVDRP_REPLY_TRANSACTION_FAILED = 554, /**< Transaction failed */
-    SVDRP_REPLY_PLUGIN             = 900, /**< Default plugin reply code */
-} svdrp_reply_code_t;
-
 svdrp_reply_code_t svdrp_read_reply(svdrp_t *svdrp);
+svdrp_reply_code_t svdrp_read_reply_lines(svdrp_t *svdrp,
+                                          svdrp_reply_cb_t cb, void *data);
+int svdrp_process_line(svdrp_t *svdrp, char *line, size_t len,
+                       svdrp_reply_code_t *code, char **text);
+void svdrp_set_error (svdrp_t *svdrp, svdrp_error_t error);
+void svdrp_set_last_reply (svdrp_t *svdrp, int code,
+                           const char *text, size_t len);
+
+void svdrp_metrics_init (svdrp_metrics_t *metrics);
+void svdrp_metrics_record (svdrp_t *svdrp, int verb, int code,
+                           long long latency,
+                           unsigned long long bytes_in,
+                           unsigned long long bytes_out);
+void svdrp_metrics_connected (svdrp_t *svdrp);
+int svdrp_resolve (svdrp_t *svdrp);
+void svdrp_resolve_clear (svdrp_t *svdrp);
+int svdrp_connect_addr (svdrp_t *svdrp, const svdrp_addr_t *addr);
+int svdrp_connect_socket (svdrp_t *svdrp);
+int svdrp_connect_next (svdrp_t *svdrp);
 int svdrp_open_conn (svdrp_t *svdrp);
 void svdrp_close_conn (svdrp_t *svdrp);
+int svdrp_conn_alive (svdrp_t *svdrp);
 int svdrp_send (svdrp_t *svdrp, const char* cmd);
+int svdrp_writev (svdrp_t *svdrp, struct iovec *iov, int iovcnt);
+int svdrp_async_connect (svdrp_t *svdrp);
+void svdrp_async_reset (svdrp_t *svdrp);
+long long svdrp_async_keepalive_due (svdrp_t *svdrp);
+int svdrp_async_keepalive (svdrp_t *svdrp);
+
+int svdrp_epg_event_copy (svdrp_arena_t *arena, svdrp_epg_event_t *copy,
+                          const svdrp_epg_event_t *event);
+
+void svdrp_retry_init (svdrp_t *svdrp);
+int svdrp_retry_policy_valid (const svdrp_retry_policy_t *policy);
+int svdrp_retry_wait (svdrp_t *svdrp, int verb, int tries, int sent);
+long long svdrp_retry_deadline (svdrp_t *svdrp);
+int svdrp_breaker_allow (svdrp_t *svdrp);
+void svdrp_breaker_record (svdrp_t *svdrp, int connected);
+
+void svdrp_cache_invalidate (svdrp_t *svdrp, int verb);
+int svdrp_cache_replay (svdrp_t *svdrp, const char *cmd, size_t len, int verb,
+                        svdrp_reply_cb_t cb, void *data);
+void svdrp_cache_fill_cb (void *data, int code,
+                          const char *line, size_t len, int last);
+void svdrp_cache_store (svdrp_t *svdrp, const char *cmd, size_t len, int verb,
+                        int code, svdrp_cache_fill_t *fill);
+
+void svdrp_arena_line_cb (void *data, int code,
+                          const char *line, size_t len, int last);
+
+void svdrp_record (svdrp_t *svdrp, char type,
+                   const struct iovec *iov, int iovcnt);
+svdrp_replay_t *svdrp_replay_load (const char *path, int realtime);
+void svdrp_replay_free (svdrp_replay_t *replay);
+
+extern const svdrp_transport_t svdrp_transport_replay;
+
+ssize_t svdrp_fd_read (void *data, int fd, void *buf, size_t len);
+ssize_t svdrp_fd_write (void *data, int fd, const void *buf, size_t len);
+ssize_t svdrp_fd_writev (void *data, int fd, const struct iovec *iov, int iovcnt);
+void svdrp_fd_close (void *data, int fd);
+int svdrp_transport_open (svdrp_t *svdrp);
+void svdrp_transport_close (svdrp_t *svdrp);
+void svdrp_transport_closing (svdrp_t *svdrp);
 
 #endif /* SVDRP_INTERNALS_H */
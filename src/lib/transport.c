@@ -0,0 +1,339 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "svdrp.h"
+#include "svdrp_internals.h"
+#include "logs.h"
+
+ssize_t svdrp_fd_read (void *data, int fd, void *buf, size_t len)
+{
+    (void) data;
+    return read (fd, buf, len);
+}
+
+/*
+ * VDR going away must not raise SIGPIPE: the signal is process-wide and
+ * the caller cannot tell which connection, or thread, it came from.
+ */
+ssize_t svdrp_fd_write (void *data, int fd, const void *buf, size_t len)
+{
+    ssize_t ret;
+
+    (void) data;
+
+    ret = send (fd, buf, len, MSG_NOSIGNAL);
+    if (ret < 0 && errno == ENOTSOCK)
+        ret = write (fd, buf, len);
+
+    return ret;
+}
+
+ssize_t svdrp_fd_writev (void *data, int fd, const struct iovec *iov, int iovcnt)
+{
+    struct msghdr msg;
+    ssize_t ret;
+
+    (void) data;
+
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_iov = (struct iovec *) iov;
+    msg.msg_iovlen = iovcnt;
+
+    ret = sendmsg (fd, &msg, MSG_NOSIGNAL);
+    if (ret < 0 && errno == ENOTSOCK)
+        ret = writev (fd, iov, iovcnt);
+
+    return ret;
+}
+
+void svdrp_fd_close (void *data, int fd)
+{
+    (void) data;
+    close (fd);
+}
+
+static int tcp_open (void *data, svdrp_t *svdrp, int *fd)
+{
+    (void) data;
+
+    if (svdrp->async) {
+        /* resolving blocks, but only once in the lifetime of the addresses */
+        if (svdrp_resolve (svdrp) < 0)
+            return SVDRP_ERROR;
+
+        /* a single descriptor is exposed, so the addresses are tried in turn */
+        svdrp->addrs_next = 0;
+        *fd = svdrp_connect_next (svdrp);
+    }
+    else
+        *fd = svdrp_connect_socket (svdrp);
+
+    return *fd >= 0 ? SVDRP_OK : SVDRP_ERROR;
+}
+
+const svdrp_transport_t svdrp_transport_tcp = {
+    "tcp",
+    tcp_open,
+    svdrp_fd_read,
+    svdrp_fd_write,
+    svdrp_fd_writev,
+    svdrp_fd_close,
+};
+
+static int unix_open (void *data, svdrp_t *svdrp, int *fd)
+{
+    struct sockaddr_un addr;
+    int s;
+
+    (void) data;
+
+    svdrp_log (svdrp, SVDRP_MSG_INFO, "Opening connection to %s", svdrp->host);
+
+    if (strlen (svdrp->host) >= sizeof (addr.sun_path)) {
+        svdrp_log (svdrp, SVDRP_MSG_ERROR, "Socket path too long");
+        return SVDRP_ERROR;
+    }
+
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    strcpy (addr.sun_path, svdrp->host);
+
+    s = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (s < 0)
+        return SVDRP_ERROR;
+
+    /* a local connection is established or refused right away */
+    if (fcntl (s, F_SETFL, fcntl (s, F_GETFL) | O_NONBLOCK) < 0
+        || connect (s, (struct sockaddr *) &addr, sizeof (addr)) < 0) {
+        svdrp_log (svdrp, SVDRP_MSG_ERROR, "Connection to %s failed with error %i",
+                   svdrp->host, errno);
+        close (s);
+        return SVDRP_ERROR;
+    }
+
+    *fd = s;
+
+    return SVDRP_OK;
+}
+
+const svdrp_transport_t svdrp_transport_unix = {
+    "unix",
+    unix_open,
+    svdrp_fd_read,
+    svdrp_fd_write,
+    svdrp_fd_writev,
+    svdrp_fd_close,
+};
+
+struct svdrp_memory_pipe_s {
+    svdrp_memory_handler_t handler;
+    void *data;
+    strbuf_t replies;             /* bytes on their way to the client */
+    size_t rpos;
+    strbuf_t cmd;                 /* incomplete command line */
+    int hangup;
+};
+
+svdrp_memory_pipe_t *svdrp_memory_pipe_new (svdrp_memory_handler_t handler,
+                                            void *data)
+{
+    svdrp_memory_pipe_t *pipe;
+
+    if (!handler)
+        return NULL;
+
+    pipe = calloc (1, sizeof (svdrp_memory_pipe_t));
+    if (!pipe)
+        return NULL;
+
+    pipe->handler = handler;
+    pipe->data = data;
+
+    return pipe;
+}
+
+void svdrp_memory_pipe_free (svdrp_memory_pipe_t *pipe)
+{
+    if (!pipe)
+        return;
+
+    strbuf_free (&pipe->replies);
+    strbuf_free (&pipe->cmd);
+    free (pipe);
+}
+
+int svdrp_memory_pipe_reply (svdrp_memory_pipe_t *pipe,
+                             const char *buf, size_t len)
+{
+    if (!pipe || !buf || pipe->hangup)
+        return SVDRP_ERROR;
+
+    return strbuf_append (&pipe->replies, buf, len) < 0 ? SVDRP_ERROR : SVDRP_OK;
+}
+
+void svdrp_memory_pipe_hangup (svdrp_memory_pipe_t *pipe)
+{
+    if (pipe)
+        pipe->hangup = 1;
+}
+
+static int memory_open (void *data, svdrp_t *svdrp, int *fd)
+{
+    svdrp_memory_pipe_t *pipe = data;
+
+    svdrp_log (svdrp, SVDRP_MSG_INFO, "Opening in-memory connection");
+
+    pipe->replies.len = 0;
+    pipe->rpos = 0;
+    pipe->cmd.len = 0;
+    pipe->hangup = 0;
+
+    /* the banner */
+    pipe->handler (pipe->data, pipe, NULL, 0);
+
+    *fd = -1;
+
+    return SVDRP_OK;
+}
+
+static ssize_t memory_read (void *data, int fd, void *buf, size_t len)
+{
+    svdrp_memory_pipe_t *pipe = data;
+    size_t pending = pipe->replies.len - pipe->rpos;
+
+    (void) fd;
+
+    if (!pending) {
+        if (pipe->hangup)
+            return 0;
+        /* nothing will come, it times out like a silent VDR */
+        errno = EAGAIN;
+        return -1;
+    }
+
+    if (len > pending)
+        len = pending;
+    memcpy (buf, pipe->replies.data + pipe->rpos, len);
+    pipe->rpos += len;
+
+    /* all read, the storage is reused for the next replies */
+    if (pipe->rpos == pipe->replies.len) {
+        pipe->replies.len = 0;
+        pipe->rpos = 0;
+    }
+
+    return len;
+}
+
+static ssize_t memory_write (void *data, int fd, const void *buf, size_t len)
+{
+    svdrp_memory_pipe_t *pipe = data;
+    const char *eol;
+
+    (void) fd;
+
+    if (pipe->hangup) {
+        errno = EPIPE;
+        return -1;
+    }
+
+    if (strbuf_append (&pipe->cmd, buf, len) < 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    /* every complete command is answered right away, in order */
+    while (!pipe->hangup
+           && (eol = memchr (pipe->cmd.data, '\n', pipe->cmd.len))) {
+        size_t used = eol - pipe->cmd.data + 1;
+        size_t n = used - 1;
+
+        if (n && pipe->cmd.data[n - 1] == '\r')
+            n--;
+        pipe->cmd.data[n] = '\0';
+        pipe->handler (pipe->data, pipe, pipe->cmd.data, n);
+
+        memmove (pipe->cmd.data, pipe->cmd.data + used, pipe->cmd.len - used);
+        pipe->cmd.len -= used;
+    }
+
+    return len;
+}
+
+static void memory_close (void *data, int fd)
+{
+    (void) data;
+    (void) fd;
+}
+
+const svdrp_transport_t svdrp_transport_memory = {
+    "memory",
+    memory_open,
+    memory_read,
+    memory_write,
+    NULL,
+    memory_close,
+};
+
+int svdrp_transport_open (svdrp_t *svdrp)
+{
+    int fd = -1;
+
+    if (svdrp->transport->open (svdrp->transport_data, svdrp, &fd) != SVDRP_OK) {
+        svdrp_set_error (svdrp, SVDRP_ERR_CONNECT);
+        return SVDRP_ERROR;
+    }
+
+    svdrp->conn = fd;
+    svdrp->conn_open = 1;
+    linebuf_reset (&svdrp->rbuf);
+    svdrp->rbuf.read = svdrp->transport->read;
+    svdrp->rbuf.read_data = svdrp->transport_data;
+    svdrp_record (svdrp, 'C', NULL, 0);
+
+    return SVDRP_OK;
+}
+
+void svdrp_transport_closing (svdrp_t *svdrp)
+{
+    if (svdrp->fd_close_cb && svdrp->conn >= 0)
+        svdrp->fd_close_cb (svdrp->fd_close_data, svdrp, svdrp->conn);
+}
+
+void svdrp_transport_close (svdrp_t *svdrp)
+{
+    if (svdrp->conn_open) {
+        svdrp_transport_closing (svdrp);
+        svdrp->transport->close (svdrp->transport_data, svdrp->conn);
+    }
+
+    svdrp->conn = -1;
+    svdrp->conn_open = 0;
+}
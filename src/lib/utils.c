@@ -20,62 +20,195 @@
  */
 
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "utils.h"
 
-#define MAXLINE 256
+int linebuf_init(linebuf_t *lb, size_t size)
+{
+    lb->data = malloc (size);
+    if (!lb->data)
+        return -1;
+
+    lb->size = size;
+    lb->consumed = 0;
+    linebuf_reset (lb);
 
-static ssize_t read_wrapper(int fd, char *buf)
+    return 0;
+}
+
+void linebuf_free(linebuf_t *lb)
 {
-    static int count = 0;
-    static char *p;
-    static char read_buf[MAXLINE];
-
-    if (count <= 0) {
-        int keep_reading = 0;
-        do {
-            count = read(fd, read_buf, sizeof(read_buf));
-            if (count < 0) {
-                if (errno == EINTR)
-                    keep_reading = 1;
-                else
-                    return -1;
-            } else if (count == 0) {
-                return 0;
-            }
-            p = read_buf;
-        } while (keep_reading);
+    free (lb->data);
+    lb->data = NULL;
+    lb->size = 0;
+    linebuf_reset (lb);
+}
+
+void linebuf_reset(linebuf_t *lb)
+{
+    lb->start = 0;
+    lb->scan = 0;
+    lb->end = 0;
+}
+
+/* make room at the end of the buffer, compacting or growing it */
+static int linebuf_make_room(linebuf_t *lb)
+{
+    if (lb->start > 0) {
+        size_t pending = lb->end - lb->start;
+
+        memmove (lb->data, lb->data + lb->start, pending);
+        lb->scan -= lb->start;
+        lb->end = pending;
+        lb->start = 0;
+    }
+
+    if (lb->end == lb->size) {
+        size_t size = lb->size * 2;
+        char *data;
+
+        if (size > LINEBUF_MAX_SIZE)
+            return -1;
+
+        data = realloc (lb->data, size);
+        if (!data)
+            return -1;
+
+        lb->data = data;
+        lb->size = size;
     }
 
-    count--;
-    *buf = *p++;
-    return 1;
+    return 0;
 }
 
-int readline(int fd, void *buf, int maxlen)
+/* cut the line ending at eol out of the buffer */
+static ssize_t linebuf_take(linebuf_t *lb, char *eol, char **line)
 {
-    int n, count;
-    char c;
-    char *p = buf;
-
-    for (n = 1; n < maxlen; n++) {
-        count = read_wrapper(fd, &c);
-        if (count == 1) {
-            *p++ = c;
-            if (c == '\n')
-                break;
-        } else if (count == 0) {
-            if (n == 1)
-                return 0;
-            else
-                break;
-        } else {
+    ssize_t len;
+
+    *line = lb->data + lb->start;
+    len = eol - *line;
+
+    lb->start = eol - lb->data + 1;
+    lb->scan = lb->start;
+    lb->consumed += len + 1;
+
+    *eol = '\0';
+    if (len > 0 && (*line)[len - 1] == '\r')
+        (*line)[--len] = '\0';
+
+    return len;
+}
+
+ssize_t readline(int fd, linebuf_t *lb, char **line)
+{
+    ssize_t count;
+    char *eol;
+
+    for (;;) {
+        eol = memchr (lb->data + lb->scan, '\n', lb->end - lb->scan);
+        if (eol)
+            return linebuf_take (lb, eol, line);
+
+        lb->scan = lb->end;
+
+        if (lb->end == lb->size && linebuf_make_room (lb) < 0) {
+            errno = ENOBUFS;
             return -1;
         }
+
+        count = lb->read ? lb->read (lb->read_data, fd, lb->data + lb->end, lb->size - lb->end)
+            : read (fd, lb->data + lb->end, lb->size - lb->end);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        } else if (count == 0) {
+            /* hand out an unterminated last line, if any */
+            if (lb->end == lb->start) {
+                errno = ECONNRESET;
+                return -1;
+            }
+
+            if (lb->end == lb->size && linebuf_make_room (lb) < 0) {
+                errno = ENOBUFS;
+                return -1;
+            }
+            return linebuf_take (lb, lb->data + lb->end++, line);
+        }
+
+        if (lb->tap)
+            lb->tap (lb->tap_data, lb->data + lb->end, count);
+        lb->end += count;
     }
+}
 
-    *p = 0;
-    return n;
+int strbuf_append(strbuf_t *sb, const char *str, size_t len)
+{
+    if (sb->len + len + 1 > sb->size) {
+        size_t size = sb->size ? sb->size : 64;
+        char *data;
+
+        while (size < sb->len + len + 1)
+            size *= 2;
+
+        data = realloc (sb->data, size);
+        if (!data)
+            return -1;
+
+        sb->data = data;
+        sb->size = size;
+    }
+
+    memcpy (sb->data + sb->len, str, len);
+    sb->len += len;
+    sb->data[sb->len] = '\0';
+
+    return 0;
 }
 
+int strbuf_set(strbuf_t *sb, const char *str, size_t len)
+{
+    sb->len = 0;
+    return strbuf_append (sb, str, len);
+}
+
+void strbuf_free(strbuf_t *sb)
+{
+    free (sb->data);
+    sb->data = NULL;
+    sb->len = 0;
+    sb->size = 0;
+}
+
+size_t command_len(const char *cmd)
+{
+    size_t len = strlen (cmd);
+
+    while (len && (cmd[len - 1] == '\n' || cmd[len - 1] == '\r'))
+        len--;
+
+    return len;
+}
+
+long long monotonic_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+long long monotonic_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
@@ -28,15 +28,137 @@
  * libsvdrp internal utility functions.
  */
 
+#include <sys/types.h>
+
+/** \brief Initial size of a connection receive buffer */
+#define LINEBUF_DEFAULT_SIZE (64 * 1024)
+
+/** \brief Maximum size a receive buffer may grow to for a single line */
+#define LINEBUF_MAX_SIZE (4 * 1024 * 1024)
+
+/**
+ * \brief Line-oriented receive buffer.
+ *
+ * Data is read from the socket in bulk and handed out one line at a time,
+ * without copying. Each connection owns its own buffer.
+ */
+typedef struct linebuf_s {
+    char *data;                   /**< Buffer storage */
+    size_t size;                  /**< Allocated size of data */
+    size_t start;                 /**< Offset of the first unconsumed byte */
+    size_t scan;                  /**< Offset where to resume EOL search */
+    size_t end;                   /**< Offset past the last valid byte */
+    unsigned long long consumed;  /**< Bytes of the lines handed out so far */
+    ssize_t (*read)(void *data, int fd, void *buf, size_t len); /**< Replaces read(), if set */
+    void *read_data;              /**< Opaque pointer passed to read */
+    void (*tap)(void *data, const char *buf, size_t len); /**< Sees every chunk read, if set */
+    void *tap_data;               /**< Opaque pointer passed to tap */
+} linebuf_t;
+
+/**
+ * \brief Initialize a receive buffer.
+ *
+ * \param[in] lb          the buffer to initialize
+ * \param[in] size        initial size of the buffer
+ * \return                0 on success, -1 on allocation failure
+ */
+int linebuf_init(linebuf_t *lb, size_t size);
+
+/**
+ * \brief Release the storage of a receive buffer.
+ *
+ * \param[in] lb          the buffer to free
+ */
+void linebuf_free(linebuf_t *lb);
+
+/**
+ * \brief Discard any pending data in a receive buffer.
+ *
+ * \param[in] lb          the buffer to reset
+ */
+void linebuf_reset(linebuf_t *lb);
+
 /**
  * \brief Reads a line from a file.
  *
- * \param[in]  fd          the file descriptor to read from
- * \param[out] buf         buffer where to place the data read
- * \param[in]  maxlen      maximum number of characters to read
+ * \param[in]  fd         the file descriptor to read from
+ * \param[in]  lb         the receive buffer attached to fd
+ * \param[out] line       start of the line, inside lb
+ * \return                length of the line, -1 on error or end of file
+ *
+ * Use to read a full line (up to EOL) from a file. On a non-blocking
+ * descriptor, -1 with errno set to EAGAIN means that no complete line is
+ * available yet; end of file is reported with errno set to ECONNRESET.
+ * The line terminator (LF or CRLF) is replaced by a NUL character. The
+ * returned line points into the receive buffer and is only valid until
+ * the next call.
+ */
+ssize_t readline(int fd, linebuf_t *lb, char **line);
+
+/**
+ * \brief Growable NUL-terminated string buffer.
+ *
+ * The storage is kept across resets, so that reusing a buffer does not
+ * allocate once it has reached its working size.
+ */
+typedef struct strbuf_s {
+    char *data;                   /**< Buffer storage, NUL-terminated */
+    size_t len;                   /**< Length of the string */
+    size_t size;                  /**< Allocated size of data */
+} strbuf_t;
+
+/**
+ * \brief Append data to a string buffer.
+ *
+ * \param[in] sb          the string buffer
+ * \param[in] str         data to append
+ * \param[in] len         length of data
+ * \return                0 on success, -1 on allocation failure
+ */
+int strbuf_append(strbuf_t *sb, const char *str, size_t len);
+
+/**
+ * \brief Replace the content of a string buffer.
+ *
+ * \param[in] sb          the string buffer
+ * \param[in] str         new content
+ * \param[in] len         length of the new content
+ * \return                0 on success, -1 on allocation failure
+ */
+int strbuf_set(strbuf_t *sb, const char *str, size_t len);
+
+/**
+ * \brief Release the storage of a string buffer.
+ *
+ * \param[in] sb          the string buffer
+ */
+void strbuf_free(strbuf_t *sb);
+
+/**
+ * \brief Get the length of a command line without its terminator.
+ *
+ * \param[in] cmd         the command, NUL-terminated
+ * \return                length of cmd without the trailing CR and LF
+ *
+ * Callers may terminate their commands or not; the line is sent with a
+ * single LF of the library's own.
+ */
+size_t command_len(const char *cmd);
+
+/**
+ * \brief Read the monotonic clock.
+ *
+ * \return                current time in milliseconds, from an arbitrary
+ *                        starting point
+ */
+long long monotonic_ms(void);
+
+/**
+ * \brief Read the monotonic clock with a finer resolution.
  *
- * Use to read a full line (up to EOL) from a file.
+ * \return                current time in microseconds, from the same
+ *                        starting point as monotonic_ms()
  */
-int readline(int fd, void *buf, int maxlen);
+long long monotonic_us(void);
 
 #endif /* SVDRP_UTILS_H */
@@ -0,0 +1,582 @@
+/*
+ * GeeXboX libsvdrp: an interface to VDR via SVDRP.
+ * Copyright (C) 2009 Davide Cavalca <davide@geexbox.org>
+ *
+ * This file is part of libsvdrp.
+ *
+ * libsvdrp is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libsvdrp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libsvdrp; if not, write to the Free Software
+ * Foundation, Inc, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "svdrp.h"
+#include "svdrp_internals.h"
+#include "logs.h"
+#include "commands.h"
+#include "fields.h"
+
+/* parse a decimal number, stopping at the first other character */
+static const char *view_num (const char *p, const char *end, int *val)
+{
+    int neg = 0;
+
+    *val = 0;
+    if (p < end && *p == '-') {
+        neg = 1;
+        p++;
+    }
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+        *val = *val * 10 + (*p - '0');
+    if (neg)
+        *val = -*val;
+
+    return p;
+}
+
+int svdrp_parse_timer (const char *line, size_t len, svdrp_timer_view_t *timer)
+{
+    const char *p = line, *end = line + len;
+    svdrp_str_t fields[9];
+    int i;
+
+    if (!line || !timer)
+        return SVDRP_ERROR;
+
+    memset (timer, 0, sizeof (svdrp_timer_view_t));
+
+    p = view_num (p, end, &timer->id);
+    if (p == line || p == end || *p != ' ')
+        return SVDRP_ERROR;
+    p++;
+
+    /* "flags:channel:day:start:stop:priority:lifetime:file:aux" */
+    if (svdrp_fields_split (p, end - p, ':', fields, 9) < 9)
+        return SVDRP_ERROR;
+
+    timer->channel = svdrp_fields_int (&fields[1]);
+    timer->day = fields[2];
+    timer->start = fields[3];
+    timer->stop = fields[4];
+    timer->priority = svdrp_fields_int (&fields[5]);
+    timer->lifetime = svdrp_fields_int (&fields[6]);
+    timer->file = fields[7];
+    timer->data = fields[8];
+
+    i = svdrp_fields_int (&fields[0]);
+    timer->is_active = ((i & SVDRP_TIMER_ACTIVE_FLAG) != 0);
+    timer->is_recording = ((i & SVDRP_TIMER_RECORDING_FLAG) != 0);
+    timer->is_instant = ((i & SVDRP_TIMER_INSTANT_FLAG) != 0);
+    timer->use_vps = ((i & SVDRP_TIMER_VPS_FLAG) != 0);
+
+    if (timer->day.len
+        && (timer->day.ptr[0] == 'M' || timer->day.ptr[0] == '-')) /* repeating timer */
+    {
+        for (i = 0; i < 7 && (size_t) i < timer->day.len; i++)
+            if (timer->day.ptr[i] != '-')
+                timer->repeating |= ((unsigned char) (1 << i));
+
+        if (timer->day.len > 8 && timer->day.ptr[7] == '@') {
+            timer->first_date.ptr = timer->day.ptr + 8;
+            timer->first_date.len = timer->day.len - 8;
+        }
+    }
+    else /* one shot timer */
+        timer->first_date = timer->day;
+
+    return SVDRP_OK;
+}
+
+int svdrp_parse_channel (const char *line, size_t len,
+                         svdrp_channel_view_t *channel)
+{
+    const char *p = line, *end = line + len;
+    svdrp_str_t fields[13];
+    const char *sep;
+
+    if (!line || !channel)
+        return SVDRP_ERROR;
+
+    memset (channel, 0, sizeof (svdrp_channel_view_t));
+
+    p = view_num (p, end, &channel->number);
+    if (p == line || p == end || *p != ' ')
+        return SVDRP_ERROR;
+    p++;
+
+    if (svdrp_fields_split (p, end - p, ':', fields, 13) < 13)
+        return SVDRP_ERROR;
+
+    channel->name = fields[0];
+    channel->frequency = svdrp_fields_int (&fields[1]);
+    channel->parameters = fields[2];
+    channel->source = fields[3];
+    channel->srate = svdrp_fields_int (&fields[4]);
+    channel->vpid = fields[5];
+    channel->apid = fields[6];
+    channel->tpid = fields[7];
+    channel->caid = fields[8];
+    channel->sid = svdrp_fields_int (&fields[9]);
+    channel->nid = svdrp_fields_int (&fields[10]);
+    channel->tid = svdrp_fields_int (&fields[11]);
+    channel->rid = svdrp_fields_int (&fields[12]);
+
+    /* "name,short name;provider" */
+    sep = memchr (channel->name.ptr, ';', channel->name.len);
+    if (sep) {
+        channel->provider.ptr = sep + 1;
+        channel->provider.len = channel->name.ptr + channel->name.len - sep - 1;
+        channel->name.len = sep - channel->name.ptr;
+    }
+
+    return SVDRP_OK;
+}
+
+/* "id dd.mm.yy hh:mm[ h:mm]{*| } name", the length from VDR 1.7.21 on */
+int svdrp_parse_recording (const char *line, size_t len,
+                           svdrp_recording_view_t *recording)
+{
+    const char *p = line, *end = line + len;
+    const char *q;
+
+    if (!line || !recording)
+        return SVDRP_ERROR;
+
+    memset (recording, 0, sizeof (svdrp_recording_view_t));
+
+    p = view_num (p, end, &recording->id);
+    if (p == line || end - p < 16 || *p != ' ')
+        return SVDRP_ERROR;
+
+    recording->date.ptr = p + 1;
+    recording->date.len = 8;
+    recording->time.ptr = p + 10;
+    recording->time.len = 5;
+    p += 15;
+
+    /* an optional length, "h:mm" */
+    if (*p == ' ' && p + 1 < end && p[1] >= '0' && p[1] <= '9') {
+        for (q = p + 1; q < end && ((*q >= '0' && *q <= '9') || *q == ':'); q++)
+            ;
+        if (q < end && (*q == '*' || *q == ' ') && memchr (p + 1, ':', q - p - 1)) {
+            recording->length.ptr = p + 1;
+            recording->length.len = q - p - 1;
+            p = q;
+        }
+    }
+
+    if (p >= end || (*p != '*' && *p != ' '))
+        return SVDRP_ERROR;
+    recording->is_new = *p++ == '*';
+
+    if (p < end && *p == ' ')
+        p++;
+
+    recording->name.ptr = p;
+    recording->name.len = end - p;
+
+    return SVDRP_OK;
+}
+
+/* listing being walked, one callback per parsed line */
+typedef struct view_walk_s {
+    svdrp_t *svdrp;
+    svdrp_verb_t verb;
+    svdrp_timer_view_cb_t timer_cb;
+    svdrp_channel_view_cb_t channel_cb;
+    svdrp_recording_view_cb_t recording_cb;
+    void *data;
+    int count;
+} view_walk_t;
+
+static void view_walk_line (void *data, int code,
+                            const char *line, size_t len, int last)
+{
+    view_walk_t *walk = data;
+    svdrp_timer_view_t timer;
+    svdrp_channel_view_t channel;
+    svdrp_recording_view_t recording;
+    int ret = SVDRP_ERROR;
+
+    (void) last;
+
+    if (code != SVDRP_REPLY_OK)
+        return;
+
+    switch (walk->verb)
+    {
+    case SVDRP_VERB_LSTT:
+        ret = svdrp_parse_timer (line, len, &timer);
+        if (ret == SVDRP_OK && walk->timer_cb)
+            walk->timer_cb (walk->data, &timer);
+        break;
+    case SVDRP_VERB_LSTC:
+        ret = svdrp_parse_channel (line, len, &channel);
+        if (ret == SVDRP_OK && walk->channel_cb)
+            walk->channel_cb (walk->data, &channel);
+        break;
+    case SVDRP_VERB_LSTR:
+        ret = svdrp_parse_recording (line, len, &recording);
+        if (ret == SVDRP_OK && walk->recording_cb)
+            walk->recording_cb (walk->data, &recording);
+        break;
+    default:
+        break;
+    }
+
+    if (ret == SVDRP_OK)
+        walk->count++;
+    else
+        svdrp_log (walk->svdrp, SVDRP_MSG_WARNING, "Invalid line '%.*s'", (int) len, line);
+}
+
+static int view_walk (view_walk_t *walk, const char *cmd)
+{
+    svdrp_reply_code_t code;
+
+    code = svdrp_command (walk->svdrp, cmd, view_walk_line, walk);
+
+    /* 550, nothing is defined */
+    if (code == SVDRP_REPLY_ACTION_NOT_TAKEN)
+        return SVDRP_OK;
+
+    if (code != SVDRP_REPLY_OK)
+        return SVDRP_ERROR;
+
+    svdrp_log (walk->svdrp, SVDRP_MSG_INFO, "Got %i items", walk->count);
+
+    return SVDRP_OK;
+}
+
+int svdrp_each_timer (svdrp_t *svdrp, svdrp_timer_view_cb_t cb, void *data)
+{
+    view_walk_t walk;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (!svdrp)
+        return SVDRP_ERROR;
+
+    memset (&walk, 0, sizeof (walk));
+    walk.svdrp = svdrp;
+    walk.verb = SVDRP_VERB_LSTT;
+    walk.timer_cb = cb;
+    walk.data = data;
+
+    return view_walk (&walk, "LSTT");
+}
+
+int svdrp_each_channel (svdrp_t *svdrp, const char *args,
+                        svdrp_channel_view_cb_t cb, void *data)
+{
+    view_walk_t walk;
+    char cmd[256];
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (!svdrp)
+        return SVDRP_ERROR;
+
+    if ((size_t) snprintf (cmd, sizeof (cmd), "LSTC%s%s", args && *args ? " " : "",
+                           args ? args : "") >= sizeof (cmd))
+        return SVDRP_ERROR;
+
+    memset (&walk, 0, sizeof (walk));
+    walk.svdrp = svdrp;
+    walk.verb = SVDRP_VERB_LSTC;
+    walk.channel_cb = cb;
+    walk.data = data;
+
+    return view_walk (&walk, cmd);
+}
+
+int svdrp_each_recording (svdrp_t *svdrp, svdrp_recording_view_cb_t cb,
+                          void *data)
+{
+    view_walk_t walk;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (!svdrp)
+        return SVDRP_ERROR;
+
+    memset (&walk, 0, sizeof (walk));
+    walk.svdrp = svdrp;
+    walk.verb = SVDRP_VERB_LSTR;
+    walk.recording_cb = cb;
+    walk.data = data;
+
+    return view_walk (&walk, "LSTR");
+}
+
+size_t svdrp_str_unescape (const svdrp_str_t *str, char *buf, size_t size)
+{
+    size_t len;
+
+    if (!str || !str->ptr || !buf || !size)
+        return 0;
+
+    len = str->len < size ? str->len : size - 1;
+    svdrp_fields_unescape (buf, str->ptr, len);
+    buf[len] = '\0';
+
+    return len;
+}
+
+/*
+ * A materialized view is a single allocation: the struct, followed by NUL
+ * terminated copies of its strings.
+ */
+static void view_copy_str (char **pool, svdrp_str_t *str, int unescape)
+{
+    if (!str->ptr)
+        return;
+
+    if (unescape)
+        svdrp_fields_unescape (*pool, str->ptr, str->len);
+    else
+        memcpy (*pool, str->ptr, str->len);
+    (*pool)[str->len] = '\0';
+    str->ptr = *pool;
+    *pool += str->len + 1;
+}
+
+svdrp_timer_view_t *svdrp_timer_materialize (const svdrp_timer_view_t *timer)
+{
+    svdrp_timer_view_t *copy;
+    char *pool;
+
+    if (!timer)
+        return NULL;
+
+    copy = malloc (sizeof (svdrp_timer_view_t) + timer->day.len
+                   + timer->start.len + timer->stop.len + timer->file.len
+                   + timer->data.len + 5);
+    if (!copy)
+        return NULL;
+
+    *copy = *timer;
+    pool = (char *) (copy + 1);
+    view_copy_str (&pool, &copy->day, 0);
+    view_copy_str (&pool, &copy->start, 0);
+    view_copy_str (&pool, &copy->stop, 0);
+    view_copy_str (&pool, &copy->file, 1);
+    view_copy_str (&pool, &copy->data, 0);
+
+    /* the first date is the end of the day field */
+    if (timer->first_date.ptr && timer->day.ptr
+        && timer->first_date.len <= timer->day.len)
+        copy->first_date.ptr = copy->day.ptr + timer->day.len - timer->first_date.len;
+
+    return copy;
+}
+
+svdrp_channel_view_t *svdrp_channel_materialize (const svdrp_channel_view_t *channel)
+{
+    svdrp_channel_view_t *copy;
+    char *pool;
+
+    if (!channel)
+        return NULL;
+
+    copy = malloc (sizeof (svdrp_channel_view_t) + channel->name.len
+                   + channel->provider.len + channel->parameters.len
+                   + channel->source.len + channel->vpid.len
+                   + channel->apid.len + channel->tpid.len
+                   + channel->caid.len + 8);
+    if (!copy)
+        return NULL;
+
+    *copy = *channel;
+    pool = (char *) (copy + 1);
+    view_copy_str (&pool, &copy->name, 1);
+    view_copy_str (&pool, &copy->provider, 1);
+    view_copy_str (&pool, &copy->parameters, 0);
+    view_copy_str (&pool, &copy->source, 0);
+    view_copy_str (&pool, &copy->vpid, 0);
+    view_copy_str (&pool, &copy->apid, 0);
+    view_copy_str (&pool, &copy->tpid, 0);
+    view_copy_str (&pool, &copy->caid, 0);
+
+    return copy;
+}
+
+svdrp_recording_view_t *svdrp_recording_materialize (const svdrp_recording_view_t *recording)
+{
+    svdrp_recording_view_t *copy;
+    char *pool;
+
+    if (!recording)
+        return NULL;
+
+    copy = malloc (sizeof (svdrp_recording_view_t) + recording->date.len
+                   + recording->time.len + recording->length.len
+                   + recording->name.len + 4);
+    if (!copy)
+        return NULL;
+
+    *copy = *recording;
+    pool = (char *) (copy + 1);
+    view_copy_str (&pool, &copy->date, 0);
+    view_copy_str (&pool, &copy->time, 0);
+    view_copy_str (&pool, &copy->length, 0);
+    view_copy_str (&pool, &copy->name, 0);
+
+    return copy;
+}
+
+void svdrp_view_free (void *view)
+{
+    free (view);
+}
+
+/* terminate a string of a view in place, within a line copied to an arena */
+static void view_terminate (char *line, svdrp_str_t *str, int unescape)
+{
+    char *s;
+
+    if (!str->ptr)
+        return;
+
+    s = line + (str->ptr - line);
+    if (unescape)
+        svdrp_fields_unescape (s, s, str->len);
+    s[str->len] = '\0';
+}
+
+/* copy the lines of a listing to the arena, none on 550 */
+static int view_snapshot (svdrp_t *svdrp, svdrp_arena_lines_t *lines,
+                          const char *cmd)
+{
+    svdrp_reply_code_t code;
+
+    code = svdrp_command (svdrp, cmd, svdrp_arena_line_cb, lines);
+    if (code == SVDRP_REPLY_ACTION_NOT_TAKEN)
+        return SVDRP_OK;
+
+    if (code != SVDRP_REPLY_OK || lines->error)
+        return SVDRP_ERROR;
+
+    return SVDRP_OK;
+}
+
+int svdrp_snapshot_channels (svdrp_t *svdrp, svdrp_arena_t *arena,
+                             const char *args,
+                             svdrp_channel_view_t **channels, int *count)
+{
+    svdrp_arena_lines_t lines = { arena, NULL, NULL, 0, 0 };
+    svdrp_arena_line_t *line;
+    svdrp_channel_view_t *array;
+    char cmd[256];
+    int n = 0;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (!svdrp || !arena || !channels || !count)
+        return SVDRP_ERROR;
+
+    *channels = NULL;
+    *count = 0;
+
+    if ((size_t) snprintf (cmd, sizeof (cmd), "LSTC%s%s", args && *args ? " " : "",
+                           args ? args : "") >= sizeof (cmd))
+        return SVDRP_ERROR;
+
+    if (view_snapshot (svdrp, &lines, cmd) != SVDRP_OK)
+        return SVDRP_ERROR;
+
+    if (!lines.count)
+        return SVDRP_OK;
+
+    array = svdrp_arena_alloc (arena, lines.count * sizeof (svdrp_channel_view_t));
+    if (!array)
+        return SVDRP_ERROR;
+
+    for (line = lines.head; line; line = line->next) {
+        svdrp_channel_view_t *channel = &array[n];
+
+        if (svdrp_parse_channel (line->text, line->len, channel) != SVDRP_OK) {
+            svdrp_log (svdrp, SVDRP_MSG_WARNING, "Invalid channel '%s'", line->text);
+            continue;
+        }
+
+        view_terminate (line->text, &channel->name, 1);
+        view_terminate (line->text, &channel->provider, 1);
+        view_terminate (line->text, &channel->parameters, 0);
+        view_terminate (line->text, &channel->source, 0);
+        view_terminate (line->text, &channel->vpid, 0);
+        view_terminate (line->text, &channel->apid, 0);
+        view_terminate (line->text, &channel->tpid, 0);
+        view_terminate (line->text, &channel->caid, 0);
+        n++;
+    }
+
+    svdrp_log (svdrp, SVDRP_MSG_INFO, "Got %i channels", n);
+
+    *channels = array;
+    *count = n;
+
+    return SVDRP_OK;
+}
+
+int svdrp_snapshot_recordings (svdrp_t *svdrp, svdrp_arena_t *arena,
+                               svdrp_recording_view_t **recordings, int *count)
+{
+    svdrp_arena_lines_t lines = { arena, NULL, NULL, 0, 0 };
+    svdrp_arena_line_t *line;
+    svdrp_recording_view_t *array;
+    int n = 0;
+
+    svdrp_log (svdrp, SVDRP_MSG_VERBOSE, __FUNCTION__);
+
+    if (!svdrp || !arena || !recordings || !count)
+        return SVDRP_ERROR;
+
+    *recordings = NULL;
+    *count = 0;
+
+    if (view_snapshot (svdrp, &lines, "LSTR") != SVDRP_OK)
+        return SVDRP_ERROR;
+
+    if (!lines.count)
+        return SVDRP_OK;
+
+    array = svdrp_arena_alloc (arena, lines.count * sizeof (svdrp_recording_view_t));
+    if (!array)
+        return SVDRP_ERROR;
+
+    for (line = lines.head; line; line = line->next) {
+        svdrp_recording_view_t *recording = &array[n];
+
+        if (svdrp_parse_recording (line->text, line->len, recording) != SVDRP_OK) {
+            svdrp_log (svdrp, SVDRP_MSG_WARNING, "Invalid recording '%s'", line->text);
+            continue;
+        }
+
+        /* the new mark is already parsed, the time may end on it */
+        view_terminate (line->text, &recording->date, 0);
+        view_terminate (line->text, &recording->time, 0);
+        view_terminate (line->text, &recording->length, 0);
+        view_terminate (line->text, &recording->name, 0);
+        n++;
+    }
+
+    svdrp_log (svdrp, SVDRP_MSG_INFO, "Got %i recordings", n);
+
+    *recordings = array;
+    *count = n;
+
+    return SVDRP_OK;
+}